@@ -0,0 +1,6 @@
+// fragment shader of the depth pre-pass, color writes are masked off
+#version 330 core
+
+void main()
+{
+}
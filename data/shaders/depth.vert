@@ -0,0 +1,16 @@
+// vertex shader of the depth pre-pass
+// only positions, transformed exactly as in mesh.vert so that the g-buffer
+// pass can test for equal depth
+#version 330 core
+layout(location = 0) in vec3 vert_position;
+
+invariant gl_Position;
+
+uniform mat4 uni_model;
+uniform mat4 uni_view;
+uniform mat4 uni_projection;
+
+void main()
+{
+    gl_Position = uni_projection * uni_view * uni_model * vec4(vert_position, 1.0);
+}
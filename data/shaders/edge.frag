@@ -0,0 +1,30 @@
+// fragment shader of the object space outline
+#version 330 core
+layout(location = 0) out vec4 frag_color;
+
+in vec3 frag_position;
+
+uniform sampler2D uni_position;
+uniform sampler2D uni_id_map;
+
+uniform int uni_id;
+
+uniform vec3 uni_camera_pos;
+
+uniform vec3 uni_outline_col;
+uniform float uni_outline_edge_fac;
+
+void main()
+{
+    // the targets may be larger than the viewport, fetch by pixel
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    // hidden behind the surface seen at this pixel, with some slack for the
+    // half float positions and the width of the line
+    if (int(texelFetch(uni_id_map, pixel, 0).x) == uni_id) {
+        float surface =
+            distance(texelFetch(uni_position, pixel, 0).xyz, uni_camera_pos);
+        float edge = distance(frag_position, uni_camera_pos);
+        if (edge > surface * 1.02) discard;
+    }
+    frag_color = vec4(uni_outline_col, uni_outline_edge_fac);
+}
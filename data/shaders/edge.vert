@@ -0,0 +1,57 @@
+// vertex shader of the object space outline, every instance is one edge
+// drawn as a quad uni_width pixels wide
+#version 330 core
+layout(location = 0) in vec3 edge_a;
+layout(location = 1) in vec3 edge_b;
+
+out vec3 frag_position;
+
+uniform mat4 uni_model;
+uniform mat4 uni_view;
+uniform mat4 uni_projection;
+
+uniform vec2 uni_screen_size;
+uniform float uni_width;
+
+void main()
+{
+    vec4 a = uni_model * vec4(edge_a, 1.0);
+    vec4 b = uni_model * vec4(edge_b, 1.0);
+    vec4 clip_a = uni_projection * uni_view * a;
+    vec4 clip_b = uni_projection * uni_view * b;
+    // cut the edge at the near plane, where z = -w
+    float near_a = clip_a.z + clip_a.w;
+    float near_b = clip_b.z + clip_b.w;
+    if (near_a < 0.0 && near_b < 0.0) {
+        // all behind the camera, an empty quad
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        frag_position = vec3(0.0);
+        return;
+    }
+    if (near_a < 0.0) {
+        float t = near_a / (near_a - near_b);
+        clip_a = mix(clip_a, clip_b, t);
+        a = mix(a, b, t);
+    } else if (near_b < 0.0) {
+        float t = near_b / (near_b - near_a);
+        clip_b = mix(clip_b, clip_a, t);
+        b = mix(b, a, t);
+    }
+
+    // corners 0 and 1 at a, 2 and 3 at b, on either side of the edge
+    bool end_b = gl_VertexID >= 2;
+    float side = (gl_VertexID & 1) == 0 ? -1.0 : 1.0;
+    vec2 half_size = 0.5 * uni_screen_size;
+    vec2 screen_a = clip_a.xy / clip_a.w * half_size;
+    vec2 screen_b = clip_b.xy / clip_b.w * half_size;
+    vec2 dir = screen_b - screen_a;
+    dir = length(dir) > 1e-6 ? normalize(dir) : vec2(1.0, 0.0);
+    vec2 normal = vec2(-dir.y, dir.x);
+    // half the width to each side, and past the ends so that joints close
+    vec2 offset = (normal * side + dir * (end_b ? 1.0 : -1.0)) * 0.5 *
+                  uni_width;
+    vec4 clip = end_b ? clip_b : clip_a;
+    clip.xy += offset / half_size * clip.w;
+    gl_Position = clip;
+    frag_position = vec3(end_b ? b : a);
+}
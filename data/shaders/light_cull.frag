@@ -0,0 +1,57 @@
+// point light culling, one fragment per screen tile
+// bounds the positions of the tile in the g-buffer and sets the bit of every
+// light whose sphere reaches the box, 128 lights per output
+#version 330 core
+layout(location = 0) out uvec4 mask0;
+layout(location = 1) out uvec4 mask1;
+layout(location = 2) out uvec4 mask2;
+layout(location = 3) out uvec4 mask3;
+
+uniform ivec2 uni_screen_size;
+uniform int uni_tile_size;
+
+uniform sampler2D uni_position;
+uniform sampler2D uni_id_map;
+
+uniform int uni_id;
+
+// position and radius, then colour and intensity of every light
+layout(std140) uniform Lights {
+    vec4 uni_lights[1024];
+};
+uniform int uni_light_count;
+
+void main()
+{
+    // bounding box of the pixels of the mesh under this tile
+    ivec2 first = ivec2(gl_FragCoord.xy) * uni_tile_size;
+    ivec2 last = min(first + uni_tile_size, uni_screen_size);
+    vec3 lowest = vec3(1e30);
+    vec3 highest = vec3(-1e30);
+    for (int y = first.y; y < last.y; ++y) {
+        for (int x = first.x; x < last.x; ++x) {
+            if (int(texelFetch(uni_id_map, ivec2(x, y), 0).x) != uni_id) {
+                continue;
+            }
+            vec3 position = texelFetch(uni_position, ivec2(x, y), 0).xyz;
+            lowest = min(lowest, position);
+            highest = max(highest, position);
+        }
+    }
+
+    uvec4 masks[4] = uvec4[](uvec4(0u), uvec4(0u), uvec4(0u), uvec4(0u));
+    // an empty tile keeps lowest above highest and matches no light
+    int count = all(lessThanEqual(lowest, highest)) ? uni_light_count : 0;
+    for (int i = 0; i < count; ++i) {
+        vec4 sphere = uni_lights[2 * i];
+        // distance from the center to the closest point of the box
+        vec3 d = sphere.xyz - clamp(sphere.xyz, lowest, highest);
+        if (dot(d, d) < sphere.w * sphere.w) {
+            masks[i / 128][(i / 32) % 4] |= 1u << uint(i % 32);
+        }
+    }
+    mask0 = masks[0];
+    mask1 = masks[1];
+    mask2 = masks[2];
+    mask3 = masks[3];
+}
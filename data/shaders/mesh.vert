@@ -3,27 +3,72 @@
 #version 330 core
 layout(location = 0) in vec3 vert_position;
 layout(location = 1) in vec3 vert_normal;
+// only bound for the smooth shape
 layout(location = 2) in vec3 vert_abstracted_normal;
 
 out vec3 frag_position;
 out vec3 frag_normal;
 
+// the same depth as depth.vert, for the equal test after a depth pre-pass
+invariant gl_Position;
+
 uniform mat4 uni_model;
 uniform mat4 uni_view;
 uniform mat4 uni_projection;
 
 uniform float uni_normal_factor;
 
+// 0 smooth, 1 ellipse, 2 cylinder, 3 sphere
+uniform int uni_abstracted_shape;
+// bounding box dimensions of the mesh, and its longest axis, -1 if none
+uniform vec3 uni_bb_dimension;
+uniform int uni_dominant_axis;
+
+// world diameter of point splats, 0 when drawing triangles, and the height
+// of the viewport in pixels
+uniform float uni_splat_size;
+uniform float uni_viewport_height;
+
+// abstracted normal of the analytic shapes, from the centered position. the
+// smooth one turns with side like the vertex normal
+vec3 abstracted_normal_of(vec3 p, float side)
+{
+    if (uni_abstracted_shape == 1) { // ellipse
+        return normalize(normalize(p) * uni_bb_dimension);
+    } else if (uni_abstracted_shape == 2) { // cylinder
+        if (uni_dominant_axis >= 0) {
+            p[uni_dominant_axis] = 0.0;
+        }
+        return normalize(p);
+    } else if (uni_abstracted_shape == 3) { // sphere
+        return normalize(p);
+    }
+    return side * vert_abstracted_normal;
+}
+
 void main()
 {
     // final rendered fragment position
     gl_Position = uni_projection * uni_view * uni_model * vec4(vert_position, 1.0);
     // position to use in the fragment shader + position buffer
     frag_position = vec3(uni_model * vec4(vert_position, 1.0));
-    vec3 normal = vec3(uni_model * vec4(vert_normal, 1.0));
-    vec3 abstracted_normal = vec3(uni_model * vec4(vert_abstracted_normal, 1.0));
+    // -1 for splats seen from behind
+    float side = 1.0;
+    if (uni_splat_size > 0.0) {
+        // diameter in pixels at this depth, and the normals of a point seen
+        // from behind turned around, scans only see one side
+        gl_PointSize = uni_splat_size * uni_projection[1][1] * 0.5 *
+                       uni_viewport_height / gl_Position.w;
+        vec3 eye = -transpose(mat3(uni_view)) * uni_view[3].xyz;
+        if (dot(mat3(uni_model) * vert_normal, eye - frag_position) < 0.0) {
+            side = -1.0;
+        }
+    }
+    vec3 normal = vec3(uni_model * vec4(side * vert_normal, 1.0));
     // combined normal, to use in the fragment shader + normal buffer
     if (uni_normal_factor > 0.f) {
+        vec3 abstracted_normal = vec3(
+            uni_model * vec4(abstracted_normal_of(vert_position, side), 1.0));
         frag_normal = mix(normal, abstracted_normal, uni_normal_factor);
     } else {
         frag_normal = normal;
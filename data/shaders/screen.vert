@@ -8,8 +8,11 @@ vec2 positions[] = vec2[](
 
 out vec2 uv;
 
+// the part of the render targets the viewport covers
+uniform vec2 uni_uv_scale;
+
 void main()
 {
     gl_Position = vec4(positions[gl_VertexID], 0., 1.);
-    uv = 0.5 * positions[gl_VertexID] + vec2(0.5);
+    uv = (0.5 * positions[gl_VertexID] + vec2(0.5)) * uni_uv_scale;
 }
@@ -0,0 +1,47 @@
+#version 330 core
+// the screen as one quad per tile, drawn instanced. a tile with no covered
+// tile within uni_dilate tiles of it collapses to a point outside the
+// screen, so the fragment shader only runs near the mesh. a negative
+// uni_dilate keeps every tile
+out vec2 uv;
+
+// the part of the render targets the viewport covers
+uniform vec2 uni_uv_scale;
+
+uniform sampler2D uni_tile_coverage;
+uniform ivec2 uni_tiles;
+uniform int uni_tile_size;
+uniform vec2 uni_viewport_size;
+uniform int uni_dilate;
+
+bool near_coverage(ivec2 tile)
+{
+    if (uni_dilate < 0) {
+        return true;
+    }
+    for (int y = -uni_dilate; y <= uni_dilate; ++y) {
+        for (int x = -uni_dilate; x <= uni_dilate; ++x) {
+            ivec2 t = clamp(tile + ivec2(x, y), ivec2(0), uni_tiles - 1);
+            if (texelFetch(uni_tile_coverage, t, 0).x > 0.5) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void main()
+{
+    ivec2 tile = ivec2(gl_InstanceID % uni_tiles.x,
+                       gl_InstanceID / uni_tiles.x);
+    // triangle strip corners, clipped to the viewport so that the quads
+    // meet without overlap
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 pixel = min((vec2(tile) + corner) * float(uni_tile_size),
+                     uni_viewport_size);
+    vec2 screen = pixel / uni_viewport_size;
+    uv = screen * uni_uv_scale;
+    gl_Position = near_coverage(tile)
+                      ? vec4(screen * 2.0 - 1.0, 0.0, 1.0)
+                      : vec4(2.0, 2.0, 2.0, 1.0);
+}
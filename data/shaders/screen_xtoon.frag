@@ -1,5 +1,7 @@
 // xtoon screen pass
 // use the 3 buffer produced by the mesh pass, and a tonemap
+// a directional light, plus the point lights the culling pass found for the
+// tile of each pixel
 #version 330 core
 layout(location = 0) out vec4 frag_color;
 
@@ -28,6 +30,18 @@ uniform float uni_dof_z_c;
 
 uniform vec3 uni_light_dir;
 
+// position and radius, then colour and intensity of every point light
+layout(std140) uniform Lights {
+    vec4 uni_lights[1024];
+};
+uniform int uni_light_count;
+uniform int uni_tile_size;
+// bit masks of the lights reaching each tile, 128 lights per mask
+uniform usampler2D uni_light_mask0;
+uniform usampler2D uni_light_mask1;
+uniform usampler2D uni_light_mask2;
+uniform usampler2D uni_light_mask3;
+
 uniform bool uni_nl_halftone;
 uniform float uni_dot_size;
 uniform float uni_rotation;
@@ -37,79 +51,110 @@ vec2 rotate(vec2 v, float r) {
     return v * mat2(cos(r), sin(r), -sin(r), cos(r));
 }
 
-void main()
-{
-    // only render if the id matches
-    int id = int(texture(uni_id_map, uv).x);
-    if (uni_id != id) discard;
-
-    vec3 position = texture(uni_position, uv).xyz;
-    vec3 normal = texture(uni_normal, uv).xyz;
-    float nl = dot(normal, uni_light_dir);
-
-    // x-toon halftone
-    if (uni_nl_halftone)
-    {
-        // pixel coordinate
-        vec2 frag_coord = uv * uni_screen_size;
-
-        // nearest dot center
-        vec2 uv_nl = rotate(round(rotate(frag_coord, uni_rotation) / uni_dot_size) * uni_dot_size, -uni_rotation);
-        // normalized distance from nearest dot center
-        float d_nl = distance(frag_coord, uv_nl) * sqrt(2.0) / uni_dot_size;
-        // nl sampled at the nearest dot center
-        float v_nl = dot(texture(uni_normal, uv_nl / uni_screen_size).xyz, uni_light_dir);
-        // we simply draw the two ends of the horizontal tonemap, with halftone dithering to fill in the value in-between
-        nl *= float(d_nl < v_nl);
-    }
+// x-toon halftone of nl for a light from light_dir
+float halftone(float nl, vec3 light_dir) {
+    if (!uni_nl_halftone) return nl;
+    // pixel coordinate
+    vec2 frag_coord = uv * uni_screen_size;
+
+    // nearest dot center
+    vec2 uv_nl = rotate(round(rotate(frag_coord, uni_rotation) / uni_dot_size) * uni_dot_size, -uni_rotation);
+    // normalized distance from nearest dot center
+    float d_nl = distance(frag_coord, uv_nl) * sqrt(2.0) / uni_dot_size;
+    // nl sampled at the nearest dot center
+    float v_nl = dot(textureLod(uni_normal, uv_nl / uni_screen_size, 0.).xyz, light_dir);
+    // we simply draw the two ends of the horizontal tonemap, with halftone dithering to fill in the value in-between
+    return nl * float(d_nl < v_nl);
+}
 
-    // level of abstraction
+// level of abstraction D for a light from light_dir
+float detail(vec3 position, vec3 normal, vec3 light_dir) {
     if (uni_detail_mapping == 0) {
         // calculate depth of this pixel
         float z = dot(normalize(uni_camera_dir), position - uni_camera_pos);
         // in this mode, D is dependent on the depth of this pixel, compared to the user-specified z_min and r values
         float z_min = uni_dbam_z_min;
         float z_max = uni_dbam_z_min * uni_dbam_r;
-        float dbam = 1. - log(z / z_min) / log(z_max / z_min);
-        // textures are flipped vertically
-        frag_color = texture(uni_tonemap, vec2(nl, 1. - dbam));
+        return 1. - log(z / z_min) / log(z_max / z_min);
     }
     // depth of field
-    else if (uni_detail_mapping == 1) {
+    if (uni_detail_mapping == 1) {
         // calculate depth of this pixel
         float z = length(position - uni_camera_pos);
         // in this mode, D is dependent on the depth of this pixel, compared to the depth of the user-specified focus point
-        float dbam = 0.;
         // if this pixel is closer to the camera than the focus point...
         if (z < uni_dof_z_c) {
             float z_min_mi = uni_dof_z_c - uni_dbam_z_min;
             float z_max_mi = uni_dof_z_c - uni_dbam_r * uni_dbam_z_min;
-            dbam = 1. - log(z / z_min_mi) / log(z_max_mi / z_min_mi);
+            return 1. - log(z / z_min_mi) / log(z_max_mi / z_min_mi);
         }
         // if this pixel is further from the camera than the focus point...
-        else {
-            float z_min_pl = uni_dof_z_c + uni_dbam_z_min;
-            float z_max_pl = uni_dof_z_c + uni_dbam_r * uni_dbam_z_min;
-            dbam = log(z / z_max_pl) / log(z_min_pl / z_max_pl);
-        }
-        // textures are flipped vertically
-        frag_color = texture(uni_tonemap, vec2(nl, 1. - dbam));
+        float z_min_pl = uni_dof_z_c + uni_dbam_z_min;
+        float z_max_pl = uni_dof_z_c + uni_dbam_r * uni_dbam_z_min;
+        return log(z / z_max_pl) / log(z_min_pl / z_max_pl);
     }
     // near-silhouette
-    else if (uni_detail_mapping == 2) {
+    if (uni_detail_mapping == 2) {
         // in this mode, D is dependent on the dot product between the normal and the view vector
-        float obam = pow(abs(dot(normal, uni_camera_dir)), uni_near_silhouette_r);
-        // textures are flipped vertically
-        frag_color = texture(uni_tonemap, vec2(nl, 1. - obam));
+        return pow(abs(dot(normal, uni_camera_dir)), uni_near_silhouette_r);
     }
     // specular
-    else if (uni_detail_mapping == 3) {
-        // calculate reflection vector (phong)
-        vec3 reflected_light_dir = 2. * dot(uni_light_dir, normal) * normal - uni_light_dir;
-        // in this mode, D is dependent on the dot product between the reflection vector and the view vector
-        float obam = pow(abs(dot(uni_camera_dir, reflected_light_dir)), uni_specular_s);
-        // textures are flipped vertically
-        frag_color = texture(uni_tonemap, vec2(nl, 1. - obam));
+    // calculate reflection vector (phong)
+    vec3 reflected_light_dir = 2. * dot(light_dir, normal) * normal - light_dir;
+    // in this mode, D is dependent on the dot product between the reflection vector and the view vector
+    return pow(abs(dot(uni_camera_dir, reflected_light_dir)), uni_specular_s);
+}
+
+// tonemap lookup of point light i, tinted by its colour and faded out
+// towards its radius. the side facing away from the light gets nothing
+vec3 point_light(int i, vec3 position, vec3 normal) {
+    vec4 sphere = uni_lights[2 * i];
+    vec4 colour = uni_lights[2 * i + 1];
+    vec3 to_light = sphere.xyz - position;
+    float d = length(to_light);
+    float fade = clamp(1. - d / sphere.w, 0., 1.);
+    vec3 light_dir = to_light / max(d, 1e-6);
+    float nl = halftone(dot(normal, light_dir), light_dir);
+    // textures are flipped vertically
+    vec3 tone = textureLod(uni_tonemap, vec2(nl, 1. - detail(position, normal, light_dir)), 0.).rgb;
+    return tone * colour.rgb * colour.w * fade * fade * step(0., nl);
+}
+
+// bits of the lights of mask m reaching this tile
+uvec4 light_mask(int m, ivec2 tile) {
+    if (m == 0) return texelFetch(uni_light_mask0, tile, 0);
+    if (m == 1) return texelFetch(uni_light_mask1, tile, 0);
+    if (m == 2) return texelFetch(uni_light_mask2, tile, 0);
+    return texelFetch(uni_light_mask3, tile, 0);
+}
+
+void main()
+{
+    // only render if the id matches
+    int id = int(texture(uni_id_map, uv).x);
+    if (uni_id != id) discard;
+    if (uni_detail_mapping < 0 || uni_detail_mapping > 3) discard;
+
+    vec3 position = texture(uni_position, uv).xyz;
+    vec3 normal = texture(uni_normal, uv).xyz;
+    float nl = halftone(dot(normal, uni_light_dir), uni_light_dir);
+
+    // textures are flipped vertically
+    frag_color = texture(uni_tonemap, vec2(nl, 1. - detail(position, normal, uni_light_dir)));
+
+    // walk the set bits of this tile, lowest first
+    ivec2 tile = ivec2(gl_FragCoord.xy) / uni_tile_size;
+    for (int m = 0; m * 128 < uni_light_count; ++m) {
+        uvec4 mask = light_mask(m, tile);
+        for (int w = 0; w < 4; ++w) {
+            uint bits = mask[w];
+            while (bits != 0u) {
+                uint bit = bits & (~bits + 1u);
+                bits ^= bit;
+                // the bit is a power of two, exact as a float
+                int i = m * 128 + w * 32 + int(log2(float(bit)) + 0.5);
+                frag_color.rgb += point_light(i, position, normal);
+            }
+        }
     }
-    else discard;
 }
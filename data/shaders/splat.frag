@@ -0,0 +1,21 @@
+// mesh pass fragment shader of point splats, the corners of the square
+// points are cut off so each splat is a disc
+#version 330 core
+layout(location = 0) out vec3 position;
+layout(location = 1) out vec3 normal;
+layout(location = 2) out float id;
+
+in vec3 frag_position;
+in vec3 frag_normal;
+
+uniform int uni_id;
+
+void main()
+{
+    if (length(gl_PointCoord - vec2(0.5)) > 0.5) {
+        discard;
+    }
+    position = frag_position;
+    normal = frag_normal;
+    id = uni_id;
+}
@@ -0,0 +1,26 @@
+// screen tile classification, one fragment per tile
+// a tile is covered when any of its pixels has the id of the mesh
+#version 330 core
+layout(location = 0) out float coverage;
+
+uniform ivec2 uni_screen_size;
+uniform int uni_tile_size;
+
+uniform sampler2D uni_id_map;
+
+uniform int uni_id;
+
+void main()
+{
+    ivec2 first = ivec2(gl_FragCoord.xy) * uni_tile_size;
+    ivec2 last = min(first + uni_tile_size, uni_screen_size);
+    coverage = 0.0;
+    for (int y = first.y; y < last.y; ++y) {
+        for (int x = first.x; x < last.x; ++x) {
+            if (int(texelFetch(uni_id_map, ivec2(x, y), 0).x) == uni_id) {
+                coverage = 1.0;
+                return;
+            }
+        }
+    }
+}
@@ -4,15 +4,33 @@
 #define SDL_MAIN_HANDLED
 #include <SDL2/SDL.h>
 #include <SDL_image.h>
+#include <algorithm>
 #include <glad/gl.h>
 #include <glm/glm.hpp>
+#include <iostream>
 #include <imgui_impl_opengl3.h>
 #include <imgui_impl_sdl2.h>
 #include <unordered_map>
+#include <vector>
+#include <xtr_gl_state.h>
+#include <xtr_gpu_memory.h>
+#include <xtr_input_log.h>
+#include <xtr_trace.h>
 namespace xtr {
+// how finished frames are presented
+// - VSync waits for the vertical blank
+// - Adaptive waits for the vertical blank unless the frame is late
+// - Uncapped presents immediately
+// - Capped presents immediately, but limits the frame rate to a fixed cap
+enum class PresentMode { VSync, Adaptive, Uncapped, Capped };
+
 class App {
   public:
-    App(int width, int height) : enable_imgui{false}, _window_resized{false} {
+    // a hidden window still provides the context, for headless runs. dsa
+    // allows direct state access when the driver has it
+    App(int width, int height, const bool hidden = false,
+        const bool dsa = true)
+        : enable_imgui{false}, low_latency{false}, _window_resized{false} {
         SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
         IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG);
 
@@ -24,23 +42,29 @@ class App {
 
         _window = SDL_CreateWindow("XToon Renderer", SDL_WINDOWPOS_UNDEFINED,
                                    SDL_WINDOWPOS_UNDEFINED, width, height,
-                                   SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+                                   SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE |
+                                       (hidden ? SDL_WINDOW_HIDDEN : 0));
         _screen_width = width;
         _screen_height = height;
 
         _context = SDL_GL_CreateContext(_window);
         gladLoadGL((GLADloadfunc)SDL_GL_GetProcAddress);
+        gl_state().init((GLADloadfunc)SDL_GL_GetProcAddress, dsa);
 
         IMGUI_CHECKVERSION();
         ImGui::CreateContext();
         ImGui_ImplSDL2_InitForOpenGL(_window, _context);
         ImGui_ImplOpenGL3_Init("#version 330 core");
+
+        set_present_mode(PresentMode::VSync);
     }
     App(App &&) = delete;
     App(const App &) = delete;
     App &operator=(App &&) = delete;
     App &operator=(const App &) = delete;
     ~App() {
+        // everything the app created should be gone by now
+        gpu_memory().report_leaks(std::cout);
         ImGui_ImplOpenGL3_Shutdown();
         ImGui_ImplSDL2_Shutdown();
         ImGui::DestroyContext();
@@ -51,9 +75,33 @@ class App {
         SDL_Quit();
     }
 
+    // select the presentation mode, fps_cap is only used by Capped
+    inline void set_present_mode(const PresentMode mode,
+                                 const int fps_cap = 60) {
+        _present_mode = mode;
+        _fps_cap = fps_cap > 0 ? fps_cap : 60;
+        int interval = 0;
+        if (mode == PresentMode::VSync) {
+            interval = 1;
+        } else if (mode == PresentMode::Adaptive) {
+            interval = -1;
+        }
+        // adaptive vsync is not supported everywhere, fall back to vsync
+        if (SDL_GL_SetSwapInterval(interval) != 0 && interval == -1) {
+            SDL_GL_SetSwapInterval(1);
+        }
+        _next_frame = SDL_GetPerformanceCounter();
+    }
+
+    inline PresentMode get_present_mode() const { return _present_mode; }
+    inline int get_fps_cap() const { return _fps_cap; }
+
     // check if the window is closing, and also update the input
+    // when the frame rate is capped, the wait happens here, before polling, so
+    // that the input is sampled as late as possible
     inline bool is_running() {
-        ImGuiIO &io = ImGui::GetIO();
+        pace_frame();
+        XTR_TRACE_SCOPE("poll events");
         SDL_Event event;
         for (auto &[k, v] : _key_pressed) {
             v = false;
@@ -64,61 +112,46 @@ class App {
         _mouse_delta = {};
         _wheel_delta = {};
         _window_resized = false;
-        while (SDL_PollEvent(&event)) {
-            ImGui_ImplSDL2_ProcessEvent(&event);
-            if (!io.WantCaptureMouse &&
-                !(io.WantCaptureKeyboard && io.WantTextInput)) {
+        if (_input_log && _input_log->mode() == InputLog::Mode::Replay) {
+            // live input is ignored while replaying, except for closing
+            while (SDL_PollEvent(&event)) {
                 if (event.type == SDL_QUIT) {
                     return false;
-                } else if (event.type == SDL_KEYUP) {
-                    const SDL_Keycode k = event.key.keysym.sym;
-                    _key_down[k] = false;
-                    _key_pressed[k] = false;
-                    _key_repeated[k] = false;
-                } else if (event.type == SDL_KEYDOWN) {
-                    const SDL_Keycode k = event.key.keysym.sym;
-                    _key_pressed[k] = !_key_down[k];
-                    _key_down[k] = true;
-                    _key_repeated[k] = event.key.repeat;
-                } else if (event.type == SDL_MOUSEBUTTONUP) {
-                    const unsigned char b = event.button.button;
-                    _button_down[b] = false;
-                    _button_pressed[b] = false;
-                    _mouse_position = {static_cast<float>(event.button.x) /
-                                           static_cast<float>(_screen_width),
-                                       static_cast<float>(event.button.y) /
-                                           static_cast<float>(_screen_height)};
-                } else if (event.type == SDL_MOUSEBUTTONDOWN) {
-                    const unsigned char b = event.button.button;
-                    _button_pressed[b] = !_button_down[b];
-                    _button_down[b] = true;
-                    _mouse_position = {static_cast<float>(event.button.x) /
-                                           static_cast<float>(_screen_width),
-                                       static_cast<float>(event.button.y) /
-                                           static_cast<float>(_screen_height)};
-                } else if (event.type == SDL_MOUSEMOTION) {
-                    _mouse_position = {static_cast<float>(event.motion.x) /
-                                           static_cast<float>(_screen_width),
-                                       static_cast<float>(event.motion.y) /
-                                           static_cast<float>(_screen_height)};
-                    _mouse_delta = {static_cast<float>(event.motion.xrel) /
-                                        static_cast<float>(_screen_width),
-                                    static_cast<float>(event.motion.yrel) /
-                                        static_cast<float>(_screen_height)};
-                } else if (event.type == SDL_MOUSEWHEEL) {
-                    _wheel_delta = {event.wheel.preciseX, event.wheel.preciseY};
-                } else if (event.type == SDL_WINDOWEVENT) {
-                    if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
-                        _screen_width = event.window.data1;
-                        _screen_height = event.window.data2;
-                        _window_resized = true;
-                    }
                 }
             }
+            if (!_input_log->read_frame(_replay_events,
+                                        SDL_GetWindowID(_window))) {
+                return false;
+            }
+            for (const SDL_Event &replayed : _replay_events) {
+                if (!process_event(replayed)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        while (SDL_PollEvent(&event)) {
+            if (_input_log) {
+                _input_log->write_event(event);
+            }
+            if (!process_event(event)) {
+                return false;
+            }
         }
         return true;
     }
 
+    // record or replay the input through log, nullptr for live input only
+    inline void set_input_log(InputLog *log) { _input_log = log; }
+
+    // resize the window, the change is reported by is_window_resized
+    inline void resize(const int width, const int height) {
+        SDL_SetWindowSize(_window, width, height);
+        _screen_width = width;
+        _screen_height = height;
+        _window_resized = true;
+    }
+
     // start rendering
     inline void start_frame() const {
         if (enable_imgui) {
@@ -129,14 +162,54 @@ class App {
     }
 
     // end rendering
-    inline void end_frame() const {
+    inline void end_frame() {
         if (enable_imgui) {
+            XTR_TRACE_GPU("imgui render");
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            // imgui binds behind the cache
+            gl_state().invalidate();
+        }
+        {
+            XTR_TRACE_SCOPE("swap");
+            SDL_GL_SwapWindow(_window);
+            // keep the driver from queueing frames ahead, each frame then
+            // starts from fresh input instead of waiting behind the previous
+            // ones
+            if (low_latency) {
+                glFinish();
+            }
+        }
+        gl_state().end_frame();
+        gpu_tracer().collect();
+
+        // the first present only starts the clock, the time before it is
+        // startup and not a frame
+        const Uint64 now = SDL_GetPerformanceCounter();
+        if (_last_present != 0) {
+            const double frame_ms = 1e3 * double(now - _last_present) /
+                                    double(SDL_GetPerformanceFrequency());
+            _frame_ms = _last_frame_ms == 0.
+                            ? frame_ms
+                            : _frame_ms + (frame_ms - _frame_ms) * 0.05;
+            _last_frame_ms = frame_ms;
+        }
+        _last_present = now;
+        if (_input_ticks != 0) {
+            // the swap returning is as close to the photons as we can measure
+            const double latency_ms = double(SDL_GetTicks() - _input_ticks);
+            _latency_ms += (latency_ms - _latency_ms) * 0.05;
+            _max_latency_ms = std::max(_max_latency_ms * 0.999, latency_ms);
+            _input_ticks = 0;
         }
-        SDL_GL_SwapWindow(_window);
-        SDL_Delay(1);
     }
 
+    // last and smoothed frame time, and input-to-present latency, in ms
+    // 0 until two frames were presented
+    inline double get_last_frame_ms() const { return _last_frame_ms; }
+    inline double get_frame_ms() const { return _frame_ms; }
+    inline double get_latency_ms() const { return _latency_ms; }
+    inline double get_max_latency_ms() const { return _max_latency_ms; }
+
     inline const bool is_key_pressed(const SDL_Keycode k) {
         return _key_pressed[k];
     }
@@ -168,8 +241,102 @@ class App {
     inline const int get_screen_height() const { return _screen_height; }
 
     bool enable_imgui;
+    // wait for the gpu after presenting, trades throughput for latency
+    bool low_latency;
 
   private:
+    // update the input state from one event, false if the window is closing
+    inline bool process_event(const SDL_Event &event) {
+        ImGuiIO &io = ImGui::GetIO();
+        ImGui_ImplSDL2_ProcessEvent(&event);
+        // oldest input of the frame, for the input-to-present latency
+        if (_input_ticks == 0 &&
+            (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP ||
+             event.type == SDL_MOUSEMOTION ||
+             event.type == SDL_MOUSEBUTTONDOWN ||
+             event.type == SDL_MOUSEBUTTONUP ||
+             event.type == SDL_MOUSEWHEEL)) {
+            _input_ticks = event.common.timestamp;
+        }
+        if (!io.WantCaptureMouse &&
+            !(io.WantCaptureKeyboard && io.WantTextInput)) {
+            if (event.type == SDL_QUIT) {
+                return false;
+            } else if (event.type == SDL_KEYUP) {
+                const SDL_Keycode k = event.key.keysym.sym;
+                _key_down[k] = false;
+                _key_pressed[k] = false;
+                _key_repeated[k] = false;
+            } else if (event.type == SDL_KEYDOWN) {
+                const SDL_Keycode k = event.key.keysym.sym;
+                _key_pressed[k] = !_key_down[k];
+                _key_down[k] = true;
+                _key_repeated[k] = event.key.repeat;
+            } else if (event.type == SDL_MOUSEBUTTONUP) {
+                const unsigned char b = event.button.button;
+                _button_down[b] = false;
+                _button_pressed[b] = false;
+                _mouse_position = {static_cast<float>(event.button.x) /
+                                       static_cast<float>(_screen_width),
+                                   static_cast<float>(event.button.y) /
+                                       static_cast<float>(_screen_height)};
+            } else if (event.type == SDL_MOUSEBUTTONDOWN) {
+                const unsigned char b = event.button.button;
+                _button_pressed[b] = !_button_down[b];
+                _button_down[b] = true;
+                _mouse_position = {static_cast<float>(event.button.x) /
+                                       static_cast<float>(_screen_width),
+                                   static_cast<float>(event.button.y) /
+                                       static_cast<float>(_screen_height)};
+            } else if (event.type == SDL_MOUSEMOTION) {
+                _mouse_position = {static_cast<float>(event.motion.x) /
+                                       static_cast<float>(_screen_width),
+                                   static_cast<float>(event.motion.y) /
+                                       static_cast<float>(_screen_height)};
+                _mouse_delta = {static_cast<float>(event.motion.xrel) /
+                                    static_cast<float>(_screen_width),
+                                static_cast<float>(event.motion.yrel) /
+                                    static_cast<float>(_screen_height)};
+            } else if (event.type == SDL_MOUSEWHEEL) {
+                _wheel_delta = {event.wheel.preciseX, event.wheel.preciseY};
+            } else if (event.type == SDL_WINDOWEVENT) {
+                if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
+                    _screen_width = event.window.data1;
+                    _screen_height = event.window.data2;
+                    _window_resized = true;
+                    if (_input_log &&
+                        _input_log->mode() == InputLog::Mode::Replay) {
+                        SDL_SetWindowSize(_window, _screen_width,
+                                          _screen_height);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // wait until the next frame is due when capped, sleep first and then spin
+    // for the last couple of milliseconds, SDL_Delay is too coarse to hit the
+    // deadline on its own
+    inline void pace_frame() {
+        if (_present_mode != PresentMode::Capped) {
+            return;
+        }
+        XTR_TRACE_SCOPE("pace");
+        const Uint64 frequency = SDL_GetPerformanceFrequency();
+        const Uint64 period = frequency / Uint64(_fps_cap);
+        const Uint64 spin = frequency / 500;
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (_next_frame > now + spin) {
+            SDL_Delay(Uint32((_next_frame - now - spin) * 1000 / frequency));
+        }
+        while ((now = SDL_GetPerformanceCounter()) < _next_frame) {
+        }
+        // a late frame restarts the schedule instead of rushing to catch up
+        _next_frame = _next_frame + period > now ? _next_frame + period
+                                                 : now + period;
+    }
+
     SDL_Window *_window;
     SDL_GLContext _context;
 
@@ -179,5 +346,15 @@ class App {
     glm::vec2 _mouse_position, _mouse_delta, _wheel_delta;
     bool _window_resized;
     int _screen_width, _screen_height;
+
+    PresentMode _present_mode = PresentMode::VSync;
+    int _fps_cap = 60;
+    Uint64 _next_frame = 0, _last_present = 0;
+    Uint32 _input_ticks = 0;
+    double _last_frame_ms = 0., _frame_ms = 0., _latency_ms = 0.,
+           _max_latency_ms = 0.;
+
+    InputLog *_input_log = nullptr;
+    std::vector<SDL_Event> _replay_events;
 };
 } // namespace xtr
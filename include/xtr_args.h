@@ -0,0 +1,86 @@
+// command line parsing
+// every flag is declared with the number of values it takes, so switches
+// without a value do not shift the flags after them. unknown flags and
+// missing values are errors instead of being skipped
+#pragma once
+#include <string>
+#include <vector>
+
+namespace xtr {
+// a flag and the values that follow it, a switch takes none. optional
+// values are taken while the next argument is not a flag
+struct ArgSpec {
+    std::string flag;
+    int values = 0;
+    int optional = 0;
+};
+
+// a flag as given on the command line
+struct Arg {
+    std::string flag;
+    std::vector<std::string> values;
+
+    // the first value, or an empty string for a switch
+    inline const char *value() const {
+        return values.empty() ? "" : values.front().c_str();
+    }
+};
+
+class Args {
+  public:
+    Args(const int argc, char *argv[], const std::vector<ArgSpec> &specs) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string flag = argv[i];
+            const ArgSpec *spec = nullptr;
+            for (const ArgSpec &s : specs) {
+                if (s.flag == flag) {
+                    spec = &s;
+                }
+            }
+            if (!spec) {
+                _error = "Unknown flag " + flag;
+                return;
+            }
+            Arg arg{flag, {}};
+            for (int v = 0; v < spec->values; ++v) {
+                if (++i >= argc) {
+                    _error = "Missing value for " + flag;
+                    return;
+                }
+                arg.values.push_back(argv[i]);
+            }
+            for (int v = 0; v < spec->optional && i + 1 < argc &&
+                            std::string{argv[i + 1]}.rfind("--", 0) != 0;
+                 ++v) {
+                arg.values.push_back(argv[++i]);
+            }
+            _args.push_back(std::move(arg));
+        }
+    }
+
+    // false when the command line did not parse, with the reason in error
+    inline bool ok() const { return _error.empty(); }
+    inline const std::string &error() const { return _error; }
+
+    // the flags in command line order
+    inline const std::vector<Arg> &list() const { return _args; }
+
+    // the last occurrence of flag, or nullptr
+    inline const Arg *find(const std::string &flag) const {
+        const Arg *found = nullptr;
+        for (const Arg &arg : _args) {
+            if (arg.flag == flag) {
+                found = &arg;
+            }
+        }
+        return found;
+    }
+    inline bool has(const std::string &flag) const {
+        return find(flag) != nullptr;
+    }
+
+  private:
+    std::vector<Arg> _args;
+    std::string _error;
+};
+} // namespace xtr
@@ -1,35 +1,84 @@
 // raii object for VBO and VAO
 #pragma once
 #include <glad/gl.h>
+#include <string>
+#include <utility>
+#include <xtr_gl_state.h>
+#include <xtr_gpu_memory.h>
 
 namespace xtr {
 // short for vertex buffer object
 class Buffer {
   public:
-    static void unbind(GLenum target) { glBindBuffer(target, 0); }
+    static void unbind(GLenum target) { gl_state().bind_buffer(target, 0); }
 
-    Buffer(GLenum target) : _target{target} { glGenBuffers(1, &_buffer); }
-    Buffer(Buffer &&o) : _target{o._target}, _buffer{o._buffer} {};
+    Buffer(GLenum target)
+        : _target{target}, _buffer{gl_state().create_buffer()} {
+        gpu_memory().add(GpuKind::Buffer, _buffer, category(target));
+    }
+    // a moved-from buffer owns nothing, or what the assigned-to one had
+    Buffer(Buffer &&o)
+        : _target{o._target}, _buffer{std::exchange(o._buffer, 0)} {};
     Buffer(const Buffer &) = delete;
     Buffer &operator=(Buffer &&o) {
-        _target = o._target;
-        _buffer = o._buffer;
+        std::swap(_target, o._target);
+        std::swap(_buffer, o._buffer);
         return *this;
     };
     Buffer &operator=(const Buffer &) = delete;
-    ~Buffer() { glDeleteBuffers(1, &_buffer); }
+    ~Buffer() {
+        if (_buffer) {
+            gl_state().forget_buffer(_buffer);
+            gpu_memory().remove(GpuKind::Buffer, _buffer);
+            glDeleteBuffers(1, &_buffer);
+        }
+    }
 
+    // name the owner in the gpu memory report
+    inline void label(const std::string &owner) const {
+        gpu_memory().set_owner(GpuKind::Buffer, _buffer, owner);
+    }
+
+    // (re)allocate the storage, without dsa the buffer ends up bound
     inline void data(GLsizeiptr size, const GLvoid *data, GLenum usage) const {
-        glBufferData(_target, size, data, usage);
+        gl_state().buffer_data(_target, _buffer, size, data, usage);
+        gpu_memory().resize(GpuKind::Buffer, _buffer, size_t(size), usage);
+    }
+    // allocate the storage once. it is immutable where the context has
+    // buffer storage, so another size takes another buffer, and flags say
+    // how it may be mapped. without it, this falls back to data with usage.
+    // true when the storage is immutable
+    inline bool storage(GLsizeiptr size, const GLvoid *data, GLbitfield flags,
+                        GLenum usage) const {
+        if (!gl_state().buffer_storage(_target, _buffer, size, data, flags)) {
+            this->data(size, data, usage);
+            return false;
+        }
+        gpu_memory().resize(GpuKind::Buffer, _buffer, size_t(size), usage);
+        return true;
+    }
+    inline void sub_data(GLintptr offset, GLsizeiptr size,
+                         const GLvoid *data) const {
+        gl_state().buffer_sub_data(_target, _buffer, offset, size, data);
     }
 
-    inline void bind() const { glBindBuffer(_target, _buffer); }
-    inline void unbind() const { glBindBuffer(_target, 0); }
+    inline void bind() const { gl_state().bind_buffer(_target, _buffer); }
+    inline void unbind() const { gl_state().bind_buffer(_target, 0); }
 
     inline const GLenum target() const { return _target; }
     inline operator GLuint() const { return _buffer; }
 
   private:
+    // buffers only read from or copied through count as staging
+    static inline GpuCategory category(const GLenum target) {
+        return target == GL_COPY_READ_BUFFER ||
+                       target == GL_COPY_WRITE_BUFFER ||
+                       target == GL_PIXEL_PACK_BUFFER ||
+                       target == GL_PIXEL_UNPACK_BUFFER
+                   ? GpuCategory::Staging
+                   : GpuCategory::Geometry;
+    }
+
     GLenum _target;
     GLuint _buffer;
 };
@@ -37,19 +86,24 @@ class Buffer {
 // short for vertex array object
 class Array {
   public:
-    static void unbind() { glBindVertexArray(0); }
+    static void unbind() { gl_state().bind_vertex_array(0); }
 
-    Array() { glGenVertexArrays(1, &_array); }
-    Array(Array &&o) : _array{o._array} {};
+    Array() : _array{gl_state().create_vertex_array()} {}
+    Array(Array &&o) : _array{std::exchange(o._array, 0)} {};
     Array(const Array &) = delete;
     Array &operator=(Array &&o) {
-        _array = o._array;
+        std::swap(_array, o._array);
         return *this;
     };
     Array &operator=(const Array &) = delete;
-    ~Array() { glDeleteVertexArrays(1, &_array); }
+    ~Array() {
+        if (_array) {
+            gl_state().forget_vertex_array(_array);
+            glDeleteVertexArrays(1, &_array);
+        }
+    }
 
-    inline void bind() const { glBindVertexArray(_array); }
+    inline void bind() const { gl_state().bind_vertex_array(_array); }
 
     inline operator GLuint() const { return _array; }
 
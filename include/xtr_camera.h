@@ -64,4 +64,24 @@ class TurnTableCamera {
     glm::vec3 _origin;
     float _move_speed = 5.f;
 };
+
+// scripted orbit used to drive the camera during export, phi sweeps the given
+// number of turns over the frame count while theta swings around its start
+struct TurnTablePath {
+    int frames = 120;
+    float turns = 1.f;
+    float theta_amplitude = 0.f;
+
+    // camera at frame, the last frame stops one step short of the first one so
+    // that looping the sequence is seamless
+    inline TurnTableCamera at(const TurnTableCamera &start,
+                              const int frame) const {
+        const float t = frames > 0 ? float(frame) / float(frames) : 0.f;
+        TurnTableCamera camera = start;
+        camera.set_phi(start.get_phi() + t * turns * glm::two_pi<float>());
+        camera.set_theta(start.get_theta() +
+                         theta_amplitude * sinf(t * glm::two_pi<float>()));
+        return camera;
+    }
+};
 } // namespace xtr
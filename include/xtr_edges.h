@@ -0,0 +1,253 @@
+// object space outline
+// the edges of a mesh, with the triangles on either side, are found once per
+// mesh, when the outline first needs them. every frame the silhouette edges,
+// between a triangle facing the camera and one facing away, and the creases
+// sharper than an angle are collected on all threads and drawn as screen
+// aligned quads of a fixed width in pixels. the cost follows the number of
+// edges, not the resolution
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+#include <xtr_buffer.h>
+#include <xtr_mesh.h>
+#include <xtr_parallel.h>
+#include <xtr_shader.h>
+#include <xtr_trace.h>
+
+namespace xtr {
+class MeshEdges {
+  public:
+    // find the edges of the triangles. vertices at the same position count
+    // as one, so the split vertices along seams do not make boundaries
+    inline void build(const glm::vec3 *ps, const size_t count,
+                      const int *indices, const size_t index_count) {
+        XTR_TRACE_SCOPE("edge adjacency");
+        clear();
+        // one id per distinct position
+        std::vector<int> order(count), ids(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [ps](const int l, const int r) {
+            return ps[l].x < ps[r].x ||
+                   (ps[l].x == ps[r].x &&
+                    (ps[l].y < ps[r].y ||
+                     (ps[l].y == ps[r].y && ps[l].z < ps[r].z)));
+        });
+        for (size_t i = 0; i < count; ++i) {
+            if (i == 0 || ps[order[i]] != ps[order[i - 1]]) {
+                _positions.push_back(ps[order[i]]);
+            }
+            ids[order[i]] = int(_positions.size()) - 1;
+        }
+
+        // plane of every triangle, degenerate ones face nowhere
+        const size_t face_count = index_count / 3;
+        _planes.resize(face_count);
+        parallel_for(face_count, [&](const size_t begin, const size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                const glm::vec3 &a = ps[indices[f * 3]];
+                const glm::vec3 n = glm::cross(ps[indices[f * 3 + 1]] - a,
+                                               ps[indices[f * 3 + 2]] - a);
+                const float length = glm::length(n);
+                const glm::vec3 unit = length > 0.f ? n / length : n;
+                _planes[f] = glm::vec4{unit, -glm::dot(unit, a)};
+            }
+        });
+
+        // the sides of all triangles sorted by their ends, the sides of the
+        // same edge end up next to each other
+        struct Side {
+            uint64_t key;
+            int face;
+        };
+        std::vector<Side> sides;
+        sides.reserve(face_count * 3);
+        for (size_t f = 0; f < face_count; ++f) {
+            for (int s = 0; s < 3; ++s) {
+                const int a = ids[indices[f * 3 + s]];
+                const int b = ids[indices[f * 3 + (s + 1) % 3]];
+                if (a != b) {
+                    sides.push_back({uint64_t(std::min(a, b)) << 32 |
+                                         uint32_t(std::max(a, b)),
+                                     int(f)});
+                }
+            }
+        }
+        std::sort(sides.begin(), sides.end(),
+                  [](const Side &l, const Side &r) {
+                      return l.key < r.key ||
+                             (l.key == r.key && l.face < r.face);
+                  });
+        // an edge with one triangle is a boundary, more than two triangles
+        // only keep the first two
+        for (size_t i = 0; i < sides.size();) {
+            size_t j = i + 1;
+            while (j < sides.size() && sides[j].key == sides[i].key) {
+                ++j;
+            }
+            Edge edge{int(sides[i].key >> 32),
+                      int(sides[i].key & 0xffffffffu), sides[i].face,
+                      j - i > 1 ? sides[i + 1].face : -1, 1.f};
+            if (edge.f1 >= 0) {
+                edge.cos_dihedral = glm::dot(glm::vec3{_planes[edge.f0]},
+                                             glm::vec3{_planes[edge.f1]});
+            }
+            _edges.push_back(edge);
+            i = j;
+        }
+        _facing.resize(face_count);
+    }
+
+    inline void build(const Mesh &mesh) {
+        std::vector<glm::vec3> ps(mesh.vertices.size());
+        for (size_t i = 0; i < ps.size(); ++i) {
+            ps[i] = mesh.vertices[i].position;
+        }
+        build(ps.data(), ps.size(), mesh.indices.data(), mesh.indices.size());
+    }
+
+    inline void clear() {
+        _positions.clear();
+        _planes.clear();
+        _edges.clear();
+        _facing.clear();
+        _segments.clear();
+    }
+
+    // collect the silhouette and boundary edges seen from eye, in object
+    // space, and the creases whose triangles meet at more than crease_angle
+    // degrees. the ends of each edge go into segments
+    inline size_t extract(const glm::vec3 &eye, const float crease_angle) {
+        XTR_TRACE_SCOPE("edge extraction");
+        const float cos_crease = std::cos(glm::radians(crease_angle));
+        parallel_for(_planes.size(), [&](const size_t begin,
+                                         const size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                _facing[f] = glm::dot(glm::vec3{_planes[f]}, eye) +
+                                 _planes[f].w >
+                             0.f;
+            }
+        });
+        _chunks.resize(thread_count());
+        parallel_chunks(
+            _edges.size(), _chunks.size(),
+            [&](const size_t chunk, const size_t begin, const size_t end) {
+                std::vector<glm::vec3> &out = _chunks[chunk];
+                out.clear();
+                for (size_t e = begin; e < end; ++e) {
+                    const Edge &edge = _edges[e];
+                    const bool front = _facing[edge.f0];
+                    const bool drawn =
+                        edge.f1 < 0
+                            ? front
+                            : front != bool(_facing[edge.f1]) ||
+                                  ((front || _facing[edge.f1]) &&
+                                   edge.cos_dihedral < cos_crease);
+                    if (drawn) {
+                        out.push_back(_positions[edge.a]);
+                        out.push_back(_positions[edge.b]);
+                    }
+                }
+            });
+        _segments.clear();
+        for (const auto &chunk : _chunks) {
+            _segments.insert(_segments.end(), chunk.begin(), chunk.end());
+        }
+        return segment_count();
+    }
+
+    // ends of the extracted edges, two per edge
+    inline const std::vector<glm::vec3> &segments() const { return _segments; }
+    inline size_t segment_count() const { return _segments.size() / 2; }
+    inline size_t edge_count() const { return _edges.size(); }
+
+  private:
+    // ends and triangles of an edge, f1 is -1 on a boundary
+    struct Edge {
+        int a, b, f0, f1;
+        float cos_dihedral;
+    };
+
+    std::vector<glm::vec3> _positions;
+    std::vector<glm::vec4> _planes;
+    std::vector<Edge> _edges;
+    std::vector<uint8_t> _facing;
+    // segments of each thread, kept so that extracting does not allocate
+    std::vector<std::vector<glm::vec3>> _chunks;
+    std::vector<glm::vec3> _segments;
+};
+
+// draws the extracted edges, one instanced quad per edge
+class EdgePass {
+  public:
+    EdgePass()
+        : _program{load_program("./data/shaders/edge.vert",
+                                "./data/shaders/edge.frag")},
+          _segment_buffer{GL_ARRAY_BUFFER} {
+        _segment_buffer.label("outline edges");
+        _array.bind();
+        _segment_buffer.bind();
+        for (int i = 0; i < 2; ++i) {
+            glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE,
+                                  2 * sizeof(glm::vec3),
+                                  (void *)(i * sizeof(glm::vec3)));
+            glVertexAttribDivisor(i, 1);
+            glEnableVertexAttribArray(i);
+        }
+        _array.unbind();
+    }
+
+    // draw the segments of edges width pixels wide into the bound
+    // framebuffer. the parts hidden behind the surface in the position
+    // buffer at unit position_unit, where the id buffer at id_unit is id,
+    // are dropped
+    inline void draw(const MeshEdges &edges, const glm::mat4 &model_matrix,
+                     const glm::mat4 &view_matrix,
+                     const glm::mat4 &projection_matrix,
+                     const glm::vec3 &camera_pos, const glm::vec2 &screen_size,
+                     const float width, const glm::vec3 &colour,
+                     const float alpha, const int position_unit,
+                     const int id_unit, const int id) {
+        const size_t count = edges.segment_count();
+        if (count == 0) {
+            return;
+        }
+        // orphan the storage so the gpu can still draw last frame's edges
+        const size_t bytes = edges.segments().size() * sizeof(glm::vec3);
+        _capacity = std::max(_capacity, bytes);
+        _segment_buffer.data(GLsizeiptr(_capacity), nullptr, GL_STREAM_DRAW);
+        _segment_buffer.sub_data(0, GLsizeiptr(bytes),
+                                 edges.segments().data());
+
+        _program.use();
+        _program.uni_mat4(_program.loc("uni_model"), model_matrix);
+        _program.uni_mat4(_program.loc("uni_view"), view_matrix);
+        _program.uni_mat4(_program.loc("uni_projection"), projection_matrix);
+        _program.uni_2f(_program.loc("uni_screen_size"), screen_size.x,
+                        screen_size.y);
+        _program.uni_1f(_program.loc("uni_width"), width);
+        _program.uni_1i(_program.loc("uni_position"), position_unit);
+        _program.uni_1i(_program.loc("uni_id_map"), id_unit);
+        _program.uni_1i(_program.loc("uni_id"), id);
+        _program.uni_vec3(_program.loc("uni_camera_pos"), camera_pos);
+        _program.uni_vec3(_program.loc("uni_outline_col"), colour);
+        _program.uni_1f(_program.loc("uni_outline_edge_fac"), alpha);
+        // quads face either way and are sorted by the position buffer
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        _array.bind();
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(count));
+        _array.unbind();
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+  private:
+    xtr::Program _program;
+    xtr::Array _array;
+    xtr::Buffer _segment_buffer;
+    size_t _capacity = 0;
+};
+} // namespace xtr
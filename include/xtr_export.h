@@ -0,0 +1,368 @@
+// offline frame export
+// frames are read back through a ring of pixel buffer objects guarded by
+// fences, so the gpu never waits on the cpu, and are then encoded by a pool of
+// writer threads, so the render loop never waits on the disk
+#pragma once
+#include <SDL_image.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <xtr_buffer.h>
+#include <xtr_trace.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace xtr {
+// sequences are written as one file per frame into a directory, streams are
+// written into a single file, "-" for stdout, or "|command" for a pipe
+enum class ExportFormat {
+    PngSequence,
+    PpmSequence,
+    PpmStream,
+    Y4mStream,
+};
+
+// binary ppm of a bottom-up rgba image, as returned by glReadPixels
+inline std::vector<unsigned char>
+encode_ppm(const std::vector<unsigned char> &rgba, const int width,
+           const int height) {
+    const std::string header = "P6\n" + std::to_string(width) + " " +
+                               std::to_string(height) + "\n255\n";
+    std::vector<unsigned char> out(header.begin(), header.end());
+    out.reserve(header.size() + size_t(width) * height * 3);
+    for (int y = height - 1; y >= 0; --y) {
+        const unsigned char *row = rgba.data() + size_t(y) * width * 4;
+        for (int x = 0; x < width; ++x) {
+            out.insert(out.end(), row + x * 4, row + x * 4 + 3);
+        }
+    }
+    return out;
+}
+
+// one yuv4mpeg2 frame (4:4:4, bt.601 limited range) of a bottom-up rgba image
+inline std::vector<unsigned char>
+encode_y4m_frame(const std::vector<unsigned char> &rgba, const int width,
+                 const int height) {
+    const size_t plane = size_t(width) * height;
+    const std::string header = "FRAME\n";
+    std::vector<unsigned char> out(header.size() + plane * 3);
+    std::copy(header.begin(), header.end(), out.begin());
+    unsigned char *ys = out.data() + header.size();
+    unsigned char *us = ys + plane;
+    unsigned char *vs = us + plane;
+    for (int y = 0; y < height; ++y) {
+        const unsigned char *row =
+            rgba.data() + size_t(height - 1 - y) * width * 4;
+        for (int x = 0; x < width; ++x) {
+            const float r = row[x * 4], g = row[x * 4 + 1], b = row[x * 4 + 2];
+            const size_t i = size_t(y) * width + x;
+            ys[i] = (unsigned char)(16.f + 0.257f * r + 0.504f * g +
+                                    0.098f * b + 0.5f);
+            us[i] = (unsigned char)(128.f - 0.148f * r - 0.291f * g +
+                                    0.439f * b + 0.5f);
+            vs[i] = (unsigned char)(128.f + 0.439f * r - 0.368f * g -
+                                    0.071f * b + 0.5f);
+        }
+    }
+    return out;
+}
+
+// png of a bottom-up rgba image, through SDL_image
+inline bool save_png(const std::filesystem::path &file_path,
+                     const std::vector<unsigned char> &rgba, const int width,
+                     const int height) {
+    std::vector<unsigned char> flipped(rgba.size());
+    const size_t pitch = size_t(width) * 4;
+    for (int y = 0; y < height; ++y) {
+        std::copy_n(rgba.data() + (height - 1 - y) * pitch, pitch,
+                    flipped.data() + y * pitch);
+    }
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom(
+        flipped.data(), width, height, 32, int(pitch), SDL_PIXELFORMAT_RGBA32);
+    const bool saved = surface && IMG_SavePNG(surface, file_path.c_str()) == 0;
+    SDL_FreeSurface(surface);
+    return saved;
+}
+
+class FrameExporter {
+  public:
+    FrameExporter(const int width, const int height, const ExportFormat format,
+                  const std::string &target, const int fps = 30,
+                  const int ring_size = 4, const int writer_count = 0)
+        : _width{width}, _height{height}, _format{format}, _target{target},
+          _fences(ring_size, nullptr), _slot_frames(ring_size, 0) {
+        const GLsizeiptr frame_size = GLsizeiptr(width) * height * 4;
+        // reserve so that the buffers are never moved
+        _pbos.reserve(ring_size);
+        for (int i = 0; i < ring_size; ++i) {
+            _pbos.emplace_back(GL_PIXEL_PACK_BUFFER);
+            _pbos.back().label("export readback");
+            _pbos.back().bind();
+            _pbos.back().data(frame_size, nullptr, GL_STREAM_READ);
+        }
+        Buffer::unbind(GL_PIXEL_PACK_BUFFER);
+
+        if (is_stream()) {
+            open_stream();
+            if (_stream && _format == ExportFormat::Y4mStream) {
+                fprintf(_stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n",
+                        width, height, fps);
+            }
+        } else {
+            std::filesystem::create_directories(_target);
+        }
+
+        const int writers =
+            writer_count > 0
+                ? writer_count
+                : std::max(1, int(std::thread::hardware_concurrency()) - 1);
+        _max_queued = 2 * writers;
+        for (int i = 0; i < writers; ++i) {
+            _writers.emplace_back([this]() { writer_loop(); });
+        }
+    }
+    FrameExporter(FrameExporter &&) = delete;
+    FrameExporter(const FrameExporter &) = delete;
+    FrameExporter &operator=(FrameExporter &&) = delete;
+    FrameExporter &operator=(const FrameExporter &) = delete;
+    ~FrameExporter() { finish(); }
+
+    // queue a readback of the first color attachment of framebuffer, this only
+    // blocks when every pbo of the ring is still in flight
+    inline void capture(const GLuint framebuffer) {
+        XTR_TRACE_SCOPE("capture");
+        if (_in_flight == int(_pbos.size())) {
+            retire(true);
+        }
+        const int slot = (_tail + _in_flight) % int(_pbos.size());
+        gl_state().bind_framebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glReadBuffer(framebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+        _pbos[slot].bind();
+        glReadPixels(0, 0, _width, _height, GL_RGBA, GL_UNSIGNED_BYTE,
+                     nullptr);
+        _pbos[slot].unbind();
+        gl_state().bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
+        _fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        _slot_frames[slot] = _captured++;
+        ++_in_flight;
+        poll();
+    }
+
+    // hand every finished readback to the writers, without waiting
+    inline void poll() {
+        while (_in_flight > 0 && retire(false)) {
+        }
+    }
+
+    // drain the ring and the writers, and close the stream
+    inline void finish() {
+        while (_in_flight > 0) {
+            retire(true);
+        }
+        {
+            std::lock_guard lock{_job_mutex};
+            _stopping = true;
+        }
+        _job_cv.notify_all();
+        for (auto &writer : _writers) {
+            writer.join();
+        }
+        _writers.clear();
+        if (_stream) {
+            fflush(_stream);
+            if (_is_pipe) {
+                pclose(_stream);
+            } else if (_stream != stdout) {
+                fclose(_stream);
+            }
+            _stream = nullptr;
+        }
+    }
+
+    inline int captured() const { return _captured; }
+    inline int written() const { return _written; }
+    // time the render loop spent blocked on the gpu and on the writers
+    inline double fence_wait_ms() const { return _fence_wait_ms; }
+    inline double queue_wait_ms() const { return _queue_wait_ms; }
+    inline bool ok() const { return is_stream() ? _stream != nullptr : true; }
+
+  private:
+    struct Job {
+        int frame;
+        std::vector<unsigned char> rgba;
+    };
+
+    inline bool is_stream() const {
+        return _format == ExportFormat::PpmStream ||
+               _format == ExportFormat::Y4mStream;
+    }
+
+    inline void open_stream() {
+        if (_target == "-") {
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            _stream = stdout;
+        } else if (!_target.empty() && _target[0] == '|') {
+#ifdef _WIN32
+            _stream = popen(_target.c_str() + 1, "wb");
+#else
+            _stream = popen(_target.c_str() + 1, "w");
+#endif
+            _is_pipe = true;
+        } else {
+            _stream = fopen(_target.c_str(), "wb");
+        }
+    }
+
+    // map the oldest pbo and queue its content, returns false if wait is off
+    // and the gpu has not finished with it yet
+    inline bool retire(const bool wait) {
+        const auto wait_start = std::chrono::steady_clock::now();
+        GLsync &fence = _fences[_tail];
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (wait && status == GL_TIMEOUT_EXPIRED) {
+            status = glClientWaitSync(fence, 0, 1000000);
+        }
+        _fence_wait_ms += std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - wait_start)
+                              .count();
+        if (status == GL_TIMEOUT_EXPIRED) {
+            return false;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+
+        const size_t frame_size = size_t(_width) * _height * 4;
+        Job job{_slot_frames[_tail], std::vector<unsigned char>(frame_size)};
+        _pbos[_tail].bind();
+        const void *mapped = glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(frame_size), GL_MAP_READ_BIT);
+        if (mapped) {
+            std::copy_n((const unsigned char *)mapped, frame_size,
+                        job.rgba.data());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        _pbos[_tail].unbind();
+        _tail = (_tail + 1) % int(_pbos.size());
+        --_in_flight;
+        push(std::move(job));
+        return true;
+    }
+
+    inline void push(Job &&job) {
+        const auto wait_start = std::chrono::steady_clock::now();
+        std::unique_lock lock{_job_mutex};
+        _space_cv.wait(lock, [this]() { return _jobs.size() < _max_queued; });
+        _queue_wait_ms += std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - wait_start)
+                              .count();
+        _jobs.push_back(std::move(job));
+        lock.unlock();
+        _job_cv.notify_one();
+    }
+
+    inline void writer_loop() {
+        tracer().name_thread("export writer");
+        while (true) {
+            Job job;
+            {
+                std::unique_lock lock{_job_mutex};
+                _job_cv.wait(lock,
+                             [this]() { return _stopping || !_jobs.empty(); });
+                if (_jobs.empty()) {
+                    return;
+                }
+                job = std::move(_jobs.front());
+                _jobs.pop_front();
+            }
+            _space_cv.notify_one();
+            XTR_TRACE_SCOPE("write frame");
+            write(job);
+            ++_written;
+        }
+    }
+
+    inline void write(const Job &job) {
+        if (_format == ExportFormat::PngSequence) {
+            save_png(frame_path(job.frame, ".png"), job.rgba, _width, _height);
+        } else if (_format == ExportFormat::PpmSequence) {
+            const auto ppm = encode_ppm(job.rgba, _width, _height);
+            std::FILE *file =
+                fopen(frame_path(job.frame, ".ppm").c_str(), "wb");
+            if (file) {
+                fwrite(ppm.data(), 1, ppm.size(), file);
+                fclose(file);
+            }
+        } else {
+            write_stream(job.frame,
+                         _format == ExportFormat::PpmStream
+                             ? encode_ppm(job.rgba, _width, _height)
+                             : encode_y4m_frame(job.rgba, _width, _height));
+        }
+    }
+
+    // frames are encoded out of order, but must hit the stream in order
+    inline void write_stream(const int frame,
+                             std::vector<unsigned char> &&bytes) {
+        std::lock_guard lock{_stream_mutex};
+        _encoded[frame] = std::move(bytes);
+        while (!_encoded.empty() && _encoded.begin()->first == _next_frame) {
+            const auto &data = _encoded.begin()->second;
+            if (_stream) {
+                fwrite(data.data(), 1, data.size(), _stream);
+            }
+            _encoded.erase(_encoded.begin());
+            ++_next_frame;
+        }
+    }
+
+    inline std::filesystem::path frame_path(const int frame,
+                                            const char *extension) const {
+        char name[32];
+        snprintf(name, sizeof(name), "frame_%05d%s", frame, extension);
+        return std::filesystem::path{_target} / name;
+    }
+
+    int _width, _height;
+    ExportFormat _format;
+    std::string _target;
+
+    // readback ring
+    std::vector<Buffer> _pbos;
+    std::vector<GLsync> _fences;
+    std::vector<int> _slot_frames;
+    int _tail = 0, _in_flight = 0, _captured = 0;
+
+    // writer pool
+    std::vector<std::thread> _writers;
+    std::deque<Job> _jobs;
+    size_t _max_queued;
+    std::mutex _job_mutex;
+    std::condition_variable _job_cv, _space_cv;
+    bool _stopping = false;
+    std::atomic<int> _written = 0;
+
+    // ordered stream output
+    std::FILE *_stream = nullptr;
+    bool _is_pipe = false;
+    std::mutex _stream_mutex;
+    std::map<int, std::vector<unsigned char>> _encoded;
+    int _next_frame = 0;
+
+    double _fence_wait_ms = 0., _queue_wait_ms = 0.;
+};
+} // namespace xtr
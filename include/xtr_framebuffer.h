@@ -1,25 +1,52 @@
 // raii object for the framebuffer and the renderbuffer
 // mainly use the manage lifetime and binding
 #pragma once
+#include <string>
+#include <utility>
+#include <xtr_gl_state.h>
+#include <xtr_gpu_memory.h>
 #include <xtr_shader.h>
 
 namespace xtr {
 class Framebuffer {
   public:
-    static void unbind() { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
+    static void unbind() { gl_state().bind_framebuffer(GL_FRAMEBUFFER, 0); }
 
-    Framebuffer() { glGenFramebuffers(1, &_framebuffer); }
-    Framebuffer(Framebuffer &&o) : _framebuffer{o._framebuffer} {};
+    Framebuffer() : _framebuffer{gl_state().create_framebuffer()} {}
+    Framebuffer(Framebuffer &&o)
+        : _framebuffer{std::exchange(o._framebuffer, 0)} {};
     Framebuffer(const Framebuffer &) = delete;
     Framebuffer &operator=(Framebuffer &&o) {
-        _framebuffer = o._framebuffer;
+        std::swap(_framebuffer, o._framebuffer);
         return *this;
     };
     Framebuffer &operator=(const Framebuffer &) = delete;
-    ~Framebuffer() { glDeleteFramebuffers(1, &_framebuffer); }
+    ~Framebuffer() {
+        if (_framebuffer) {
+            gl_state().forget_framebuffer(_framebuffer);
+            glDeleteFramebuffers(1, &_framebuffer);
+        }
+    }
 
     inline void bind() const {
-        glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+        gl_state().bind_framebuffer(GL_FRAMEBUFFER, _framebuffer);
+    }
+
+    // attach level 0 of a 2d texture or a renderbuffer, and select the color
+    // attachments drawn into. none of these change the bound framebuffer. an
+    // attached texture is accounted as a render target
+    inline void attach_texture(GLenum attachment, GLuint texture) const {
+        gl_state().framebuffer_texture(_framebuffer, attachment, texture);
+        gpu_memory().set_category(GpuKind::Texture, texture,
+                                  GpuCategory::RenderTarget);
+    }
+    inline void attach_renderbuffer(GLenum attachment,
+                                    GLuint renderbuffer) const {
+        gl_state().framebuffer_renderbuffer(_framebuffer, attachment,
+                                            renderbuffer);
+    }
+    inline void draw_buffers(GLsizei count, const GLenum *buffers) const {
+        gl_state().framebuffer_draw_buffers(_framebuffer, count, buffers);
     }
 
     inline operator GLuint() const { return _framebuffer; }
@@ -29,20 +56,44 @@ class Framebuffer {
 };
 class Renderbuffer {
   public:
-    static void unbind() { glBindRenderbuffer(GL_RENDERBUFFER, 0); }
+    static void unbind() { gl_state().bind_renderbuffer(0); }
 
-    Renderbuffer() { glGenRenderbuffers(1, &_renderbuffer); }
-    Renderbuffer(Renderbuffer &&o) : _renderbuffer{o._renderbuffer} {};
+    Renderbuffer() : _renderbuffer{gl_state().create_renderbuffer()} {
+        gpu_memory().add(GpuKind::Renderbuffer, _renderbuffer,
+                         GpuCategory::RenderTarget);
+    }
+    Renderbuffer(Renderbuffer &&o)
+        : _renderbuffer{std::exchange(o._renderbuffer, 0)} {};
     Renderbuffer(const Renderbuffer &) = delete;
     Renderbuffer &operator=(Renderbuffer &&o) {
-        _renderbuffer = o._renderbuffer;
+        std::swap(_renderbuffer, o._renderbuffer);
         return *this;
     };
     Renderbuffer &operator=(const Renderbuffer &) = delete;
-    ~Renderbuffer() { glDeleteRenderbuffers(1, &_renderbuffer); }
+    ~Renderbuffer() {
+        if (_renderbuffer) {
+            gl_state().forget_renderbuffer(_renderbuffer);
+            gpu_memory().remove(GpuKind::Renderbuffer, _renderbuffer);
+            glDeleteRenderbuffers(1, &_renderbuffer);
+        }
+    }
 
-    inline void bind() const {
-        glBindRenderbuffer(GL_RENDERBUFFER, _renderbuffer);
+    // name the owner in the gpu memory report
+    inline void label(const std::string &owner) const {
+        gpu_memory().set_owner(GpuKind::Renderbuffer, _renderbuffer, owner);
+    }
+
+    inline void bind() const { gl_state().bind_renderbuffer(_renderbuffer); }
+
+    // (re)allocate the storage
+    inline void storage(GLenum internal_format, GLsizei width,
+                        GLsizei height) const {
+        gl_state().renderbuffer_storage(_renderbuffer, internal_format, width,
+                                        height);
+        gpu_memory().resize(GpuKind::Renderbuffer, _renderbuffer,
+                            size_t(width) * size_t(height) *
+                                gpu_texel_bytes(internal_format),
+                            internal_format, width, height);
     }
 
     inline operator GLuint() const { return _renderbuffer; }
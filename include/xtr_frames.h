@@ -0,0 +1,159 @@
+// frames in flight
+// the cpu records the next frame while the gpu still renders the previous
+// ones. every frame ends with a fence, and before recording a frame the cpu
+// waits until fewer than count frames are unfinished, so the gpu is never
+// more than count frames behind. per-frame resources come in max_count
+// slots, the slot of a frame is not in use by the gpu once begin returns
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <xtr_buffer.h>
+#include <xtr_trace.h>
+
+namespace xtr {
+class FramesInFlight {
+  public:
+    static constexpr int max_count = 3;
+
+    FramesInFlight() = default;
+    FramesInFlight(const FramesInFlight &) = delete;
+    FramesInFlight &operator=(const FramesInFlight &) = delete;
+    ~FramesInFlight() {
+        for (const Pending &pending : _pending) {
+            glDeleteSync(pending.fence);
+        }
+    }
+
+    // frames the gpu may be behind by, 1 waits for each frame to finish
+    // before recording the next
+    int count = 2;
+
+    // wait until the slot of the next frame is free
+    inline void begin() {
+        XTR_TRACE_SCOPE("frame fence");
+        // the frames that finished without waiting
+        while (!_pending.empty() && signaled(_pending.front().fence, 0)) {
+            retire();
+        }
+        // the gpu is still rendering an earlier frame as this one starts
+        const bool overlapped = !_pending.empty();
+        const auto wait_start = std::chrono::steady_clock::now();
+        const size_t limit = size_t(std::clamp(count, 1, max_count) - 1);
+        while (_pending.size() > limit) {
+            while (!signaled(_pending.front().fence, 1000000)) {
+            }
+            retire();
+        }
+        const double wait_ms =
+            std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - wait_start)
+                .count();
+        _wait_ms += (wait_ms - _wait_ms) * 0.05;
+        _overlap += ((overlapped ? 1. : 0.) - _overlap) * 0.05;
+        _depth += (double(_pending.size()) - _depth) * 0.05;
+    }
+
+    // fence the commands of the frame, after it is presented
+    inline void end() {
+        _pending.push_back(
+            {_frame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+        ++_frame;
+    }
+
+    // the number of the frame being recorded and its resource slot
+    inline uint64_t frame() const { return _frame; }
+    inline int slot() const { return int(_frame % max_count); }
+
+    // smoothed time waiting on fences per frame, the fraction of frames
+    // recorded while the gpu was still busy with an earlier one, and the
+    // frames the gpu was behind once the wait was over
+    inline double wait_ms() const { return _wait_ms; }
+    inline double overlap() const { return _overlap; }
+    inline double depth() const { return _depth; }
+
+  private:
+    struct Pending {
+        uint64_t frame;
+        GLsync fence;
+    };
+
+    static inline bool signaled(const GLsync fence, const GLuint64 timeout) {
+        const GLenum status =
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        return status != GL_TIMEOUT_EXPIRED;
+    }
+
+    inline void retire() {
+        glDeleteSync(_pending.front().fence);
+        _pending.pop_front();
+    }
+
+    std::deque<Pending> _pending;
+    uint64_t _frame = 0;
+    double _wait_ms = 0., _overlap = 0., _depth = 0.;
+};
+
+// asynchronous read of one pixel of a float rgb target, through one pixel
+// pack buffer per frame slot. a pixel is read back count frames after it
+// was requested, when the gpu has finished that frame for sure, so mapping
+// never stalls and the delay does not depend on timing
+class PixelReadback {
+  public:
+    PixelReadback()
+        : _pbos{Buffer{GL_PIXEL_PACK_BUFFER}, Buffer{GL_PIXEL_PACK_BUFFER},
+                Buffer{GL_PIXEL_PACK_BUFFER}} {
+        for (const Buffer &pbo : _pbos) {
+            pbo.label("pixel readback");
+            pbo.data(sizeof(glm::vec3), nullptr, GL_STREAM_READ);
+            pbo.unbind();
+        }
+    }
+
+    // queue a read of pixel x, y of the bound read framebuffer's current
+    // read buffer, in the slot of the frame being recorded
+    inline void request(const FramesInFlight &frames, const int x,
+                        const int y) {
+        const int slot = frames.slot();
+        _pbos[slot].bind();
+        glReadPixels(x, y, 1, 1, GL_RGB, GL_FLOAT, nullptr);
+        _pbos[slot].unbind();
+        _frames[slot] = frames.frame();
+    }
+
+    // the newest requested pixel whose frame is count frames old, if any
+    inline std::optional<glm::vec3> poll(const FramesInFlight &frames) {
+        std::optional<glm::vec3> result;
+        uint64_t newest = 0;
+        const uint64_t delay = uint64_t(std::clamp(frames.count, 1,
+                                                   FramesInFlight::max_count));
+        for (int slot = 0; slot < FramesInFlight::max_count; ++slot) {
+            const std::optional<uint64_t> frame = _frames[slot];
+            if (!frame || *frame + delay > frames.frame()) {
+                continue;
+            }
+            _frames[slot].reset();
+            _pbos[slot].bind();
+            const void *data = glMapBufferRange(
+                GL_PIXEL_PACK_BUFFER, 0, sizeof(glm::vec3), GL_MAP_READ_BIT);
+            if (data) {
+                if (!result || *frame >= newest) {
+                    result = *static_cast<const glm::vec3 *>(data);
+                    newest = *frame;
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            _pbos[slot].unbind();
+        }
+        return result;
+    }
+
+  private:
+    Buffer _pbos[FramesInFlight::max_count];
+    std::optional<uint64_t> _frames[FramesInFlight::max_count];
+};
+} // namespace xtr
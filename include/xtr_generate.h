@@ -0,0 +1,279 @@
+// procedural meshes for scaling tests
+// a path like "generated/sphere-1M.gen" names a mesh that is generated
+// instead of read, with about the given number of triangles, so load_mesh
+// treats it as any other file. the shapes are
+// - sphere, a subdivided cube pushed out onto the unit sphere
+// - terrain, a grid displaced by a few octaves of value noise
+// - assembly, a lattice of small spheres and boxes as separate parts
+// everything is derived from the shape and the count, the same path always
+// gives the same mesh
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include <xtr_parallel.h>
+
+namespace xtr {
+enum class GeneratedShape { Sphere, Terrain, Assembly };
+
+constexpr const char *generated_shape_names[] = {"sphere", "terrain",
+                                                 "assembly"};
+// the range of triangle counts, counts outside it are clamped
+constexpr size_t generated_min_triangles = 1000;
+constexpr size_t generated_max_triangles = 100000000;
+
+struct GeneratedSpec {
+    GeneratedShape shape = GeneratedShape::Sphere;
+    size_t triangles = 0;
+};
+
+// whether file_path names a generated mesh
+inline bool is_generated(const std::filesystem::path &file_path) {
+    return file_path.extension() == ".gen";
+}
+
+// read the shape and the triangle count from a name like "terrain-250k",
+// with an optional k or m suffix
+inline bool parse_generated(const std::filesystem::path &file_path,
+                            GeneratedSpec &spec) {
+    const std::string stem = file_path.stem().string();
+    const size_t dash = stem.rfind('-');
+    if (dash == std::string::npos) {
+        return false;
+    }
+    const std::string name = stem.substr(0, dash);
+    bool found = false;
+    for (size_t s = 0; s < std::size(generated_shape_names); ++s) {
+        if (name == generated_shape_names[s]) {
+            spec.shape = GeneratedShape(s);
+            found = true;
+        }
+    }
+    char *end = nullptr;
+    double count = std::strtod(stem.c_str() + dash + 1, &end);
+    if (!found || end == stem.c_str() + dash + 1) {
+        return false;
+    }
+    if (*end == 'k' || *end == 'K') {
+        count *= 1e3;
+    } else if (*end == 'm' || *end == 'M') {
+        count *= 1e6;
+    }
+    spec.triangles = std::clamp(size_t(std::max(0., count)),
+                                generated_min_triangles,
+                                generated_max_triangles);
+    return true;
+}
+
+// the name parse_generated reads back, e.g. "sphere-1M.gen"
+inline std::string generated_name(const GeneratedShape shape,
+                                  const size_t triangles) {
+    std::string count = std::to_string(triangles);
+    if (triangles % 1000000 == 0) {
+        count = std::to_string(triangles / 1000000) + "M";
+    } else if (triangles % 1000 == 0) {
+        count = std::to_string(triangles / 1000) + "K";
+    }
+    return std::string{generated_shape_names[int(shape)]} + "-" + count +
+           ".gen";
+}
+
+namespace generate_detail {
+// a well mixed 32 bit hash of three integers
+inline uint32_t hash(uint32_t x, const uint32_t y, const uint32_t z) {
+    x = x * 0x8da6b343u ^ y * 0xd8163841u ^ z * 0xcb1ab31fu;
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+inline float unit_hash(const uint32_t x, const uint32_t y, const uint32_t z) {
+    return float(hash(x, y, z) >> 8) / float(1 << 24);
+}
+
+// smooth value noise in [0, 1], one lattice per octave
+inline float value_noise(const float x, const float z, const uint32_t octave) {
+    const float fx = std::floor(x), fz = std::floor(z);
+    const uint32_t ix = uint32_t(int32_t(fx)), iz = uint32_t(int32_t(fz));
+    float tx = x - fx, tz = z - fz;
+    tx = tx * tx * (3.f - 2.f * tx);
+    tz = tz * tz * (3.f - 2.f * tz);
+    const float a = unit_hash(ix, iz, octave);
+    const float b = unit_hash(ix + 1, iz, octave);
+    const float c = unit_hash(ix, iz + 1, octave);
+    const float d = unit_hash(ix + 1, iz + 1, octave);
+    const float ab = a + (b - a) * tx, cd = c + (d - c) * tx;
+    return ab + (cd - ab) * tz;
+}
+
+// the six faces of a cube, normal first, with u x v along the normal
+inline std::array<glm::vec3, 3> cube_face(const int face) {
+    const int axis = face % 3;
+    glm::vec3 n{0.f}, u{0.f}, v{0.f};
+    n[axis] = face < 3 ? 1.f : -1.f;
+    u[(axis + 1) % 3] = 1.f;
+    v[(axis + 2) % 3] = 1.f;
+    return face < 3 ? std::array{n, u, v} : std::array{n, v, u};
+}
+
+// row j of a face of a cube of n x n quads per face, into ps and indices
+// from vertex first on. the cube is pushed onto the unit sphere when round,
+// turned by angle about y, scaled and moved to center. each face has its
+// own vertices, so a box keeps its hard edges
+inline void cube_row(const size_t n, const bool round, const glm::vec3 &center,
+                     const float scale, const float angle, glm::vec3 *ps,
+                     int *indices, const size_t first, const int face,
+                     const size_t j) {
+    const size_t side = n + 1;
+    const float c = std::cos(angle), s = std::sin(angle);
+    const auto [normal, u, v] = cube_face(face);
+    const size_t base = size_t(face) * side * side;
+    for (size_t i = 0; i < side; ++i) {
+        glm::vec3 p = normal + u * (2.f * float(i) / float(n) - 1.f) +
+                      v * (2.f * float(j) / float(n) - 1.f);
+        if (round) {
+            p = glm::normalize(p);
+        }
+        p = glm::vec3{c * p.x + s * p.z, p.y, c * p.z - s * p.x};
+        ps[base + j * side + i] = center + p * scale;
+    }
+    if (j == n) {
+        return;
+    }
+    int *out = indices + (size_t(face) * n + j) * n * 6;
+    for (size_t i = 0; i < n; ++i) {
+        const int a = int(first + base + j * side + i);
+        const int b = a + 1, d = a + int(side), e = d + 1;
+        const int quad[6] = {a, b, e, a, e, d};
+        out = std::copy(quad, quad + 6, out);
+    }
+}
+
+inline void cube(const size_t n, const bool round, const glm::vec3 &center,
+                 const float scale, const float angle, glm::vec3 *ps,
+                 int *indices, const size_t first) {
+    for (int face = 0; face < 6; ++face) {
+        for (size_t j = 0; j <= n; ++j) {
+            cube_row(n, round, center, scale, angle, ps, indices, first, face,
+                     j);
+        }
+    }
+}
+
+inline size_t cube_vertices(const size_t n) { return 6 * (n + 1) * (n + 1); }
+inline size_t cube_triangles(const size_t n) { return 12 * n * n; }
+} // namespace generate_detail
+
+// positions and triangles of a generated mesh, as the file loaders return
+inline std::pair<std::vector<glm::vec3>, std::vector<int>>
+generate_mesh(const GeneratedSpec &spec) {
+    using namespace generate_detail;
+    std::vector<glm::vec3> ps;
+    std::vector<int> indices;
+    const double triangles = double(spec.triangles);
+    switch (spec.shape) {
+    case GeneratedShape::Sphere: {
+        const size_t n =
+            std::max<size_t>(1, size_t(std::sqrt(triangles / 12.) + 0.5));
+        ps.resize(cube_vertices(n));
+        indices.resize(cube_triangles(n) * 3);
+        parallel_for(6 * (n + 1), [&](const size_t begin, const size_t end) {
+            for (size_t row = begin; row < end; ++row) {
+                cube_row(n, true, glm::vec3{0.f}, 1.f, 0.f, ps.data(),
+                         indices.data(), 0, int(row / (n + 1)), row % (n + 1));
+            }
+        }, 16);
+        break;
+    }
+    case GeneratedShape::Terrain: {
+        // n x n vertices, two triangles per cell
+        const size_t n =
+            std::max<size_t>(2, size_t(std::sqrt(triangles / 2.) + 1.5));
+        ps.resize(n * n);
+        indices.resize((n - 1) * (n - 1) * 6);
+        parallel_for(n, [&](const size_t begin, const size_t end) {
+            for (size_t j = begin; j < end; ++j) {
+                for (size_t i = 0; i < n; ++i) {
+                    const float x = 2.f * float(i) / float(n - 1) - 1.f;
+                    const float z = 2.f * float(j) / float(n - 1) - 1.f;
+                    float height = 0.f, amplitude = 0.5f, frequency = 4.f;
+                    for (uint32_t octave = 0; octave < 6; ++octave) {
+                        height += amplitude * value_noise(x * frequency,
+                                                          z * frequency,
+                                                          octave);
+                        amplitude *= 0.5f;
+                        frequency *= 2.f;
+                    }
+                    ps[j * n + i] = {x, 0.5f * height, z};
+                }
+            }
+        }, 16);
+        parallel_for(n - 1, [&](const size_t begin, const size_t end) {
+            for (size_t j = begin; j < end; ++j) {
+                int *out = &indices[j * (n - 1) * 6];
+                for (size_t i = 0; i + 1 < n; ++i) {
+                    const int a = int(j * n + i), b = a + 1;
+                    const int d = a + int(n), c = d + 1;
+                    const int quad[6] = {a, d, b, b, d, c};
+                    out = std::copy(quad, quad + 6, out);
+                }
+            }
+        }, 16);
+        break;
+    }
+    case GeneratedShape::Assembly: {
+        // parts of 8 x 8 quads per face, fewer quads for a single part
+        size_t n = 8;
+        size_t parts = size_t(triangles) / cube_triangles(n);
+        if (parts == 0) {
+            n = std::max<size_t>(1, size_t(std::sqrt(triangles / 12.)));
+            parts = 1;
+        }
+        size_t grid = 1;
+        while (grid * grid * grid < parts) {
+            ++grid;
+        }
+        ps.resize(parts * cube_vertices(n));
+        indices.resize(parts * cube_triangles(n) * 3);
+        parallel_for(parts, [&](const size_t begin, const size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                const glm::vec3 cell{float(k % grid), float(k / grid % grid),
+                                     float(k / grid / grid)};
+                const glm::vec3 center =
+                    (cell + 0.5f) / float(grid) * 2.f - 1.f;
+                const uint32_t id = uint32_t(k);
+                const float scale =
+                    (0.25f + 0.15f * unit_hash(id, 1, 0)) / float(grid);
+                const bool round = unit_hash(id, 2, 0) < 0.5f;
+                const float angle = 6.2831853f * unit_hash(id, 3, 0);
+                cube(n, round, center, scale, angle,
+                     &ps[k * cube_vertices(n)],
+                     &indices[k * cube_triangles(n) * 3],
+                     k * cube_vertices(n));
+            }
+        }, 64);
+        break;
+    }
+    }
+    return {std::move(ps), std::move(indices)};
+}
+
+inline std::pair<std::vector<glm::vec3>, std::vector<int>>
+generate_mesh(const std::filesystem::path &file_path) {
+    GeneratedSpec spec;
+    if (!parse_generated(file_path, spec)) {
+        return {};
+    }
+    return generate_mesh(spec);
+}
+} // namespace xtr
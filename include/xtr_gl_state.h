@@ -0,0 +1,485 @@
+// cache of the opengl bindings made through the raii wrappers
+// binding what is already bound is skipped, and with direct state access
+// (gl 4.5 or ARB_direct_state_access) objects are edited without binding at
+// all. code that binds behind the cache calls invalidate afterwards
+#pragma once
+#include <cstring>
+#include <glad/gl.h>
+
+namespace xtr {
+class GLState {
+  public:
+    // binding calls that reached the driver and those that were skipped
+    struct Counters {
+        size_t issued = 0, elided = 0;
+    };
+
+    GLState() { invalidate(); }
+
+    // with the context current, load the direct state access entry points
+    // when the context has them and use is true, and immutable texture
+    // storage (gl 4.2 or ARB_texture_storage) and buffer storage (gl 4.4 or
+    // ARB_buffer_storage) when the context has them
+    inline void init(GLADloadfunc load, const bool use_dsa) {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        const bool available = major > 4 || (major == 4 && minor >= 5) ||
+                               has_extension("GL_ARB_direct_state_access");
+        _dsa = false;
+        if (use_dsa && available) {
+            load_dsa(load);
+        }
+        _tex_storage_2d = nullptr;
+        _texture_storage_2d = nullptr;
+        if (major > 4 || (major == 4 && minor >= 2) ||
+            has_extension("GL_ARB_texture_storage")) {
+            load_entry(load, "glTexStorage2D", _tex_storage_2d);
+            // direct state access only has it along with texture storage
+            if (_dsa) {
+                load_entry(load, "glTextureStorage2D", _texture_storage_2d);
+            }
+        }
+        _buffer_storage = nullptr;
+        _named_buffer_storage = nullptr;
+        if (major > 4 || (major == 4 && minor >= 4) ||
+            has_extension("GL_ARB_buffer_storage")) {
+            load_entry(load, "glBufferStorage", _buffer_storage);
+            if (_dsa) {
+                load_entry(load, "glNamedBufferStorage",
+                           _named_buffer_storage);
+            }
+        }
+        invalidate();
+    }
+    inline bool dsa() const { return _dsa; }
+    inline bool texture_storage() const { return _tex_storage_2d != nullptr; }
+    inline bool buffer_storage() const { return _buffer_storage != nullptr; }
+
+    // skip redundant bindings, off issues every call for comparison
+    bool caching = true;
+
+    inline void use_program(const GLuint program) {
+        if (check(_program, program)) {
+            glUseProgram(program);
+        }
+    }
+
+    inline void bind_vertex_array(const GLuint array) {
+        if (check(_array, array)) {
+            glBindVertexArray(array);
+        }
+    }
+
+    // the element array binding belongs to the vertex array, it is not cached
+    inline void bind_buffer(const GLenum target, const GLuint buffer) {
+        GLuint *bound = buffer_slot(target);
+        if (!bound || check(*bound, buffer)) {
+            if (!bound) {
+                ++_counters.issued;
+            }
+            glBindBuffer(target, buffer);
+        }
+    }
+
+    // GL_FRAMEBUFFER binds both the draw and the read framebuffer
+    inline void bind_framebuffer(const GLenum target,
+                                 const GLuint framebuffer) {
+        if (target == GL_FRAMEBUFFER) {
+            if (caching && _draw_framebuffer == framebuffer &&
+                _read_framebuffer == framebuffer) {
+                ++_counters.elided;
+                return;
+            }
+            ++_counters.issued;
+            _draw_framebuffer = _read_framebuffer = framebuffer;
+            glBindFramebuffer(target, framebuffer);
+        } else if (check(target == GL_READ_FRAMEBUFFER ? _read_framebuffer
+                                                       : _draw_framebuffer,
+                         framebuffer)) {
+            glBindFramebuffer(target, framebuffer);
+        }
+    }
+    inline GLuint draw_framebuffer() const { return _draw_framebuffer; }
+
+    inline void bind_renderbuffer(const GLuint renderbuffer) {
+        if (check(_renderbuffer, renderbuffer)) {
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+        }
+    }
+
+    inline void active_texture(const GLuint unit) {
+        if (check(_active_unit, unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+    }
+
+    // bind to the active unit, only 2d textures are cached
+    inline void bind_texture(const GLenum target, const GLuint texture) {
+        if (target != GL_TEXTURE_2D || _active_unit >= unit_count) {
+            ++_counters.issued;
+            glBindTexture(target, texture);
+        } else if (check(_textures[_active_unit], texture)) {
+            glBindTexture(target, texture);
+        }
+    }
+
+    // bind to unit, without changing the active unit when dsa is used
+    inline void bind_texture_unit(const GLuint unit, const GLenum target,
+                                  const GLuint texture) {
+        if (_dsa && target == GL_TEXTURE_2D && unit < unit_count) {
+            if (check(_textures[unit], texture)) {
+                _bind_texture_unit(unit, texture);
+            }
+            return;
+        }
+        active_texture(unit);
+        bind_texture(target, texture);
+    }
+
+    // the object is deleted, a new object may reuse its name
+    inline void forget_program(const GLuint program) {
+        forget(_program, program);
+    }
+    inline void forget_vertex_array(const GLuint array) {
+        forget(_array, array);
+    }
+    inline void forget_buffer(const GLuint buffer) {
+        for (GLuint &bound : _buffers) {
+            forget(bound, buffer);
+        }
+    }
+    inline void forget_framebuffer(const GLuint framebuffer) {
+        forget(_draw_framebuffer, framebuffer);
+        forget(_read_framebuffer, framebuffer);
+    }
+    inline void forget_renderbuffer(const GLuint renderbuffer) {
+        forget(_renderbuffer, renderbuffer);
+    }
+    inline void forget_texture(const GLuint texture) {
+        for (GLuint &bound : _textures) {
+            forget(bound, texture);
+        }
+    }
+
+    // nothing is known to be bound, the next binding of each kind is issued
+    inline void invalidate() {
+        _program = _array = _renderbuffer = unknown;
+        _draw_framebuffer = _read_framebuffer = unknown;
+        _active_unit = unknown;
+        for (GLuint &bound : _buffers) {
+            bound = unknown;
+        }
+        for (GLuint &bound : _textures) {
+            bound = unknown;
+        }
+    }
+
+    // once per frame, keep the counters of the frame that ended
+    inline void end_frame() {
+        _last_frame = _counters;
+        _counters = {};
+    }
+    inline const Counters &last_frame() const { return _last_frame; }
+
+    // object creation and editing, direct when dsa is used and through the
+    // binding otherwise
+    inline GLuint create_buffer() {
+        GLuint buffer = 0;
+        _dsa ? _create_buffers(1, &buffer) : glGenBuffers(1, &buffer);
+        return buffer;
+    }
+    inline GLuint create_vertex_array() {
+        GLuint array = 0;
+        _dsa ? _create_vertex_arrays(1, &array) : glGenVertexArrays(1, &array);
+        return array;
+    }
+    inline GLuint create_texture(const GLenum target) {
+        GLuint texture = 0;
+        _dsa ? _create_textures(target, 1, &texture)
+             : glGenTextures(1, &texture);
+        return texture;
+    }
+    inline GLuint create_framebuffer() {
+        GLuint framebuffer = 0;
+        _dsa ? _create_framebuffers(1, &framebuffer)
+             : glGenFramebuffers(1, &framebuffer);
+        return framebuffer;
+    }
+    inline GLuint create_renderbuffer() {
+        GLuint renderbuffer = 0;
+        _dsa ? _create_renderbuffers(1, &renderbuffer)
+             : glGenRenderbuffers(1, &renderbuffer);
+        return renderbuffer;
+    }
+
+    inline void buffer_data(const GLenum target, const GLuint buffer,
+                            const GLsizeiptr size, const void *data,
+                            const GLenum usage) {
+        if (_dsa) {
+            _named_buffer_data(buffer, size, data, usage);
+            return;
+        }
+        bind_buffer(target, buffer);
+        glBufferData(target, size, data, usage);
+    }
+    inline void buffer_sub_data(const GLenum target, const GLuint buffer,
+                                const GLintptr offset, const GLsizeiptr size,
+                                const void *data) {
+        if (_dsa) {
+            _named_buffer_sub_data(buffer, offset, size, data);
+            return;
+        }
+        bind_buffer(target, buffer);
+        glBufferSubData(target, offset, size, data);
+    }
+    // immutable storage of size bytes, false when the context has none and
+    // the caller has to fall back to mutable storage
+    inline bool buffer_storage(const GLenum target, const GLuint buffer,
+                               const GLsizeiptr size, const void *data,
+                               const GLbitfield flags) {
+        if (_dsa && _named_buffer_storage) {
+            _named_buffer_storage(buffer, size, data, flags);
+            return true;
+        }
+        if (!_buffer_storage) {
+            return false;
+        }
+        bind_buffer(target, buffer);
+        _buffer_storage(target, size, data, flags);
+        return true;
+    }
+    inline void copy_buffer(const GLuint read_buffer, const GLuint write_buffer,
+                            const GLintptr read_offset,
+                            const GLintptr write_offset,
+                            const GLsizeiptr size) {
+        if (_dsa) {
+            _copy_named_buffer_sub_data(read_buffer, write_buffer, read_offset,
+                                        write_offset, size);
+            return;
+        }
+        bind_buffer(GL_COPY_READ_BUFFER, read_buffer);
+        bind_buffer(GL_COPY_WRITE_BUFFER, write_buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            read_offset, write_offset, size);
+    }
+
+    inline void texture_parameter(const GLenum target, const GLuint texture,
+                                  const GLenum name, const GLint value) {
+        if (_dsa) {
+            _texture_parameteri(texture, name, value);
+            return;
+        }
+        bind_texture(target, texture);
+        glTexParameteri(target, name, value);
+    }
+
+    // immutable storage for one level, false when the context has none and
+    // the caller has to fall back to mutable storage
+    inline bool texture_storage_2d(const GLenum target, const GLuint texture,
+                                   const GLenum internal_format,
+                                   const GLsizei width, const GLsizei height) {
+        if (_dsa && _texture_storage_2d) {
+            _texture_storage_2d(texture, 1, internal_format, width, height);
+            return true;
+        }
+        if (!_tex_storage_2d) {
+            return false;
+        }
+        bind_texture(target, texture);
+        _tex_storage_2d(target, 1, internal_format, width, height);
+        return true;
+    }
+
+    inline void renderbuffer_storage(const GLuint renderbuffer,
+                                     const GLenum internal_format,
+                                     const GLsizei width,
+                                     const GLsizei height) {
+        if (_dsa) {
+            _named_renderbuffer_storage(renderbuffer, internal_format, width,
+                                        height);
+            return;
+        }
+        bind_renderbuffer(renderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, internal_format, width,
+                              height);
+    }
+
+    // framebuffer edits without dsa restore the draw framebuffer, so editing
+    // never redirects drawing
+    inline void framebuffer_texture(const GLuint framebuffer,
+                                    const GLenum attachment,
+                                    const GLuint texture) {
+        if (_dsa) {
+            _named_framebuffer_texture(framebuffer, attachment, texture, 0);
+            return;
+        }
+        edit_framebuffer(framebuffer, [&]() {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D,
+                                   texture, 0);
+        });
+    }
+    inline void framebuffer_renderbuffer(const GLuint framebuffer,
+                                         const GLenum attachment,
+                                         const GLuint renderbuffer) {
+        if (_dsa) {
+            _named_framebuffer_renderbuffer(framebuffer, attachment,
+                                            GL_RENDERBUFFER, renderbuffer);
+            return;
+        }
+        edit_framebuffer(framebuffer, [&]() {
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment,
+                                      GL_RENDERBUFFER, renderbuffer);
+        });
+    }
+    inline void framebuffer_draw_buffers(const GLuint framebuffer,
+                                         const GLsizei count,
+                                         const GLenum *buffers) {
+        if (_dsa) {
+            _named_framebuffer_draw_buffers(framebuffer, count, buffers);
+            return;
+        }
+        edit_framebuffer(framebuffer,
+                         [&]() { glDrawBuffers(count, buffers); });
+    }
+
+  private:
+    static constexpr GLuint unknown = ~GLuint(0);
+    static constexpr GLuint unit_count = 32;
+
+    // true when the binding has to be issued, in which case it is recorded
+    inline bool check(GLuint &bound, const GLuint object) {
+        if (caching && bound == object) {
+            ++_counters.elided;
+            return false;
+        }
+        ++_counters.issued;
+        bound = object;
+        return true;
+    }
+
+    static inline void forget(GLuint &bound, const GLuint object) {
+        if (bound == object) {
+            bound = unknown;
+        }
+    }
+
+    inline GLuint *buffer_slot(const GLenum target) {
+        switch (target) {
+        case GL_ARRAY_BUFFER:
+            return &_buffers[0];
+        case GL_COPY_READ_BUFFER:
+            return &_buffers[1];
+        case GL_COPY_WRITE_BUFFER:
+            return &_buffers[2];
+        case GL_PIXEL_PACK_BUFFER:
+            return &_buffers[3];
+        case GL_PIXEL_UNPACK_BUFFER:
+            return &_buffers[4];
+        default:
+            return nullptr;
+        }
+    }
+
+    template <class F>
+    inline void edit_framebuffer(const GLuint framebuffer, F &&edit) {
+        const GLuint previous = _draw_framebuffer;
+        bind_framebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        edit();
+        bind_framebuffer(GL_DRAW_FRAMEBUFFER,
+                         previous == unknown ? 0 : previous);
+    }
+
+    template <class T>
+    static inline bool load_entry(GLADloadfunc load, const char *name,
+                                  T &entry) {
+        entry = reinterpret_cast<T>(load(name));
+        return entry != nullptr;
+    }
+
+    static inline bool has_extension(const char *extension) {
+        GLint extension_count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+        for (GLint i = 0; i < extension_count; ++i) {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+            if (name && strcmp(name, extension) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline void load_dsa(GLADloadfunc load) {
+        _dsa =
+            load_entry(load, "glCreateBuffers", _create_buffers) &&
+            load_entry(load, "glCreateVertexArrays", _create_vertex_arrays) &&
+            load_entry(load, "glCreateTextures", _create_textures) &&
+            load_entry(load, "glCreateFramebuffers", _create_framebuffers) &&
+            load_entry(load, "glCreateRenderbuffers", _create_renderbuffers) &&
+            load_entry(load, "glNamedBufferData", _named_buffer_data) &&
+            load_entry(load, "glNamedBufferSubData", _named_buffer_sub_data) &&
+            load_entry(load, "glCopyNamedBufferSubData",
+                       _copy_named_buffer_sub_data) &&
+            load_entry(load, "glTextureParameteri", _texture_parameteri) &&
+            load_entry(load, "glBindTextureUnit", _bind_texture_unit) &&
+            load_entry(load, "glNamedRenderbufferStorage",
+                       _named_renderbuffer_storage) &&
+            load_entry(load, "glNamedFramebufferTexture",
+                       _named_framebuffer_texture) &&
+            load_entry(load, "glNamedFramebufferRenderbuffer",
+                       _named_framebuffer_renderbuffer) &&
+            load_entry(load, "glNamedFramebufferDrawBuffers",
+                       _named_framebuffer_draw_buffers);
+    }
+
+    GLuint _program = unknown, _array = unknown, _renderbuffer = unknown;
+    GLuint _draw_framebuffer = unknown, _read_framebuffer = unknown;
+    GLuint _active_unit = unknown;
+    GLuint _buffers[5];
+    GLuint _textures[unit_count];
+    Counters _counters, _last_frame;
+
+    // gl 4.5 entry points, glad is generated for 3.3
+    bool _dsa = false;
+    void(GLAD_API_PTR *_create_buffers)(GLsizei, GLuint *) = nullptr;
+    void(GLAD_API_PTR *_create_vertex_arrays)(GLsizei, GLuint *) = nullptr;
+    void(GLAD_API_PTR *_create_textures)(GLenum, GLsizei, GLuint *) = nullptr;
+    void(GLAD_API_PTR *_create_framebuffers)(GLsizei, GLuint *) = nullptr;
+    void(GLAD_API_PTR *_create_renderbuffers)(GLsizei, GLuint *) = nullptr;
+    void(GLAD_API_PTR *_named_buffer_data)(GLuint, GLsizeiptr, const void *,
+                                           GLenum) = nullptr;
+    void(GLAD_API_PTR *_named_buffer_sub_data)(GLuint, GLintptr, GLsizeiptr,
+                                               const void *) = nullptr;
+    void(GLAD_API_PTR *_copy_named_buffer_sub_data)(GLuint, GLuint, GLintptr,
+                                                    GLintptr,
+                                                    GLsizeiptr) = nullptr;
+    void(GLAD_API_PTR *_texture_parameteri)(GLuint, GLenum, GLint) = nullptr;
+    void(GLAD_API_PTR *_bind_texture_unit)(GLuint, GLuint) = nullptr;
+    void(GLAD_API_PTR *_named_renderbuffer_storage)(GLuint, GLenum, GLsizei,
+                                                    GLsizei) = nullptr;
+    void(GLAD_API_PTR *_named_framebuffer_texture)(GLuint, GLenum, GLuint,
+                                                   GLint) = nullptr;
+    void(GLAD_API_PTR *_named_framebuffer_renderbuffer)(GLuint, GLenum,
+                                                        GLenum,
+                                                        GLuint) = nullptr;
+    void(GLAD_API_PTR *_named_framebuffer_draw_buffers)(
+        GLuint, GLsizei, const GLenum *) = nullptr;
+    void(GLAD_API_PTR *_texture_storage_2d)(GLuint, GLsizei, GLenum, GLsizei,
+                                            GLsizei) = nullptr;
+    void(GLAD_API_PTR *_named_buffer_storage)(GLuint, GLsizeiptr,
+                                              const void *,
+                                              GLbitfield) = nullptr;
+    // gl 4.2 or ARB_texture_storage
+    void(GLAD_API_PTR *_tex_storage_2d)(GLenum, GLsizei, GLenum, GLsizei,
+                                        GLsizei) = nullptr;
+    // gl 4.4 or ARB_buffer_storage
+    void(GLAD_API_PTR *_buffer_storage)(GLenum, GLsizeiptr, const void *,
+                                        GLbitfield) = nullptr;
+};
+
+// the state of the one context the app renders with
+inline GLState &gl_state() {
+    static GLState state;
+    return state;
+}
+} // namespace xtr
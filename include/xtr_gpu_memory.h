@@ -0,0 +1,262 @@
+// accounting of the gpu memory held by the raii wrappers
+// every buffer, texture and renderbuffer registers itself on creation and
+// reports the size of its storage whenever it is (re)allocated, so the live
+// bytes per category and their high-water mark are known at any time. what
+// is still registered when the context goes away has leaked
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <glad/gl.h>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace xtr {
+enum class GpuKind { Buffer, Texture, Renderbuffer };
+enum class GpuCategory { Geometry, Staging, RenderTarget, Texture, Count };
+
+inline const char *gpu_kind_name(const GpuKind kind) {
+    switch (kind) {
+    case GpuKind::Buffer:
+        return "buffer";
+    case GpuKind::Texture:
+        return "texture";
+    default:
+        return "renderbuffer";
+    }
+}
+
+inline const char *gpu_category_name(const GpuCategory category) {
+    switch (category) {
+    case GpuCategory::Geometry:
+        return "geometry";
+    case GpuCategory::Staging:
+        return "staging";
+    case GpuCategory::RenderTarget:
+        return "render target";
+    default:
+        return "texture";
+    }
+}
+
+// bytes per texel of the internal formats in use, 4 for unknown ones. the
+// unsized depth format is assumed to be stored in 32 bits
+inline size_t gpu_texel_bytes(const GLenum internal_format) {
+    switch (internal_format) {
+    case GL_R8:
+    case GL_RED:
+        return 1;
+    case GL_R16F:
+    case GL_RG8:
+        return 2;
+    case GL_RGB8:
+    case GL_RGB:
+        return 3;
+    case GL_RGB16F:
+        return 6;
+    case GL_RGBA16F:
+    case GL_RG32F:
+        return 8;
+    case GL_RGB32F:
+        return 12;
+    case GL_RGBA32F:
+    case GL_RGBA32UI:
+        return 16;
+    default:
+        return 4;
+    }
+}
+
+inline const char *gpu_format_name(const GLenum format) {
+    switch (format) {
+    case GL_RGBA:
+        return "RGBA";
+    case GL_RGBA8:
+        return "RGBA8";
+    case GL_RGB16F:
+        return "RGB16F";
+    case GL_RGBA16F:
+        return "RGBA16F";
+    case GL_R16F:
+        return "R16F";
+    case GL_RGB32F:
+        return "RGB32F";
+    case GL_RGBA32F:
+        return "RGBA32F";
+    case GL_RGBA32UI:
+        return "RGBA32UI";
+    case GL_R8:
+        return "R8";
+    case GL_DEPTH_COMPONENT:
+        return "DEPTH";
+    case GL_DEPTH_COMPONENT24:
+        return "DEPTH24";
+    case GL_DEPTH24_STENCIL8:
+        return "DEPTH24_STENCIL8";
+    case GL_STATIC_DRAW:
+        return "STATIC_DRAW";
+    case GL_DYNAMIC_DRAW:
+        return "DYNAMIC_DRAW";
+    case GL_STREAM_DRAW:
+        return "STREAM_DRAW";
+    case GL_STREAM_READ:
+        return "STREAM_READ";
+    default:
+        return "other";
+    }
+}
+
+class GpuMemory {
+  public:
+    // one live object, format is the internal format of images and the usage
+    // of buffers
+    struct Allocation {
+        GpuKind kind;
+        GLuint name;
+        GpuCategory category;
+        std::string owner;
+        GLenum format = 0;
+        int width = 0, height = 0;
+        size_t bytes = 0;
+    };
+
+    inline void add(const GpuKind kind, const GLuint name,
+                    const GpuCategory category) {
+        if (name == 0) {
+            return;
+        }
+        _allocations[key(kind, name)] = {kind, name, category};
+        ++_objects[size_t(kind)];
+    }
+
+    inline void remove(const GpuKind kind, const GLuint name) {
+        const auto it = _allocations.find(key(kind, name));
+        if (it == _allocations.end()) {
+            return;
+        }
+        account(it->second, 0);
+        --_objects[size_t(kind)];
+        _allocations.erase(it);
+    }
+
+    // the storage was (re)allocated, width and height are 0 for buffers
+    inline void resize(const GpuKind kind, const GLuint name,
+                       const size_t bytes, const GLenum format,
+                       const int width = 0, const int height = 0) {
+        const auto it = _allocations.find(key(kind, name));
+        if (it == _allocations.end()) {
+            return;
+        }
+        it->second.format = format;
+        it->second.width = width;
+        it->second.height = height;
+        account(it->second, bytes);
+    }
+
+    inline void set_owner(const GpuKind kind, const GLuint name,
+                          std::string owner) {
+        const auto it = _allocations.find(key(kind, name));
+        if (it != _allocations.end()) {
+            it->second.owner = std::move(owner);
+        }
+    }
+
+    inline void set_category(const GpuKind kind, const GLuint name,
+                             const GpuCategory category) {
+        const auto it = _allocations.find(key(kind, name));
+        if (it == _allocations.end() || it->second.category == category) {
+            return;
+        }
+        const size_t bytes = it->second.bytes;
+        account(it->second, 0);
+        it->second.category = category;
+        account(it->second, bytes);
+    }
+
+    inline size_t bytes() const { return _bytes; }
+    inline size_t peak_bytes() const { return _peak_bytes; }
+    inline size_t bytes(const GpuCategory category) const {
+        return _category_bytes[size_t(category)];
+    }
+    inline size_t peak_bytes(const GpuCategory category) const {
+        return _category_peak[size_t(category)];
+    }
+    inline size_t objects(const GpuKind kind) const {
+        return _objects[size_t(kind)];
+    }
+
+    // live allocations, largest first
+    inline std::vector<const Allocation *> allocations() const {
+        std::vector<const Allocation *> sorted;
+        sorted.reserve(_allocations.size());
+        for (const auto &[k, allocation] : _allocations) {
+            sorted.push_back(&allocation);
+        }
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const Allocation *a, const Allocation *b) {
+                      return a->bytes > b->bytes ||
+                             (a->bytes == b->bytes && a->name < b->name);
+                  });
+        return sorted;
+    }
+
+    // one line per live allocation, then the totals of each category
+    inline void write_csv(std::ostream &os) const {
+        os << "kind,name,category,owner,format,width,height,bytes\n";
+        for (const Allocation *a : allocations()) {
+            os << gpu_kind_name(a->kind) << "," << a->name << ","
+               << gpu_category_name(a->category) << "," << a->owner << ","
+               << gpu_format_name(a->format) << "," << a->width << ","
+               << a->height << "," << a->bytes << "\n";
+        }
+        os << "\ncategory,bytes,peak_bytes\n";
+        for (size_t c = 0; c < size_t(GpuCategory::Count); ++c) {
+            os << gpu_category_name(GpuCategory(c)) << ","
+               << _category_bytes[c] << "," << _category_peak[c] << "\n";
+        }
+        os << "total," << _bytes << "," << _peak_bytes << "\n";
+    }
+
+    // objects that were never destroyed, call before the context goes away
+    inline void report_leaks(std::ostream &os) const {
+        if (_allocations.empty()) {
+            return;
+        }
+        os << _allocations.size() << " gpu objects leaked:\n";
+        for (const Allocation *a : allocations()) {
+            os << "  " << gpu_kind_name(a->kind) << " " << a->name << " "
+               << (a->owner.empty() ? "(no owner)" : a->owner) << ", "
+               << a->bytes << " bytes\n";
+        }
+    }
+
+  private:
+    static inline uint64_t key(const GpuKind kind, const GLuint name) {
+        return (uint64_t(kind) << 32) | name;
+    }
+
+    inline void account(Allocation &allocation, const size_t bytes) {
+        size_t &category = _category_bytes[size_t(allocation.category)];
+        category = category - allocation.bytes + bytes;
+        _bytes = _bytes - allocation.bytes + bytes;
+        allocation.bytes = bytes;
+        size_t &peak = _category_peak[size_t(allocation.category)];
+        peak = std::max(peak, category);
+        _peak_bytes = std::max(_peak_bytes, _bytes);
+    }
+
+    std::unordered_map<uint64_t, Allocation> _allocations;
+    size_t _bytes = 0, _peak_bytes = 0;
+    size_t _category_bytes[size_t(GpuCategory::Count)] = {};
+    size_t _category_peak[size_t(GpuCategory::Count)] = {};
+    size_t _objects[3] = {};
+};
+
+// the tracker of the one context the app renders with
+inline GpuMemory &gpu_memory() {
+    static GpuMemory memory;
+    return memory;
+}
+} // namespace xtr
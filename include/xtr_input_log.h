@@ -0,0 +1,278 @@
+// recording and replay of the input event stream together with the per-frame
+// parameter state, so that performance runs can be repeated frame-exact
+#pragma once
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+namespace xtr {
+class InputLog {
+  public:
+    enum class Mode { Off, Record, Replay };
+
+    // register a value that is written every frame while recording and
+    // restored every frame while replaying, track everything before starting
+    template <class T> inline void track(T &value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        _tracked.push_back({&value, sizeof(T)});
+    }
+
+    // start recording into file_path, the window size is stored in the header
+    inline bool record(const std::filesystem::path &file_path, const int width,
+                       const int height) {
+        _file.open(file_path, std::ios::out | std::ios::binary);
+        if (!_file) {
+            return false;
+        }
+        _file.write(_magic, 4);
+        put(width);
+        put(height);
+        put(Uint32(state_size()));
+        _mode = Mode::Record;
+        return true;
+    }
+
+    // start replaying file_path, the recorded window size is returned
+    inline bool replay(const std::filesystem::path &file_path, int &width,
+                       int &height) {
+        _file.open(file_path, std::ios::in | std::ios::binary);
+        char magic[4] = {};
+        _file.read(magic, 4);
+        Uint32 size = 0;
+        if (!_file || memcmp(magic, _magic, 4) != 0 || !get(width) ||
+            !get(height) || !get(size) || size != state_size()) {
+            std::cout << "Cannot replay " << file_path << "\n";
+            _file.close();
+            return false;
+        }
+        _mode = Mode::Replay;
+        return true;
+    }
+
+    inline Mode mode() const { return _mode; }
+    inline int frame() const { return _frame; }
+
+    // recording, keep an event polled during this frame
+    inline void write_event(const SDL_Event &event) {
+        if (_mode == Mode::Record && is_logged(event.type)) {
+            _events.push_back(event);
+        }
+    }
+
+    // replaying, events of the next frame, false once the log is exhausted
+    inline bool read_frame(std::vector<SDL_Event> &events,
+                           const Uint32 window_id) {
+        events.clear();
+        Uint32 count = 0;
+        if (_mode != Mode::Replay || !get(count)) {
+            return false;
+        }
+        for (Uint32 i = 0; i < count; ++i) {
+            SDL_Event event{};
+            if (!read_event(event)) {
+                return false;
+            }
+            event.common.timestamp = SDL_GetTicks();
+            event.window.windowID = window_id;
+            events.push_back(event);
+        }
+        Uint8 changed = 0;
+        if (!get(changed)) {
+            return false;
+        }
+        if (changed) {
+            _state.resize(state_size());
+            _file.read((char *)_state.data(), std::streamsize(_state.size()));
+        }
+        _state_pending = changed;
+        return bool(_file);
+    }
+
+    // once per frame, after the ui has run and before rendering, record the
+    // tracked values or restore them from the log
+    inline void sync_state() {
+        if (_mode == Mode::Record) {
+            put(Uint32(_events.size()));
+            for (const SDL_Event &event : _events) {
+                write_event_data(event);
+            }
+            _events.clear();
+            // the state is only written when it changed since the last frame
+            std::vector<Uint8> state = snapshot();
+            const Uint8 changed = state != _state;
+            put(changed);
+            if (changed) {
+                _file.write((const char *)state.data(),
+                            std::streamsize(state.size()));
+                _state = std::move(state);
+            }
+        } else if (_mode == Mode::Replay && _state_pending) {
+            size_t offset = 0;
+            for (auto &[data, size] : _tracked) {
+                memcpy(data, _state.data() + offset, size);
+                offset += size;
+            }
+            _state_pending = false;
+        }
+        ++_frame;
+    }
+
+  private:
+    struct Tracked {
+        void *data;
+        size_t size;
+    };
+
+    static constexpr char _magic[4] = {'X', 'T', 'R', 'I'};
+
+    static inline bool is_logged(const Uint32 type) {
+        return type == SDL_QUIT || type == SDL_KEYDOWN || type == SDL_KEYUP ||
+               type == SDL_TEXTINPUT || type == SDL_MOUSEMOTION ||
+               type == SDL_MOUSEBUTTONDOWN || type == SDL_MOUSEBUTTONUP ||
+               type == SDL_MOUSEWHEEL || type == SDL_WINDOWEVENT;
+    }
+
+    inline size_t state_size() const {
+        size_t size = 0;
+        for (const auto &tracked : _tracked) {
+            size += tracked.size;
+        }
+        return size;
+    }
+
+    inline std::vector<Uint8> snapshot() const {
+        std::vector<Uint8> state;
+        state.reserve(state_size());
+        for (const auto &[data, size] : _tracked) {
+            state.insert(state.end(), (const Uint8 *)data,
+                         (const Uint8 *)data + size);
+        }
+        return state;
+    }
+
+    template <class T> inline void put(const T &value) {
+        _file.write((const char *)&value, sizeof(T));
+    }
+
+    template <class T> inline bool get(T &value) {
+        return bool(_file.read((char *)&value, sizeof(T)));
+    }
+
+    // only the fields that the app and imgui read are stored
+    inline void write_event_data(const SDL_Event &event) {
+        put(event.type);
+        if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+            put(event.key.keysym.sym);
+            put(Sint32(event.key.keysym.scancode));
+            put(event.key.keysym.mod);
+            put(event.key.repeat);
+        } else if (event.type == SDL_TEXTINPUT) {
+            _file.write(event.text.text, sizeof(event.text.text));
+        } else if (event.type == SDL_MOUSEMOTION) {
+            put(event.motion.x);
+            put(event.motion.y);
+            put(event.motion.xrel);
+            put(event.motion.yrel);
+            put(event.motion.state);
+        } else if (event.type == SDL_MOUSEBUTTONDOWN ||
+                   event.type == SDL_MOUSEBUTTONUP) {
+            put(event.button.button);
+            put(event.button.clicks);
+            put(event.button.x);
+            put(event.button.y);
+        } else if (event.type == SDL_MOUSEWHEEL) {
+            put(event.wheel.preciseX);
+            put(event.wheel.preciseY);
+            put(event.wheel.x);
+            put(event.wheel.y);
+        } else if (event.type == SDL_WINDOWEVENT) {
+            put(event.window.event);
+            put(event.window.data1);
+            put(event.window.data2);
+        }
+    }
+
+    inline bool read_event(SDL_Event &event) {
+        if (!get(event.type)) {
+            return false;
+        }
+        if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+            Sint32 scancode = 0;
+            get(event.key.keysym.sym);
+            get(scancode);
+            get(event.key.keysym.mod);
+            get(event.key.repeat);
+            event.key.keysym.scancode = SDL_Scancode(scancode);
+            event.key.state = event.type == SDL_KEYDOWN;
+        } else if (event.type == SDL_TEXTINPUT) {
+            _file.read(event.text.text, sizeof(event.text.text));
+        } else if (event.type == SDL_MOUSEMOTION) {
+            get(event.motion.x);
+            get(event.motion.y);
+            get(event.motion.xrel);
+            get(event.motion.yrel);
+            get(event.motion.state);
+        } else if (event.type == SDL_MOUSEBUTTONDOWN ||
+                   event.type == SDL_MOUSEBUTTONUP) {
+            get(event.button.button);
+            get(event.button.clicks);
+            get(event.button.x);
+            get(event.button.y);
+            event.button.state = event.type == SDL_MOUSEBUTTONDOWN;
+        } else if (event.type == SDL_MOUSEWHEEL) {
+            get(event.wheel.preciseX);
+            get(event.wheel.preciseY);
+            get(event.wheel.x);
+            get(event.wheel.y);
+        } else if (event.type == SDL_WINDOWEVENT) {
+            get(event.window.event);
+            get(event.window.data1);
+            get(event.window.data2);
+        }
+        return bool(_file);
+    }
+
+    Mode _mode = Mode::Off;
+    std::fstream _file;
+    std::vector<Tracked> _tracked;
+    std::vector<SDL_Event> _events;
+    std::vector<Uint8> _state;
+    bool _state_pending = false;
+    int _frame = 0;
+};
+
+// frame time statistics, reported at the end of a replay
+class FrameStats {
+  public:
+    inline void add(const double frame_ms) { _frame_ms.push_back(frame_ms); }
+
+    inline void report(std::ostream &os) const {
+        if (_frame_ms.empty()) {
+            return;
+        }
+        std::vector<double> sorted = _frame_ms;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.;
+        for (const double ms : sorted) {
+            total += ms;
+        }
+        auto percentile = [&](const double p) {
+            return sorted[std::min(sorted.size() - 1,
+                                   size_t(p * double(sorted.size())))];
+        };
+        os << "frames " << sorted.size() << ", total " << total << " ms\n"
+           << "frame ms: mean " << total / double(sorted.size())
+           << ", median " << percentile(0.5) << ", p95 " << percentile(0.95)
+           << ", p99 " << percentile(0.99) << ", max " << sorted.back()
+           << "\n";
+    }
+
+  private:
+    std::vector<double> _frame_ms;
+};
+} // namespace xtr
@@ -0,0 +1,185 @@
+// coloured point lights for the xtoon pass, culled per screen tile
+// the lights live in a uniform buffer. a pre-pass draws one fragment per
+// tile of the g-buffer, finds the bounding box of the positions under it,
+// which bounds the depth range of the tile, and writes a bit mask of the
+// lights whose spheres reach that box. the xtoon pass then only walks the
+// set bits of its tile, so the cost of a pixel follows the lights near it
+// rather than all of them. gl 3.3 has no compute shaders or image stores,
+// so the masks are integer render targets, 128 lights each
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <random>
+#include <string>
+#include <vector>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <xtr_buffer.h>
+#include <xtr_framebuffer.h>
+#include <xtr_screen_pass.h>
+#include <xtr_shader.h>
+#include <xtr_target_pool.h>
+#include <xtr_texture.h>
+
+namespace xtr {
+// two vec4 in the std140 uniform block of the shaders
+struct PointLight {
+    glm::vec3 position;
+    // the light fades out at this distance
+    float radius;
+    glm::vec3 colour;
+    float intensity;
+};
+
+// count lights of random hues scattered on a shell around the mesh, which
+// is centered on the origin with a unit diagonal
+inline std::vector<PointLight> stage_lights(const size_t count,
+                                            const uint32_t seed,
+                                            const float radius,
+                                            const float intensity) {
+    std::mt19937 rng{seed};
+    std::uniform_real_distribution<float> unit{0.f, 1.f};
+    std::vector<PointLight> lights(count);
+    for (PointLight &light : lights) {
+        // uniform direction, distance between 0.3 and 0.7
+        const float z = unit(rng) * 2.f - 1.f;
+        const float phi = unit(rng) * 2.f * std::numbers::pi_v<float>;
+        const float r = std::sqrt(std::max(0.f, 1.f - z * z));
+        const float distance = 0.3f + 0.4f * unit(rng);
+        light.position =
+            glm::vec3{r * std::cos(phi), z, r * std::sin(phi)} * distance;
+        light.radius = radius;
+        // saturated hue
+        const float h = unit(rng) * 6.f;
+        light.colour = glm::clamp(
+            glm::vec3{std::abs(h - 3.f) - 1.f, 2.f - std::abs(h - 2.f),
+                      2.f - std::abs(h - 4.f)},
+            0.f, 1.f);
+        light.intensity = intensity;
+    }
+    return lights;
+}
+
+class TiledLights {
+  public:
+    static constexpr int tile_size = 16;
+    static constexpr int mask_count = 4;
+    // 128 lights per mask, which also fills the 16 KiB of uniform block
+    // every gl 3.3 implementation provides
+    static constexpr size_t max_lights = mask_count * 128;
+
+    TiledLights()
+        : _cull_pass{"./data/shaders/light_cull.frag"},
+          _light_buffer{GL_UNIFORM_BUFFER},
+          _masks{Texture{GL_TEXTURE_2D}, Texture{GL_TEXTURE_2D},
+                 Texture{GL_TEXTURE_2D}, Texture{GL_TEXTURE_2D}} {
+        _light_buffer.label("point lights");
+        _light_buffer.data(GLsizeiptr(max_lights * sizeof(PointLight)),
+                           nullptr, GL_DYNAMIC_DRAW);
+        GLenum attachments[mask_count];
+        for (int i = 0; i < mask_count; ++i) {
+            attachments[i] = GL_COLOR_ATTACHMENT0 + i;
+        }
+        resize(1, 1);
+        _framebuffer.draw_buffers(mask_count, attachments);
+        bind_block(_cull_pass.get_program());
+    }
+
+    // replace the lights, those past max_lights are dropped
+    inline void upload(const std::vector<PointLight> &lights) {
+        _count = std::min(lights.size(), max_lights);
+        // orphan the storage, frames still in flight keep the old lights
+        _light_buffer.data(GLsizeiptr(max_lights * sizeof(PointLight)),
+                           nullptr, GL_DYNAMIC_DRAW);
+        if (_count > 0) {
+            _light_buffer.sub_data(0, GLsizeiptr(_count * sizeof(PointLight)),
+                                   lights.data());
+        }
+    }
+
+    // find the lights of every tile of a width x height g-buffer, whose
+    // positions are bound to position_unit and ids to id_unit. only pixels
+    // of id count. leaves the mask framebuffer bound
+    inline void cull(const int width, const int height,
+                     const int position_unit, const int id_unit,
+                     const int id) {
+        resize((width + tile_size - 1) / tile_size,
+               (height + tile_size - 1) / tile_size);
+        _framebuffer.bind();
+        glViewport(0, 0, _tiles.x, _tiles.y);
+        if (_count == 0) {
+            return;
+        }
+        const Program &program = _cull_pass.get_program();
+        program.use();
+        program.uni_2i(program.loc("uni_screen_size"), width, height);
+        program.uni_1i(program.loc("uni_tile_size"), tile_size);
+        program.uni_1i(program.loc("uni_position"), position_unit);
+        program.uni_1i(program.loc("uni_id_map"), id_unit);
+        program.uni_1i(program.loc("uni_id"), id);
+        program.uni_1i(program.loc("uni_light_count"), GLint(_count));
+        glBindBufferBase(GL_UNIFORM_BUFFER, block_binding, _light_buffer);
+        glDisable(GL_DEPTH_TEST);
+        _cull_pass.draw();
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // bind the lights and the tile masks for program, which declares the
+    // Lights block and the uni_light_mask samplers, to units starting at
+    // first_unit
+    inline void bind(const Program &program, const int first_unit) {
+        bind_block(program);
+        glBindBufferBase(GL_UNIFORM_BUFFER, block_binding, _light_buffer);
+        for (int i = 0; i < mask_count; ++i) {
+            _masks[i].bind_unit(first_unit + i);
+            program.uni_1i(
+                program.loc("uni_light_mask" + std::to_string(i)),
+                first_unit + i);
+        }
+        program.uni_1i(program.loc("uni_light_count"), GLint(_count));
+        program.uni_1i(program.loc("uni_tile_size"), tile_size);
+    }
+
+    inline size_t count() const { return _count; }
+    inline const glm::ivec2 &tiles() const { return _tiles; }
+
+  private:
+    static constexpr GLuint block_binding = 0;
+
+    static inline void bind_block(const Program &program) {
+        const GLuint block = glGetUniformBlockIndex(program, "Lights");
+        if (block != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program, block, block_binding);
+        }
+    }
+
+    // fit the masks to a number of tiles. they are sized by the size class
+    // of the screen like the other render targets, and replaced when it
+    // changes, since their storage is immutable
+    inline void resize(const int x, const int y) {
+        _tiles = {x, y};
+        const glm::ivec2 screen =
+            TargetPool::size_class(x * tile_size, y * tile_size);
+        const glm::ivec2 extent{screen.x / tile_size, screen.y / tile_size};
+        if (extent == _extent) {
+            return;
+        }
+        _extent = extent;
+        for (int i = 0; i < mask_count; ++i) {
+            _masks[i] = Texture{GL_TEXTURE_2D};
+            _masks[i].label("light tile masks");
+            _masks[i].storage_2d(GL_RGBA32UI, extent.x, extent.y);
+            _framebuffer.attach_texture(GL_COLOR_ATTACHMENT0 + i, _masks[i]);
+        }
+    }
+
+    ScreenPass _cull_pass;
+    Buffer _light_buffer;
+    Texture _masks[mask_count];
+    Framebuffer _framebuffer;
+    glm::ivec2 _tiles{0, 0}, _extent{0, 0};
+    size_t _count = 0;
+};
+} // namespace xtr
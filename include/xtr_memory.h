@@ -0,0 +1,126 @@
+// cpu memory helpers for the loaders
+// - a scratch arena for per-load temporaries, kept between loads
+// - a tally of live bytes with its peak, for load metrics
+// - the peak resident set size of the process
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace xtr {
+// bump allocator for trivially copyable temporaries. everything is freed at
+// once by reset, which keeps a single block as large as the last use so that
+// the next load of a similar size does not allocate at all
+class ScratchArena {
+  public:
+    ScratchArena() = default;
+    ScratchArena(const ScratchArena &) = delete;
+    ScratchArena &operator=(const ScratchArena &) = delete;
+
+    // uninitialized storage for count values of T
+    template <class T> inline T *alloc(const size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const size_t bytes = count * sizeof(T);
+        _used = (_used + alignof(std::max_align_t) - 1) &
+                ~(alignof(std::max_align_t) - 1);
+        std::byte *p = nullptr;
+        if (_used + bytes <= _capacity) {
+            p = _block.get() + _used;
+        } else {
+            // spill into a separate block, the next reset grows the main one
+            _spill.push_back(std::make_unique<std::byte[]>(bytes));
+            p = _spill.back().get();
+        }
+        _used += bytes;
+        _high_water = std::max(_high_water, _used);
+        return reinterpret_cast<T *>(p);
+    }
+
+    // storage for count copies of value
+    template <class T> inline T *alloc(const size_t count, const T &value) {
+        T *p = alloc<T>(count);
+        std::fill(p, p + count, value);
+        return p;
+    }
+
+    // free everything allocated since the last reset
+    inline void reset() {
+        if (!_spill.empty() || _high_water < _capacity / 4) {
+            _spill.clear();
+            _block = _high_water ? std::make_unique<std::byte[]>(_high_water)
+                                 : nullptr;
+            _capacity = _high_water;
+        }
+        _used = 0;
+        _high_water = 0;
+    }
+
+    inline size_t used() const { return _used; }
+    inline size_t capacity() const { return _capacity; }
+
+  private:
+    std::unique_ptr<std::byte[]> _block;
+    std::vector<std::unique_ptr<std::byte[]>> _spill;
+    size_t _capacity = 0, _used = 0, _high_water = 0;
+};
+
+// the scratch arena of the calling thread
+inline ScratchArena &scratch_arena() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+// bytes held at the moment and the most held at any time
+class MemoryTally {
+  public:
+    inline void add(const size_t bytes) {
+        _current += bytes;
+        _peak = std::max(_peak, _current);
+    }
+    inline void sub(const size_t bytes) {
+        _current -= std::min(_current, bytes);
+    }
+
+    inline size_t current() const { return _current; }
+    inline size_t peak() const { return _peak; }
+
+  private:
+    size_t _current = 0, _peak = 0;
+};
+
+// the most memory the process has had resident, 0 when unknown
+inline size_t peak_rss_bytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                                sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss);
+#else
+    return size_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+} // namespace xtr
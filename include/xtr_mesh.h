@@ -1,5 +1,6 @@
-// a mesh used for the mesh pass, vertex include position, normal, and
-// abstracted_normal
+// a mesh used for the mesh pass, vertex include position and normal. the
+// abstracted normal of the smooth shape is a separate stream, the other
+// shapes are evaluated in mesh.vert from the position and the bounding box
 #pragma once
 #include <glad/gl.h>
 #include <glm/glm.hpp>
@@ -11,28 +12,37 @@ namespace xtr {
 struct Vertex {
     glm::vec3 position;
     glm::vec3 normal;
-    glm::vec3 abstracted_normal;
 };
 
-// a mesh include a set of vertices and a set of indices
+// a mesh include a set of vertices and a set of indices, abstracted_normals
+// is empty unless the smooth shape was generated
 struct Mesh {
     std::vector<Vertex> vertices;
+    std::vector<glm::vec3> abstracted_normals;
     std::vector<int> indices;
+    // bounding box dimensions relative to its diagonal, for the analytic
+    // shapes
+    glm::vec3 bb_dimension{1.f};
 };
 
 // bind the current mesh to a VAO
 inline void bind_mesh(const Mesh &mesh, const Buffer &vertex_buffer,
+                      const Buffer &abstracted_buffer,
                       const Buffer &index_buffer) {
     vertex_buffer.bind();
     vertex_buffer.data(GLsizeiptr(mesh.vertices.size() * sizeof(Vertex)),
                        mesh.vertices.data(), GL_STATIC_DRAW);
+    abstracted_buffer.bind();
+    abstracted_buffer.data(
+        GLsizeiptr(mesh.abstracted_normals.size() * sizeof(glm::vec3)),
+        mesh.abstracted_normals.data(), GL_STATIC_DRAW);
     index_buffer.bind();
     index_buffer.data(GLsizeiptr(mesh.indices.size() * sizeof(int)),
                       mesh.indices.data(), GL_STATIC_DRAW);
 }
 
-// set vertex attribute for the current mesh
-inline void attrib_mesh(int i_pos, int i_norm, int i_anorm) {
+// set vertex attribute for the current mesh, from the vertex buffer bound now
+inline void attrib_mesh(int i_pos, int i_norm) {
     if (i_pos >= 0) {
         glVertexAttribPointer(i_pos, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
                               (void *)offsetof(Vertex, position));
@@ -43,10 +53,35 @@ inline void attrib_mesh(int i_pos, int i_norm, int i_anorm) {
                               (void *)offsetof(Vertex, normal));
         glEnableVertexAttribArray(i_norm);
     }
-    if (i_anorm >= 0) {
-        glVertexAttribPointer(i_anorm, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                              (void *)offsetof(Vertex, abstracted_normal));
+}
+
+// set the abstracted normal attribute from the buffer bound now, or disable
+// it when the mesh has no smooth abstracted normals
+inline void attrib_abstracted(int i_anorm, bool enabled) {
+    if (i_anorm < 0) {
+        return;
+    }
+    if (enabled) {
+        glVertexAttribPointer(i_anorm, 3, GL_FLOAT, GL_FALSE,
+                              sizeof(glm::vec3), nullptr);
         glEnableVertexAttribArray(i_anorm);
+    } else {
+        glDisableVertexAttribArray(i_anorm);
+        glVertexAttrib3f(i_anorm, 0.f, 0.f, 0.f);
+    }
+}
+
+// dominant axis of the bounding box for the cylinder shape, -1 on a tie
+inline int dominant_axis(const glm::vec3 &bb_dimension) {
+    if (bb_dimension.x > bb_dimension.y && bb_dimension.x > bb_dimension.z) {
+        return 0;
+    } else if (bb_dimension.y > bb_dimension.z &&
+               bb_dimension.y > bb_dimension.x) {
+        return 1;
+    } else if (bb_dimension.z > bb_dimension.x &&
+               bb_dimension.z > bb_dimension.y) {
+        return 2;
     }
+    return -1;
 }
 } // namespace xtr
@@ -3,104 +3,323 @@
 // - position buffer
 // - normal buffer
 // - object id buffer
+// point clouds are drawn into the same buffers as round splats
+// uploaded meshes stay resident under a budget after another one is drawn,
+// so that selecting one of them again only switches buffers
+// triangles may be drawn twice, first depth only from the positions, then
+// into the buffers where the depth is equal, so each pixel writes all three
+// buffers once however many surfaces overlap it. the ratio of fragments in
+// the depth pass to those in the second pass is the overdraw, measured with
+// occlusion queries, and in auto mode the pre-pass runs while it is high
 
 #pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 #include <xtr_buffer.h>
+#include <xtr_edges.h>
 #include <xtr_framebuffer.h>
 #include <xtr_mesh.h>
+#include <xtr_obj.h>
 #include <xtr_shader.h>
+#include <xtr_target_pool.h>
 #include <xtr_texture.h>
+#include <xtr_upload.h>
 namespace xtr {
 class MeshPass {
   public:
-    MeshPass(const int width, const int height)
+    MeshPass(TargetPool &pool, const int width, const int height)
         : _program{load_program("./data/shaders/mesh.vert",
                                 "./data/shaders/mesh.frag")},
-          _array{}, _vertex_buffer{GL_ARRAY_BUFFER},
-          _element_buffer{GL_ELEMENT_ARRAY_BUFFER},
-          _position_texture{GL_TEXTURE_2D}, _normal_texture{GL_TEXTURE_2D},
-          _id_texture{GL_TEXTURE_2D} {
-        _array.bind();
-        _vertex_buffer.bind();
-        _element_buffer.bind();
-        attrib_mesh(0, 1, 2);
-        _array.unbind();
-        resize(width, height);
-        _framebuffer.bind();
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                               GL_TEXTURE_2D, _position_texture, 0);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
-                               GL_TEXTURE_2D, _normal_texture, 0);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2,
-                               GL_TEXTURE_2D, _id_texture, 0);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                                  GL_RENDERBUFFER, _depth_buffer);
-        unsigned int attachments[] = {
+          _splat_program{load_program("./data/shaders/mesh.vert",
+                                      "./data/shaders/splat.frag")},
+          _depth_program{load_program("./data/shaders/depth.vert",
+                                      "./data/shaders/depth.frag")},
+          _pool{pool}, _extent{TargetPool::size_class(width, height)},
+          _position_texture{
+              pool.texture(GL_RGB16F, _extent, "mesh pass position")},
+          _normal_texture{pool.texture(GL_RGB16F, _extent, "mesh pass normal")},
+          _id_texture{pool.texture(GL_R16F, _extent, "mesh pass id")},
+          _depth_buffer{pool.renderbuffer(GL_DEPTH24_STENCIL8, _extent,
+                                          "mesh pass depth stencil")} {
+        // an empty mesh to draw until the first one is uploaded
+        _front = &create();
+        attach();
+        const GLenum attachments[] = {
             GL_COLOR_ATTACHMENT0,
             GL_COLOR_ATTACHMENT1,
             GL_COLOR_ATTACHMENT2,
         };
-        glDrawBuffers(3, attachments);
-        _framebuffer.unbind();
+        _framebuffer.draw_buffers(3, attachments);
+        for (Measurement &measurement : _measurements) {
+            glGenQueries(2, measurement.queries);
+        }
+    }
+    MeshPass(const MeshPass &) = delete;
+    MeshPass &operator=(const MeshPass &) = delete;
+    ~MeshPass() {
+        for (Measurement &measurement : _measurements) {
+            glDeleteQueries(2, measurement.queries);
+        }
     }
 
-    // resize all of the buffers
+    // fit the buffers to a width x height screen. they are only replaced
+    // when the size class changes, see TargetPool
     inline void resize(const int width, const int height) {
-        _position_texture.bind();
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB,
-                     GL_FLOAT, nullptr);
-        _position_texture.unbind();
+        const glm::ivec2 extent = TargetPool::size_class(width, height);
+        if (extent == _extent) {
+            return;
+        }
+        _pool.reallocate(_position_texture, GL_RGB16F, _extent, extent,
+                         "mesh pass position");
+        _pool.reallocate(_normal_texture, GL_RGB16F, _extent, extent,
+                         "mesh pass normal");
+        _pool.reallocate(_id_texture, GL_R16F, _extent, extent,
+                         "mesh pass id");
+        _pool.reallocate(_depth_buffer, GL_DEPTH24_STENCIL8, _extent, extent,
+                         "mesh pass depth stencil");
+        _extent = extent;
+        attach();
+    }
 
-        _normal_texture.bind();
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB,
-                     GL_FLOAT, nullptr);
-        _normal_texture.unbind();
+    // the allocated size of the buffers, a smaller screen is drawn into
+    // their lower left corner
+    inline const glm::ivec2 &extent() const { return _extent; }
 
-        _id_texture.bind();
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED,
-                     GL_FLOAT, nullptr);
-        _id_texture.unbind();
+    // whether triangles get a depth pre-pass, auto runs it while the
+    // measured overdraw is above pre_pass_threshold
+    enum class PrePass { Off, On, Auto };
+    PrePass pre_pass = PrePass::Auto;
+    float pre_pass_threshold = 1.5f;
 
-        _depth_buffer.bind();
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width,
-                              height);
-        _depth_buffer.unbind();
+    // meshes other than the drawn one stay resident up to this many bytes
+    // of buffer storage, the least recently drawn are released first
+    size_t cache_budget = size_t(512) << 20;
+
+    // draw the resident mesh uploaded under key, false when there is none
+    inline bool use_cached(const std::string &key) {
+        for (const auto &mesh : _meshes) {
+            if (!key.empty() && mesh->key == key && mesh.get() != _back) {
+                cancel_stream();
+                show(*mesh);
+                ++_cache_hits;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // upload a mesh for drawing, kept under key when it is not empty
+    inline void upload_mesh(const xtr::Mesh &mesh,
+                            const std::string &key = {}) {
+        cancel_stream();
+        MeshBuffers &target = mutable_buffers(acquire());
+        target.draw_count = GLsizei(mesh.indices.size());
+        target.vertex_count = mesh.vertices.size();
+        target.bb_dimension = mesh.bb_dimension;
+        target.array.bind();
+        bind_mesh(mesh, target.vertex_buffer, target.abstracted_buffer,
+                  target.element_buffer);
+        target.vertex_capacity = mesh.vertices.size() * sizeof(Vertex);
+        target.abstracted_capacity =
+            mesh.abstracted_normals.size() * sizeof(glm::vec3);
+        target.element_capacity = mesh.indices.size() * sizeof(int);
+        attrib_abstracted(2, !mesh.abstracted_normals.empty());
+        target.array.unbind();
+        forget_edges(target);
+        target.key = key;
+        show(target);
     }
 
-    // upload a mesh for drawing
-    inline void upload_mesh(const xtr::Mesh &mesh) {
-        _draw_count = mesh.indices.size();
-        _array.bind();
-        bind_mesh(mesh, _vertex_buffer, _element_buffer);
-        _array.unbind();
+    // upload a mesh that load(output) writes straight into the buffers,
+    // usually through load_mesh_into, kept under key when it is not empty
+    template <class F>
+    inline void upload_mesh_with(F &&load, const std::string &key = {}) {
+        cancel_stream();
+        MeshBuffers &target = mutable_buffers(acquire());
+        target.array.bind();
+        BufferOutput output{target.vertex_buffer, target.abstracted_buffer,
+                            target.element_buffer};
+        load(output);
+        target.draw_count = GLsizei(output.index_count());
+        target.vertex_count = output.vertex_count();
+        target.bb_dimension = output.bb_dimension();
+        // the output sizes the storage to fit
+        target.vertex_capacity = output.vertex_count() * sizeof(Vertex);
+        target.abstracted_capacity =
+            output.has_abstracted_normals()
+                ? output.vertex_count() * sizeof(glm::vec3)
+                : 0;
+        target.element_capacity = output.index_count() * sizeof(int);
+        target.abstracted_buffer.bind();
+        attrib_abstracted(2, output.has_abstracted_normals());
+        target.array.unbind();
+        forget_edges(target);
+        target.key = key;
+        show(target);
     }
 
-    // clear color and depth buffer
+    // upload a mesh over the next frames through ring, kept under key when
+    // it is not empty. the current mesh is drawn until all of the new one
+    // is copied. the storage is immutable where the context has buffer
+    // storage, and reused buffers are only replaced when a larger mesh
+    // arrives
+    inline void stream_mesh(UploadRing &ring, xtr::Mesh &&mesh,
+                            const std::string &key = {}) {
+        cancel_stream();
+        _ring = &ring;
+        const auto owned = std::make_shared<const xtr::Mesh>(std::move(mesh));
+        MeshBuffers &back = acquire();
+        _back = &back;
+        back.key.clear();
+        back.draw_count = GLsizei(owned->indices.size());
+        back.vertex_count = owned->vertices.size();
+        back.bb_dimension = owned->bb_dimension;
+        // the sizes to allocate, with headroom for the meshes that follow
+        auto grown = [](const size_t capacity, const auto &data) {
+            const size_t bytes = data.size() * sizeof(data[0]);
+            return bytes > capacity
+                       ? std::max(bytes, capacity + capacity / 2)
+                       : capacity;
+        };
+        const size_t capacities[] = {
+            grown(back.vertex_capacity, owned->vertices),
+            grown(back.abstracted_capacity, owned->abstracted_normals),
+            grown(back.element_capacity, owned->indices)};
+        // immutable storage cannot grow, the buffers are replaced instead
+        if (back.immutable && (capacities[0] != back.vertex_capacity ||
+                               capacities[1] != back.abstracted_capacity ||
+                               capacities[2] != back.element_capacity)) {
+            renew(back);
+        }
+        back.array.bind();
+        auto stream = [&](const Buffer &buffer, size_t &capacity,
+                          const size_t wanted, const auto &data) {
+            if (wanted != capacity) {
+                capacity = wanted;
+                buffer.bind();
+                back.immutable |= buffer.storage(GLsizeiptr(capacity), nullptr,
+                                                 0, GL_STATIC_DRAW);
+            }
+            const size_t bytes = data.size() * sizeof(data[0]);
+            if (bytes > 0) {
+                _stream_ticket =
+                    ring.enqueue(buffer, 0, data.data(), bytes, owned);
+            }
+        };
+        stream(back.vertex_buffer, back.vertex_capacity, capacities[0],
+               owned->vertices);
+        stream(back.abstracted_buffer, back.abstracted_capacity,
+               capacities[1], owned->abstracted_normals);
+        stream(back.element_buffer, back.element_capacity, capacities[2],
+               owned->indices);
+        back.abstracted_buffer.bind();
+        attrib_abstracted(2, !owned->abstracted_normals.empty());
+        back.array.unbind();
+        forget_edges(back);
+        _stream_key = key;
+        _streaming = true;
+    }
+
+    // once per frame after the ring was pumped, switch to a streamed mesh
+    // once it is complete, true when it did
+    inline bool update_stream() {
+        if (!_streaming || !_ring->finished(_stream_ticket)) {
+            return false;
+        }
+        MeshBuffers &back = *_back;
+        back.key = std::move(_stream_key);
+        _back = nullptr;
+        _streaming = false;
+        show(back);
+        return true;
+    }
+
+    inline bool streaming() const { return _streaming; }
+
+    // clear color, depth and stencil, the framebuffer stays bound for draw
     inline void clear_buffer() const {
         _framebuffer.bind();
         glClearColor(0, 0, 0, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        _framebuffer.unbind();
+        glClearStencil(0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+                GL_STENCIL_BUFFER_BIT);
     }
 
-    // render into buffer, with model-view-projection, normal_factor, and id
+    // render into buffer, with model-view-projection, normal_factor,
+    // abstracted_shape, and id. all shapes but smooth are evaluated in
+    // mesh.vert. the framebuffer stays bound
     inline void draw(const glm::mat4 &model_matrix,
                      const glm::mat4 &view_matrix,
                      const glm::mat4 &projection_matrix,
-                     const float normal_factor, const int id) const {
-        _framebuffer.bind();
-        _program.use();
-        _program.uni_mat4(_program.loc("uni_model"), model_matrix);
-        _program.uni_mat4(_program.loc("uni_view"), view_matrix);
-        _program.uni_mat4(_program.loc("uni_projection"), projection_matrix);
-        _program.uni_1f(_program.loc("uni_normal_factor"), normal_factor);
-        _program.uni_1i(_program.loc("uni_id"), id);
-        _array.bind();
-        glDrawElements(GL_TRIANGLES, _draw_count, GL_UNSIGNED_INT, 0);
-        _array.unbind();
-        _framebuffer.unbind();
+                     const float normal_factor, const int abstracted_shape,
+                     const int id) {
+        MeshBuffers &mesh = *_front;
+        // the pre-pass reads the positions only
+        auto draw_depth = [&]() {
+            mesh.depth_array.bind();
+            glDrawElements(GL_TRIANGLES, mesh.draw_count, GL_UNSIGNED_INT, 0);
+            mesh.depth_array.unbind();
+        };
+        auto draw_geometry = [&]() {
+            mesh.array.bind();
+            glDrawElements(GL_TRIANGLES, mesh.draw_count, GL_UNSIGNED_INT, 0);
+            mesh.array.unbind();
+        };
+        draw_passes(model_matrix, view_matrix, projection_matrix,
+                    normal_factor, abstracted_shape, mesh.bb_dimension, id,
+                    &mesh, draw_depth, draw_geometry);
     }
 
+    // same as above, with geometry that draw_geometry binds and draws itself
+    // using the attribute locations of the mesh pass, and the bounding box of
+    // that geometry. the pre-pass draws it the same way
+    template <class F>
+    inline void draw(const glm::mat4 &model_matrix,
+                     const glm::mat4 &view_matrix,
+                     const glm::mat4 &projection_matrix,
+                     const float normal_factor, const int abstracted_shape,
+                     const glm::vec3 &bb_dimension, const int id,
+                     F &&draw_geometry) {
+        draw_passes(model_matrix, view_matrix, projection_matrix,
+                    normal_factor, abstracted_shape, bb_dimension, id,
+                    nullptr, draw_geometry, draw_geometry);
+    }
+
+    // same as above, with points that draw_geometry draws as GL_POINTS. each
+    // point becomes a round splat diameter wide in world units, with its
+    // normal turned towards the camera, at a viewport height pixels high
+    template <class F>
+    inline void draw_splats(const glm::mat4 &model_matrix,
+                            const glm::mat4 &view_matrix,
+                            const glm::mat4 &projection_matrix,
+                            const float normal_factor,
+                            const int abstracted_shape,
+                            const glm::vec3 &bb_dimension, const int id,
+                            const float diameter, const int height,
+                            F &&draw_geometry) {
+        // the splats cut their corners off, depth alone would not
+        _pre_pass_used = false;
+        use_program(_splat_program, model_matrix, view_matrix,
+                    projection_matrix, normal_factor, abstracted_shape,
+                    bb_dimension, id);
+        _splat_program.uni_1f(_splat_program.loc("uni_splat_size"), diameter);
+        _splat_program.uni_1f(_splat_program.loc("uni_viewport_height"),
+                              float(height));
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        write_coverage(true);
+        draw_geometry();
+        write_coverage(false);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+
+    // the depth and stencil of the buffers. the stencil is 1 where the mesh
+    // covers a pixel, so that screen passes can share it and skip the rest
+    inline GLuint depth_stencil() const { return _depth_buffer; }
+
     inline void bind_framebuffer() const { _framebuffer.bind(); }
     inline void unbind_framebuffer() const { _framebuffer.unbind(); }
 
@@ -108,28 +327,398 @@ class MeshPass {
     inline void bind_buffers(const int uni_position, const int uni_normal,
                              const int uni_id) {
         if (uni_position >= 0) {
-            glActiveTexture(GL_TEXTURE0 + uni_position);
-            _position_texture.bind();
+            _position_texture.bind_unit(uni_position);
         }
         if (uni_normal >= 0) {
-            glActiveTexture(GL_TEXTURE0 + uni_normal);
-            _normal_texture.bind();
+            _normal_texture.bind_unit(uni_normal);
         }
         if (uni_id >= 0) {
-            glActiveTexture(GL_TEXTURE0 + uni_id);
-            _id_texture.bind();
+            _id_texture.bind_unit(uni_id);
         }
     };
 
     inline const xtr::Program &get_program() const { return _program; }
 
+    // the last measured overdraw of whatever was drawn, 0 before the first
+    // measurement, and whether the last draw had a pre-pass
+    inline float overdraw() const { return _overdraw; }
+    inline bool pre_pass_used() const { return _pre_pass_used; }
+    // the last measured overdraw of each resident mesh that has one
+    inline std::vector<std::pair<std::string, float>> overdraw_report() const {
+        std::vector<std::pair<std::string, float>> report;
+        for (const auto &mesh : _meshes) {
+            if (!mesh->key.empty() && mesh->overdraw > 0.f) {
+                report.emplace_back(mesh->key, mesh->overdraw);
+            }
+        }
+        return report;
+    }
+
+    // edges of the mesh drawn. only the object space outline uses them, so
+    // they are found the first time they are asked for, from the buffers
+    inline MeshEdges &edges() {
+        MeshBuffers &mesh = *_front;
+        if (!mesh.edges_built) {
+            mesh.edges_built = true;
+            build_edges(mesh);
+        }
+        return mesh.edges;
+    }
+
+    // resident meshes, with the one drawn, and the bytes they hold
+    inline size_t cached_count() const {
+        return size_t(std::count_if(
+            _meshes.begin(), _meshes.end(),
+            [](const auto &mesh) { return !mesh->key.empty(); }));
+    }
+    inline size_t cached_bytes() const {
+        size_t bytes = 0;
+        for (const auto &mesh : _meshes) {
+            bytes += mesh->bytes();
+        }
+        return bytes;
+    }
+    inline size_t cache_hits() const { return _cache_hits; }
+    inline size_t cache_evictions() const { return _cache_evictions; }
+
   private:
-    xtr::Program _program;
-    xtr::Array _array;
-    xtr::Buffer _vertex_buffer, _element_buffer;
+    inline void attach() const {
+        _framebuffer.attach_texture(GL_COLOR_ATTACHMENT0, _position_texture);
+        _framebuffer.attach_texture(GL_COLOR_ATTACHMENT1, _normal_texture);
+        _framebuffer.attach_texture(GL_COLOR_ATTACHMENT2, _id_texture);
+        _framebuffer.attach_renderbuffer(GL_DEPTH_STENCIL_ATTACHMENT,
+                                         _depth_buffer);
+    }
+
+    // buffers of one mesh, with the bytes their storage holds
+    struct MeshBuffers {
+        xtr::Array array;
+        // the positions alone, for the depth pre-pass
+        xtr::Array depth_array;
+        xtr::Buffer vertex_buffer{GL_ARRAY_BUFFER};
+        xtr::Buffer abstracted_buffer{GL_ARRAY_BUFFER};
+        xtr::Buffer element_buffer{GL_ELEMENT_ARRAY_BUFFER};
+        size_t vertex_capacity = 0, abstracted_capacity = 0,
+               element_capacity = 0;
+        // some storage is immutable, so it cannot be allocated again
+        bool immutable = false;
+        GLsizei draw_count = 0;
+        size_t vertex_count = 0;
+        glm::vec3 bb_dimension{1.f};
+        MeshEdges edges;
+        bool edges_built = false;
+        // what use_cached finds it by, empty when it is not to be reused
+        std::string key;
+        // when it was last drawn, for the eviction order
+        uint64_t used = 0;
+        // fragments per covered pixel when last measured, 0 if never
+        float overdraw = 0.f;
+
+        inline size_t bytes() const {
+            return vertex_capacity + abstracted_capacity + element_capacity;
+        }
+    };
+
+    inline MeshBuffers &create() {
+        MeshBuffers &mesh =
+            *_meshes.emplace_back(std::make_unique<MeshBuffers>());
+        attach_buffers(mesh);
+        return mesh;
+    }
+
+    // drop the edges of the previous contents of mesh
+    static inline void forget_edges(MeshBuffers &mesh) {
+        mesh.edges.clear();
+        mesh.edges_built = false;
+    }
+
+    // read the mesh back from its buffers and find its edges. through the
+    // copy binding, so the element buffer of the vertex arrays stays
+    static inline void build_edges(MeshBuffers &mesh) {
+        XTR_TRACE_SCOPE("edge readback");
+        xtr::Mesh copy;
+        copy.vertices.resize(mesh.vertex_count);
+        copy.indices.resize(size_t(mesh.draw_count));
+        if (copy.vertices.empty() || copy.indices.empty()) {
+            return;
+        }
+        gl_state().bind_buffer(GL_COPY_READ_BUFFER, mesh.vertex_buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0,
+                           GLsizeiptr(copy.vertices.size() * sizeof(Vertex)),
+                           copy.vertices.data());
+        gl_state().bind_buffer(GL_COPY_READ_BUFFER, mesh.element_buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0,
+                           GLsizeiptr(copy.indices.size() * sizeof(int)),
+                           copy.indices.data());
+        gl_state().bind_buffer(GL_COPY_READ_BUFFER, 0);
+        mesh.edges.build(copy);
+    }
+
+    // replace the buffers and arrays of mesh with new ones without storage
+    inline void renew(MeshBuffers &mesh) {
+        mesh.array = xtr::Array{};
+        mesh.depth_array = xtr::Array{};
+        mesh.vertex_buffer = xtr::Buffer{GL_ARRAY_BUFFER};
+        mesh.abstracted_buffer = xtr::Buffer{GL_ARRAY_BUFFER};
+        mesh.element_buffer = xtr::Buffer{GL_ELEMENT_ARRAY_BUFFER};
+        mesh.vertex_capacity = 0;
+        mesh.abstracted_capacity = 0;
+        mesh.element_capacity = 0;
+        mesh.immutable = false;
+        attach_buffers(mesh);
+    }
+
+    // mesh with storage that can be allocated again, for the uploads that
+    // size it with glBufferData
+    inline MeshBuffers &mutable_buffers(MeshBuffers &mesh) {
+        if (mesh.immutable) {
+            renew(mesh);
+        }
+        return mesh;
+    }
+
+    inline void attach_buffers(MeshBuffers &mesh) {
+        mesh.vertex_buffer.label("mesh vertices");
+        mesh.abstracted_buffer.label("mesh abstracted normals");
+        mesh.element_buffer.label("mesh indices");
+        mesh.array.bind();
+        mesh.vertex_buffer.bind();
+        mesh.element_buffer.bind();
+        attrib_mesh(0, 1);
+        attrib_abstracted(2, false);
+        mesh.array.unbind();
+        mesh.depth_array.bind();
+        mesh.vertex_buffer.bind();
+        mesh.element_buffer.bind();
+        attrib_mesh(0, -1);
+        mesh.depth_array.unbind();
+    }
+
+    // buffers to upload into, neither drawn nor streaming. an unkept mesh
+    // is reused first, then the least recently drawn one if the cache is
+    // full, so its storage may be large enough already
+    inline MeshBuffers &acquire() {
+        MeshBuffers *oldest = nullptr;
+        for (const auto &mesh : _meshes) {
+            if (mesh.get() == _front || mesh.get() == _back) {
+                continue;
+            }
+            if (mesh->key.empty()) {
+                return *mesh;
+            }
+            if (!oldest || mesh->used < oldest->used) {
+                oldest = mesh.get();
+            }
+        }
+        if (oldest && cached_bytes() >= cache_budget) {
+            oldest->key.clear();
+            ++_cache_evictions;
+            return *oldest;
+        }
+        return create();
+    }
+
+    // draw mesh from now on, and release meshes over the budget, unkept
+    // ones first and then the least recently drawn
+    inline void show(MeshBuffers &mesh) {
+        _front = &mesh;
+        _front->used = ++_clock;
+        for (const auto &other : _meshes) {
+            // a mesh uploaded again replaces its old copy
+            if (other.get() != _front && other->key == _front->key) {
+                other->key.clear();
+            }
+        }
+        auto first_evicted = [](const auto &l, const auto &r) {
+            return l->key.empty() != r->key.empty() ? l->key.empty()
+                                                    : l->used < r->used;
+        };
+        while (cached_bytes() > cache_budget) {
+            auto victim = _meshes.end();
+            for (auto it = _meshes.begin(); it != _meshes.end(); ++it) {
+                if (it->get() != _front && it->get() != _back &&
+                    (victim == _meshes.end() || first_evicted(*it, *victim))) {
+                    victim = it;
+                }
+            }
+            if (victim == _meshes.end()) {
+                break;
+            }
+            _cache_evictions += !(*victim)->key.empty();
+            _meshes.erase(victim);
+        }
+    }
+
+    // bind the framebuffer and set the uniforms every draw shares
+    inline void use_program(const xtr::Program &program,
+                            const glm::mat4 &model_matrix,
+                            const glm::mat4 &view_matrix,
+                            const glm::mat4 &projection_matrix,
+                            const float normal_factor,
+                            const int abstracted_shape,
+                            const glm::vec3 &bb_dimension,
+                            const int id) const {
+        _framebuffer.bind();
+        program.use();
+        program.uni_mat4(program.loc("uni_model"), model_matrix);
+        program.uni_mat4(program.loc("uni_view"), view_matrix);
+        program.uni_mat4(program.loc("uni_projection"), projection_matrix);
+        program.uni_1f(program.loc("uni_normal_factor"), normal_factor);
+        program.uni_1i(program.loc("uni_abstracted_shape"), abstracted_shape);
+        program.uni_vec3(program.loc("uni_bb_dimension"), bb_dimension);
+        program.uni_1i(program.loc("uni_dominant_axis"),
+                       dominant_axis(bb_dimension));
+        program.uni_1i(program.loc("uni_id"), id);
+    }
+
+    // draw into the buffers, after a depth pre-pass when the mode asks for
+    // one. the fragments of both passes are counted on measuring draws,
+    // for mesh when it is not null
+    template <class D, class G>
+    inline void draw_passes(const glm::mat4 &model_matrix,
+                            const glm::mat4 &view_matrix,
+                            const glm::mat4 &projection_matrix,
+                            const float normal_factor,
+                            const int abstracted_shape,
+                            const glm::vec3 &bb_dimension, const int id,
+                            MeshBuffers *mesh, D &&draw_depth,
+                            G &&draw_geometry) {
+        collect_overdraw();
+        // auto measures now and then, and whenever the geometry changes
+        const bool measure =
+            pre_pass != PrePass::Off &&
+            (_draws++ % measure_interval == 0 || mesh != _last_mesh);
+        _last_mesh = mesh;
+        _pre_pass_used =
+            pre_pass == PrePass::On ||
+            (pre_pass == PrePass::Auto &&
+             (measure || _overdraw > pre_pass_threshold));
+        Measurement *measurement = nullptr;
+        if (_pre_pass_used && (measure || pre_pass == PrePass::On)) {
+            for (Measurement &slot : _measurements) {
+                if (!slot.pending) {
+                    measurement = &slot;
+                    break;
+                }
+            }
+        }
+        write_coverage(true);
+        if (_pre_pass_used) {
+            use_program(_depth_program, model_matrix, view_matrix,
+                        projection_matrix, normal_factor, abstracted_shape,
+                        bb_dimension, id);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            if (measurement) {
+                glBeginQuery(GL_SAMPLES_PASSED, measurement->queries[0]);
+            }
+            draw_depth();
+            if (measurement) {
+                glEndQuery(GL_SAMPLES_PASSED);
+            }
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+        use_program(_program, model_matrix, view_matrix, projection_matrix,
+                    normal_factor, abstracted_shape, bb_dimension, id);
+        if (measurement) {
+            glBeginQuery(GL_SAMPLES_PASSED, measurement->queries[1]);
+        }
+        draw_geometry();
+        if (measurement) {
+            glEndQuery(GL_SAMPLES_PASSED);
+            measurement->mesh = mesh;
+            measurement->pending = true;
+        }
+        if (_pre_pass_used) {
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
+        write_coverage(false);
+    }
+
+    // mark the pixels the mesh covers with 1 in the stencil while on
+    static inline void write_coverage(const bool on) {
+        if (on) {
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_ALWAYS, 1, 0xff);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        } else {
+            glDisable(GL_STENCIL_TEST);
+        }
+    }
+
+    // read the measurements the gpu has finished, without waiting
+    inline void collect_overdraw() {
+        for (Measurement &measurement : _measurements) {
+            if (!measurement.pending) {
+                continue;
+            }
+            GLint available = 0;
+            glGetQueryObjectiv(measurement.queries[1],
+                               GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                continue;
+            }
+            measurement.pending = false;
+            GLuint depth_fragments = 0, covered = 0;
+            glGetQueryObjectuiv(measurement.queries[0], GL_QUERY_RESULT,
+                                &depth_fragments);
+            glGetQueryObjectuiv(measurement.queries[1], GL_QUERY_RESULT,
+                                &covered);
+            if (covered == 0) {
+                continue;
+            }
+            _overdraw = float(depth_fragments) / float(covered);
+            // the mesh may have been released since
+            for (const auto &mesh : _meshes) {
+                if (mesh.get() == measurement.mesh) {
+                    mesh->overdraw = _overdraw;
+                }
+            }
+        }
+    }
+
+    // drop the rest of a mesh still streaming into the back buffers
+    inline void cancel_stream() {
+        if (_streaming) {
+            _ring->cancel(_back->vertex_buffer);
+            _ring->cancel(_back->abstracted_buffer);
+            _ring->cancel(_back->element_buffer);
+            _back = nullptr;
+            _streaming = false;
+        }
+    }
+
+    xtr::Program _program, _splat_program, _depth_program;
+    // resident meshes. the front one is drawn, the back one receives
+    // streamed uploads
+    std::vector<std::unique_ptr<MeshBuffers>> _meshes;
+    MeshBuffers *_front = nullptr, *_back = nullptr;
+    uint64_t _clock = 0;
+    size_t _cache_hits = 0, _cache_evictions = 0;
+    UploadRing *_ring = nullptr;
+    size_t _stream_ticket = 0;
+    std::string _stream_key;
+    bool _streaming = false;
+    // occlusion queries of the depth pass and the buffer pass, a few draws
+    // may be in flight
+    static constexpr int measurement_slots = 4;
+    static constexpr uint64_t measure_interval = 30;
+    struct Measurement {
+        GLuint queries[2] = {0, 0};
+        const MeshBuffers *mesh = nullptr;
+        bool pending = false;
+    };
+    Measurement _measurements[measurement_slots];
+    const MeshBuffers *_last_mesh = nullptr;
+    uint64_t _draws = 0;
+    float _overdraw = 0.f;
+    bool _pre_pass_used = false;
+    TargetPool &_pool;
+    glm::ivec2 _extent;
     xtr::Framebuffer _framebuffer;
     xtr::Texture _position_texture, _normal_texture, _id_texture;
     xtr::Renderbuffer _depth_buffer;
-    GLsizei _draw_count;
 };
 } // namespace xtr
@@ -0,0 +1,742 @@
+// out-of-core rendering of meshes larger than memory
+// - build_meshlets converts a mesh into a paged file of clusters organized as
+//   a binary tree, the leaves hold the full resolution mesh and every parent a
+//   simplified version of its two children
+// - MeshletStream keeps only the small tree in memory, and streams the
+//   clusters the current view needs into a fixed-size pool of gpu slots, by
+//   visibility and screen-space error, evicting the least recently used ones
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <xtr_buffer.h>
+#include <xtr_mesh.h>
+#include <xtr_obj.h>
+#include <xtr_trace.h>
+
+namespace xtr {
+// clusters index their own vertices with 16 bits, and every cluster fits in
+// one slot of the gpu pool
+constexpr uint32_t meshlet_max_vertices = 8192;
+constexpr uint32_t meshlet_max_triangles = 8192;
+
+// one cluster of the tree, as stored in the file
+struct MeshletNode {
+    // bounding sphere, enclosing the spheres of the children too
+    glm::vec3 center;
+    float radius;
+    // geometric error against the full resolution mesh, 0 for leaves and
+    // never smaller than the error of the children
+    float error;
+    // -1 for leaves
+    int32_t children[2];
+    uint32_t vertex_count;
+    uint32_t index_count;
+    // of the vertices in the file, the indices follow them
+    uint64_t offset;
+};
+
+// file header, the node table is at the end of the file
+struct MeshletHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t node_count;
+    uint32_t root;
+    uint64_t node_offset;
+    // of the whole mesh, for the analytic abstracted shapes
+    glm::vec3 bb_dimension;
+};
+
+// clusters carry the smooth abstracted normal with every vertex
+struct MeshletVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec3 abstracted_normal;
+};
+
+// vertices and 16 bit indices of a single cluster
+struct MeshletGeometry {
+    std::vector<MeshletVertex> vertices;
+    std::vector<uint16_t> indices;
+};
+
+// builds the cluster tree of a mesh in memory and writes it out, see
+// build_meshlets
+class MeshletBuilder {
+  public:
+    MeshletBuilder(const Mesh &mesh, std::ofstream &file)
+        : _mesh{mesh}, _file{file}, _remap(mesh.vertices.size(), -1) {
+        // clustering of the first parents starts at the mean edge length
+        double edges = 0.;
+        for (size_t i = 0; i < _mesh.indices.size(); i += 3) {
+            edges += glm::length(_mesh.vertices[_mesh.indices[i + 1]].position -
+                                 _mesh.vertices[_mesh.indices[i]].position);
+        }
+        _base_cell = float(edges / double(std::max<size_t>(
+                                       1, _mesh.indices.size() / 3)));
+        _base_cell = std::max(_base_cell, 1e-6f);
+    }
+
+    // write the clusters of every triangle, returns the root
+    inline int build() {
+        std::vector<uint32_t> triangles(_mesh.indices.size() / 3);
+        for (uint32_t i = 0; i < triangles.size(); ++i) {
+            triangles[i] = i;
+        }
+        MeshletGeometry geometry;
+        int level = 0;
+        return node(triangles.begin(), triangles.end(), geometry, level);
+    }
+
+    inline const std::vector<MeshletNode> &nodes() const { return _nodes; }
+
+  private:
+    using Iterator = std::vector<uint32_t>::iterator;
+
+    // build the subtree of the triangles in [begin, end), geometry receives
+    // the cluster of its root and level how coarse that cluster is
+    inline int node(const Iterator begin, const Iterator end,
+                    MeshletGeometry &geometry, int &level) {
+        if (size_t(end - begin) <= meshlet_max_triangles &&
+            leaf(begin, end, geometry)) {
+            level = 0;
+            return write(geometry, 0.f, {-1, -1});
+        }
+        // split at the median centroid along the longest axis
+        glm::vec3 lowest{1e30f}, highest{-1e30f};
+        for (Iterator t = begin; t != end; ++t) {
+            const glm::vec3 c = centroid(*t);
+            lowest = glm::min(lowest, c);
+            highest = glm::max(highest, c);
+        }
+        const glm::vec3 extent = highest - lowest;
+        const int axis = extent.x > extent.y && extent.x > extent.z ? 0
+                         : extent.y > extent.z                      ? 1
+                                                                    : 2;
+        const Iterator mid = begin + (end - begin) / 2;
+        std::nth_element(begin, mid, end, [&](uint32_t a, uint32_t b) {
+            return centroid(a)[axis] < centroid(b)[axis];
+        });
+        MeshletGeometry left, right;
+        int left_level = 0, right_level = 0;
+        const int l = node(begin, mid, left, left_level);
+        const int r = node(mid, end, right, right_level);
+        level = std::max(left_level, right_level);
+        float error = simplify(left, right, geometry, level);
+        error = std::max({error, _nodes[l].error, _nodes[r].error});
+        return write(geometry, error, {l, r});
+    }
+
+    inline glm::vec3 centroid(const uint32_t triangle) const {
+        const int *index = &_mesh.indices[size_t(triangle) * 3];
+        return _mesh.vertices[index[0]].position +
+               _mesh.vertices[index[1]].position +
+               _mesh.vertices[index[2]].position;
+    }
+
+    // full resolution cluster, false if it has too many vertices
+    inline bool leaf(const Iterator begin, const Iterator end,
+                     MeshletGeometry &geometry) {
+        geometry.vertices.clear();
+        geometry.indices.clear();
+        bool fits = true;
+        for (Iterator t = begin; t != end && fits; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                const int v = _mesh.indices[size_t(*t) * 3 + k];
+                if (_remap[v] < 0) {
+                    fits = geometry.vertices.size() < meshlet_max_vertices;
+                    if (!fits) {
+                        break;
+                    }
+                    _remap[v] = int(geometry.vertices.size());
+                    geometry.vertices.push_back(
+                        {_mesh.vertices[v].position, _mesh.vertices[v].normal,
+                         _mesh.abstracted_normals[v]});
+                    _touched.push_back(v);
+                }
+                geometry.indices.push_back(uint16_t(_remap[v]));
+            }
+        }
+        for (const int v : _touched) {
+            _remap[v] = -1;
+        }
+        _touched.clear();
+        return fits;
+    }
+
+    // vertex clustering of both children on a global grid, so that clusters
+    // of the same level agree along their borders. the cell doubles until the
+    // result fits a slot, and its diagonal is the error
+    inline float simplify(const MeshletGeometry &left,
+                          const MeshletGeometry &right,
+                          MeshletGeometry &geometry, int &level) {
+        struct Cell {
+            glm::vec3 position, normal, abstracted_normal;
+            uint32_t count;
+        };
+        std::unordered_map<uint64_t, uint32_t> cells;
+        std::vector<Cell> sums;
+        std::vector<uint32_t> remap;
+        for (;; ++level) {
+            const float cell = _base_cell * std::ldexp(1.f, level);
+            cells.clear();
+            sums.clear();
+            remap.clear();
+            auto add = [&](const MeshletGeometry &child) {
+                for (const MeshletVertex &vertex : child.vertices) {
+                    const glm::vec3 g = glm::floor(vertex.position / cell);
+                    auto key = [](const float x) {
+                        return uint64_t(int64_t(x) + (1 << 20)) & 0x1fffff;
+                    };
+                    const uint64_t k =
+                        key(g.x) << 42 | key(g.y) << 21 | key(g.z);
+                    auto [it, inserted] =
+                        cells.emplace(k, uint32_t(sums.size()));
+                    if (inserted) {
+                        sums.push_back({glm::vec3{0.f}, glm::vec3{0.f},
+                                        glm::vec3{0.f}, 0});
+                    }
+                    Cell &sum = sums[it->second];
+                    sum.position += vertex.position;
+                    sum.normal += vertex.normal;
+                    sum.abstracted_normal += vertex.abstracted_normal;
+                    ++sum.count;
+                    remap.push_back(it->second);
+                }
+            };
+            add(left);
+            add(right);
+            geometry.indices.clear();
+            auto triangles = [&](const MeshletGeometry &child,
+                                 const uint32_t first) {
+                for (size_t i = 0; i < child.indices.size(); i += 3) {
+                    const uint32_t a = remap[first + child.indices[i]],
+                                   b = remap[first + child.indices[i + 1]],
+                                   c = remap[first + child.indices[i + 2]];
+                    if (a != b && b != c && c != a) {
+                        geometry.indices.insert(
+                            geometry.indices.end(),
+                            {uint16_t(a), uint16_t(b), uint16_t(c)});
+                    }
+                }
+            };
+            if (sums.size() > meshlet_max_vertices) {
+                continue;
+            }
+            triangles(left, 0);
+            triangles(right, uint32_t(left.vertices.size()));
+            if (geometry.indices.size() > meshlet_max_triangles * 3) {
+                continue;
+            }
+            geometry.vertices.resize(sums.size());
+            for (size_t i = 0; i < sums.size(); ++i) {
+                const Cell &sum = sums[i];
+                geometry.vertices[i] = {sum.position / float(sum.count),
+                                        safe_normalize(sum.normal),
+                                        safe_normalize(sum.abstracted_normal)};
+            }
+            ++level;
+            return cell * std::sqrt(3.f);
+        }
+    }
+
+    static inline glm::vec3 safe_normalize(const glm::vec3 &n) {
+        const float length = glm::length(n);
+        return length > 0.f ? n / length : glm::vec3{0.f, 1.f, 0.f};
+    }
+
+    // append a cluster to the file and the node table
+    inline int write(const MeshletGeometry &geometry, const float error,
+                     const std::pair<int, int> children) {
+        MeshletNode node{};
+        glm::vec3 lowest{1e30f}, highest{-1e30f};
+        for (const MeshletVertex &vertex : geometry.vertices) {
+            lowest = glm::min(lowest, vertex.position);
+            highest = glm::max(highest, vertex.position);
+        }
+        node.center = (lowest + highest) * 0.5f;
+        for (const MeshletVertex &vertex : geometry.vertices) {
+            node.radius = std::max(node.radius,
+                                   glm::length(vertex.position - node.center));
+        }
+        for (const int child : {children.first, children.second}) {
+            if (child >= 0) {
+                const MeshletNode &c = _nodes[child];
+                node.radius =
+                    std::max(node.radius,
+                             glm::length(c.center - node.center) + c.radius);
+            }
+        }
+        node.error = error;
+        node.children[0] = children.first;
+        node.children[1] = children.second;
+        node.vertex_count = uint32_t(geometry.vertices.size());
+        node.index_count = uint32_t(geometry.indices.size());
+        node.offset = uint64_t(_file.tellp());
+        _file.write((const char *)geometry.vertices.data(),
+                    std::streamsize(geometry.vertices.size() *
+                                    sizeof(MeshletVertex)));
+        _file.write(
+            (const char *)geometry.indices.data(),
+            std::streamsize(geometry.indices.size() * sizeof(uint16_t)));
+        _nodes.push_back(node);
+        return int(_nodes.size()) - 1;
+    }
+
+    const Mesh &_mesh;
+    std::ofstream &_file;
+    std::vector<MeshletNode> _nodes;
+    // global to cluster vertex index while building a leaf
+    std::vector<int> _remap;
+    std::vector<int> _touched;
+    float _base_cell = 1.f;
+};
+
+constexpr char meshlet_magic[4] = {'X', 'T', 'R', 'M'};
+constexpr uint32_t meshlet_version = 2;
+
+// convert the mesh at mesh_path, processed like load_mesh does, into a paged
+// cluster file at out_path. the conversion runs in memory once, rendering the
+// result does not
+inline bool build_meshlets(const std::filesystem::path &mesh_path,
+                           const std::filesystem::path &out_path,
+                           const bool y_up, const bool x_front) {
+    const Mesh mesh = load_mesh(mesh_path, true, y_up, x_front);
+    if (mesh.indices.empty()) {
+        return false;
+    }
+    std::ofstream file{out_path, std::ios::out | std::ios::binary};
+    MeshletHeader header{};
+    memcpy(header.magic, meshlet_magic, 4);
+    header.version = meshlet_version;
+    header.bb_dimension = mesh.bb_dimension;
+    file.write((const char *)&header, sizeof(header));
+    MeshletBuilder builder{mesh, file};
+    header.root = uint32_t(builder.build());
+    header.node_count = uint32_t(builder.nodes().size());
+    header.node_offset = uint64_t(file.tellp());
+    file.write((const char *)builder.nodes().data(),
+               std::streamsize(builder.nodes().size() * sizeof(MeshletNode)));
+    file.seekp(0);
+    file.write((const char *)&header, sizeof(header));
+    return bool(file);
+}
+
+// streaming renderer of a cluster file. the tree is walked every frame from
+// the root, descending where the projected error of a cluster is above the
+// threshold and its visible children are resident. missing children are read
+// by a loader thread and uploaded a few per frame, until then the parent is
+// drawn. the root stays resident, and the walk touches every cluster it
+// passes so that parents are never evicted before their children
+class MeshletStream {
+  public:
+    MeshletStream(const std::filesystem::path &file_path,
+                  const size_t pool_bytes = size_t(256) << 20)
+        : _vertex_buffer{GL_ARRAY_BUFFER},
+          _element_buffer{GL_ELEMENT_ARRAY_BUFFER} {
+        std::ifstream file{file_path, std::ios::in | std::ios::binary};
+        MeshletHeader header{};
+        file.read((char *)&header, sizeof(header));
+        if (!file || memcmp(header.magic, meshlet_magic, 4) != 0 ||
+            header.version != meshlet_version || header.node_count == 0 ||
+            header.root >= header.node_count) {
+            return;
+        }
+        _nodes.resize(header.node_count);
+        file.seekg(std::streamoff(header.node_offset));
+        file.read((char *)_nodes.data(),
+                  std::streamsize(_nodes.size() * sizeof(MeshletNode)));
+        for (const MeshletNode &node : _nodes) {
+            if (node.vertex_count > meshlet_max_vertices ||
+                node.index_count > meshlet_max_triangles * 3 ||
+                node.children[0] >= int(_nodes.size()) ||
+                node.children[1] >= int(_nodes.size())) {
+                file.setstate(std::ios::failbit);
+            }
+        }
+        if (!file) {
+            _nodes.clear();
+            return;
+        }
+        _root = int(header.root);
+        _bb_dimension = header.bb_dimension;
+
+        _slot_count = std::max<size_t>(16, pool_bytes / slot_bytes());
+        _vertex_buffer.label("meshlet vertex pool");
+        _element_buffer.label("meshlet index pool");
+        _array.bind();
+        _vertex_buffer.bind();
+        _vertex_buffer.data(GLsizeiptr(_slot_count * slot_vertex_bytes()),
+                            nullptr, GL_DYNAMIC_DRAW);
+        _element_buffer.bind();
+        _element_buffer.data(GLsizeiptr(_slot_count * slot_index_bytes()),
+                             nullptr, GL_DYNAMIC_DRAW);
+        for (int i = 0; i < 3; ++i) {
+            glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE,
+                                  sizeof(MeshletVertex),
+                                  (void *)(i * sizeof(glm::vec3)));
+            glEnableVertexAttribArray(i);
+        }
+        _array.unbind();
+        _node_slot.assign(_nodes.size(), -1);
+        _requested.assign(_nodes.size(), false);
+        _slot_node.assign(_slot_count, -1);
+        _last_used.assign(_slot_count, 0);
+
+        // the root is loaded right away, so there is always something to draw.
+        // a file whose root cannot be read or placed is not valid
+        MeshletGeometry root;
+        if (!read(file, _root, root)) {
+            _nodes.clear();
+            return;
+        }
+        upload(_root, root);
+        if (_node_slot[_root] < 0) {
+            _nodes.clear();
+            return;
+        }
+
+        _path = file_path;
+        _loader = std::thread([this]() { load(); });
+    }
+    MeshletStream(const MeshletStream &) = delete;
+    MeshletStream &operator=(const MeshletStream &) = delete;
+    ~MeshletStream() {
+        if (_loader.joinable()) {
+            {
+                std::lock_guard lock{_mutex};
+                _stop = true;
+            }
+            _wake.notify_all();
+            _loader.join();
+        }
+    }
+
+    inline bool valid() const { return !_nodes.empty(); }
+
+    // select the clusters for this view, queue the missing ones, and upload
+    // what the loader has finished. call once per frame before draw
+    inline void update(const glm::mat4 &model_view,
+                       const glm::mat4 &projection, const int viewport_height) {
+        if (!valid()) {
+            return;
+        }
+        XTR_TRACE_SCOPE("meshlet update");
+        ++_frame;
+        const glm::vec3 camera = glm::vec3(glm::inverse(model_view)[3]);
+        const glm::mat4 clip = projection * model_view;
+        glm::vec4 planes[6];
+        for (int i = 0; i < 3; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                planes[i * 2][c] = clip[c][3] + clip[c][i];
+                planes[i * 2 + 1][c] = clip[c][3] - clip[c][i];
+            }
+        }
+        auto visible = [&](const MeshletNode &node) {
+            for (const glm::vec4 &plane : planes) {
+                const float d = plane.x * node.center.x +
+                                plane.y * node.center.y +
+                                plane.z * node.center.z + plane.w;
+                const float length =
+                    glm::length(glm::vec3{plane.x, plane.y, plane.z});
+                if (d < -node.radius * length) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        // error in pixels at the nearest point of the bounding sphere
+        const float pixels = projection[1][1] * float(viewport_height) * 0.5f;
+        auto projected_error = [&](const MeshletNode &node) {
+            const float distance = std::max(
+                glm::length(camera - node.center) - node.radius, 1e-3f);
+            return node.error * pixels / distance;
+        };
+
+        _selected.clear();
+        _wanted.clear();
+        _stack.assign(1, _root);
+        while (!_stack.empty()) {
+            const int n = _stack.back();
+            _stack.pop_back();
+            const MeshletNode &node = _nodes[n];
+            _last_used[_node_slot[n]] = _frame;
+            if (!visible(node)) {
+                continue;
+            }
+            const float error = projected_error(node);
+            if (node.children[0] < 0 || error <= error_threshold) {
+                _selected.push_back(n);
+                continue;
+            }
+            bool ready = true;
+            for (const int child : node.children) {
+                if (child >= 0 && _node_slot[child] < 0 &&
+                    visible(_nodes[child])) {
+                    ready = false;
+                    if (!_requested[child]) {
+                        _wanted.push_back({error, child});
+                    }
+                }
+            }
+            if (!ready) {
+                _selected.push_back(n);
+                continue;
+            }
+            for (const int child : node.children) {
+                if (child >= 0 && _node_slot[child] >= 0) {
+                    _stack.push_back(child);
+                }
+            }
+        }
+        request();
+        receive();
+
+        _draw_counts.clear();
+        _draw_offsets.clear();
+        _draw_base_vertices.clear();
+        _drawn_triangles = 0;
+        for (const int n : _selected) {
+            const size_t slot = size_t(_node_slot[n]);
+            _draw_counts.push_back(GLsizei(_nodes[n].index_count));
+            _draw_offsets.push_back(
+                reinterpret_cast<const void *>(slot * slot_index_bytes()));
+            _draw_base_vertices.push_back(
+                GLint(slot * meshlet_max_vertices));
+            _drawn_triangles += _nodes[n].index_count / 3;
+        }
+    }
+
+    // draw the selected clusters, with the program of the mesh pass in use
+    inline void draw() const {
+        if (_draw_counts.empty()) {
+            return;
+        }
+        _array.bind();
+        glMultiDrawElementsBaseVertex(
+            GL_TRIANGLES, _draw_counts.data(), GL_UNSIGNED_SHORT,
+            _draw_offsets.data(), GLsizei(_draw_counts.size()),
+            _draw_base_vertices.data());
+        _array.unbind();
+    }
+
+    // pixels of geometric error that are tolerated before refining
+    float error_threshold = 1.f;
+    // clusters uploaded per frame at most
+    int upload_budget = 8;
+
+    inline const glm::vec3 &bb_dimension() const { return _bb_dimension; }
+    inline size_t cluster_count() const { return _nodes.size(); }
+    inline size_t slot_count() const { return _slot_count; }
+    inline size_t resident_count() const { return _resident; }
+    inline size_t selected_count() const { return _selected.size(); }
+    inline size_t drawn_triangles() const { return _drawn_triangles; }
+    inline size_t pending_count() const { return _pending; }
+    inline size_t pool_bytes() const { return _slot_count * slot_bytes(); }
+    inline size_t streamed_bytes() const { return _streamed_bytes; }
+
+  private:
+    struct Wanted {
+        float priority;
+        int node;
+    };
+    struct Loaded {
+        int node;
+        MeshletGeometry geometry;
+    };
+
+    static inline size_t slot_index_bytes() {
+        return meshlet_max_triangles * 3 * sizeof(uint16_t);
+    }
+    static inline size_t slot_vertex_bytes() {
+        return meshlet_max_vertices * sizeof(MeshletVertex);
+    }
+    static inline size_t slot_bytes() {
+        return slot_vertex_bytes() + slot_index_bytes();
+    }
+
+    inline bool read(std::ifstream &file, const int n,
+                     MeshletGeometry &geometry) const {
+        const MeshletNode &node = _nodes[n];
+        geometry.vertices.resize(node.vertex_count);
+        geometry.indices.resize(node.index_count);
+        file.seekg(std::streamoff(node.offset));
+        file.read((char *)geometry.vertices.data(),
+                  std::streamsize(node.vertex_count * sizeof(MeshletVertex)));
+        file.read((char *)geometry.indices.data(),
+                  std::streamsize(node.index_count * sizeof(uint16_t)));
+        return bool(file);
+    }
+
+    // hand the most important missing clusters to the loader, replacing the
+    // requests it has not started yet
+    inline void request() {
+        std::sort(_wanted.begin(), _wanted.end(),
+                  [](const Wanted &a, const Wanted &b) {
+                      return a.priority < b.priority;
+                  });
+        const size_t queued = std::min<size_t>(_wanted.size(),
+                                               size_t(upload_budget) * 2);
+        {
+            std::lock_guard lock{_mutex};
+            for (const int n : _queue) {
+                _requested[n] = false;
+            }
+            _queue.clear();
+            // highest priority last, the loader pops from the back
+            for (size_t i = _wanted.size() - queued; i < _wanted.size(); ++i) {
+                _queue.push_back(_wanted[i].node);
+                _requested[_wanted[i].node] = true;
+            }
+            _pending = _queue.size() + _loading;
+        }
+        _wake.notify_one();
+    }
+
+    // upload finished clusters, up to the budget
+    inline void receive() {
+        {
+            std::lock_guard lock{_mutex};
+            while (!_loaded.empty() &&
+                   _uploading.size() < size_t(upload_budget)) {
+                _uploading.push_back(std::move(_loaded.back()));
+                _loaded.pop_back();
+            }
+        }
+        for (Loaded &loaded : _uploading) {
+            upload(loaded.node, loaded.geometry);
+            _requested[loaded.node] = false;
+        }
+        std::lock_guard lock{_mutex};
+        for (Loaded &loaded : _uploading) {
+            _spare.push_back(std::move(loaded.geometry));
+        }
+        _uploading.clear();
+    }
+
+    // copy a cluster into a free slot, or the least recently used one that
+    // was not touched this frame. the cluster is dropped if there is none
+    inline void upload(const int n, const MeshletGeometry &geometry) {
+        if (_node_slot[n] >= 0 || geometry.vertices.empty()) {
+            return;
+        }
+        int slot = -1;
+        uint64_t oldest = _frame;
+        for (size_t s = 0; s < _slot_count; ++s) {
+            if (_slot_node[s] < 0) {
+                slot = int(s);
+                break;
+            }
+            if (_slot_node[s] != _root && _last_used[s] < oldest) {
+                oldest = _last_used[s];
+                slot = int(s);
+            }
+        }
+        if (slot < 0) {
+            return;
+        }
+        if (_slot_node[slot] >= 0) {
+            _node_slot[_slot_node[slot]] = -1;
+            --_resident;
+        }
+        _vertex_buffer.bind();
+        glBufferSubData(
+            GL_ARRAY_BUFFER,
+            GLintptr(size_t(slot) * slot_vertex_bytes()),
+            GLsizeiptr(geometry.vertices.size() * sizeof(MeshletVertex)),
+            geometry.vertices.data());
+        _vertex_buffer.unbind();
+        // the element buffer binding belongs to the vao
+        _array.bind();
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                        GLintptr(size_t(slot) * slot_index_bytes()),
+                        GLsizeiptr(geometry.indices.size() * sizeof(uint16_t)),
+                        geometry.indices.data());
+        _array.unbind();
+        _slot_node[slot] = n;
+        _node_slot[n] = slot;
+        _last_used[slot] = _frame;
+        ++_resident;
+        _streamed_bytes += geometry.vertices.size() * sizeof(MeshletVertex) +
+                           geometry.indices.size() * sizeof(uint16_t);
+    }
+
+    // loader thread, reads requested clusters into spare buffers. only the
+    // render thread touches the residency state
+    inline void load() {
+        tracer().name_thread("meshlet loader");
+        std::ifstream file{_path, std::ios::in | std::ios::binary};
+        std::unique_lock lock{_mutex};
+        for (;;) {
+            _wake.wait(lock, [this]() { return _stop || !_queue.empty(); });
+            if (_stop) {
+                return;
+            }
+            Loaded loaded{_queue.back(), {}};
+            _queue.pop_back();
+            if (!_spare.empty()) {
+                loaded.geometry = std::move(_spare.back());
+                _spare.pop_back();
+            }
+            ++_loading;
+            lock.unlock();
+            bool ok = false;
+            {
+                XTR_TRACE_SCOPE("read cluster");
+                ok = read(file, loaded.node, loaded.geometry);
+            }
+            lock.lock();
+            --_loading;
+            if (!ok) {
+                // an empty cluster is dropped by upload, and requested again
+                file.clear();
+                loaded.geometry.vertices.clear();
+            }
+            _loaded.push_back(std::move(loaded));
+        }
+    }
+
+    std::vector<MeshletNode> _nodes;
+    int _root = -1;
+    glm::vec3 _bb_dimension{1.f};
+    std::filesystem::path _path;
+
+    xtr::Array _array;
+    xtr::Buffer _vertex_buffer, _element_buffer;
+    size_t _slot_count = 0;
+    std::vector<int> _node_slot, _slot_node;
+    std::vector<uint64_t> _last_used;
+    uint64_t _frame = 0;
+    size_t _resident = 0;
+    size_t _streamed_bytes = 0;
+
+    // per frame selection and draw lists
+    std::vector<int> _selected, _stack;
+    std::vector<Wanted> _wanted;
+    std::vector<GLsizei> _draw_counts;
+    std::vector<const void *> _draw_offsets;
+    std::vector<GLint> _draw_base_vertices;
+    size_t _drawn_triangles = 0;
+
+    // shared with the loader thread
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::vector<int> _queue;
+    std::vector<Loaded> _loaded, _uploading;
+    std::vector<MeshletGeometry> _spare;
+    std::vector<bool> _requested;
+    size_t _loading = 0, _pending = 0;
+    bool _stop = false;
+    std::thread _loader;
+};
+} // namespace xtr
@@ -1,10 +1,20 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <map>
+#include <ostream>
 #include <miniply.h>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
+#include <xtr_buffer.h>
+#include <xtr_generate.h>
+#include <xtr_memory.h>
 #include <xtr_mesh.h>
+#include <xtr_parallel.h>
+#include <xtr_ply.h>
 
 namespace xtr {
 // load .obj file using tiny_obj_loader
@@ -48,7 +58,7 @@ load_obj_file(const std::filesystem::path &file_path) {
             index_offset += fv;
         }
     }
-    return {vertices, indices};
+    return {std::move(vertices), std::move(indices)};
 }
 
 // load .ply file using miniply
@@ -89,73 +99,87 @@ load_ply_file(const std::filesystem::path &file_path) {
         }
         r.next_element();
     }
-    return {vertices, indices};
+    return {std::move(vertices), std::move(indices)};
 }
 
-// create a mesh from file_path, adjust the orientation and scale, and generate
-// abstracted normal
-inline Mesh load_mesh(const std::filesystem::path &file_path,
-                      const int abstracted_shape, const bool y_up,
-                      const bool x_front) {
-    std::string file_extension = file_path.filename().extension();
-    std::pair<std::vector<glm::vec3>, std::vector<int>> loaded_file;
-    // positions
-    std::vector<glm::vec3> ps;
-    // position indices, which is equivalent to vertex indices in this case
-    std::vector<int> indices;
-    if (file_extension == ".obj") {
-        loaded_file = load_obj_file(file_path);
-    } else if (file_extension == ".ply") {
-        loaded_file = load_ply_file(file_path);
-    } else {
+// memory and time spent by a mesh load
+struct MeshLoadStats {
+    size_t vertex_count = 0;
+    size_t triangle_count = 0;
+    // vertices merged into others by welding
+    size_t welded_count = 0;
+    // the most cpu memory the loader held at once, including the output when
+    // it is not a mapped buffer, and the size of the resulting mesh
+    size_t peak_bytes = 0;
+    size_t mesh_bytes = 0;
+    // peak resident set size of the process after the load
+    size_t peak_rss_bytes = 0;
+    double load_ms = 0.;
+    // whether the vertices were written straight into a mapped gpu buffer
+    bool mapped = false;
+
+    inline void report(std::ostream &os) const {
+        const double mib = 1024. * 1024.;
+        os << "mesh: " << vertex_count << " vertices, " << triangle_count
+           << " triangles, " << welded_count << " welded, " << load_ms
+           << " ms, peak " << double(peak_bytes) / mib << " MiB for "
+           << double(mesh_bytes) / mib << " MiB of mesh"
+           << (mapped ? " (mapped)" : "") << ", peak rss "
+           << double(peak_rss_bytes) / mib << " MiB\n";
+    }
+};
+
+// the stages of load_mesh_into, on their own so they can be measured
+
+// axis aligned bounding box of the positions
+struct MeshBounds {
+    glm::vec3 lowest{0.f}, highest{0.f};
+
+    inline glm::vec3 center() const { return (highest + lowest) / 2.f; }
+    inline glm::vec3 dimension() const { return glm::abs(highest - lowest); }
+    inline float diagonal() const { return glm::length(highest - lowest); }
+};
+
+inline MeshBounds mesh_bounds(const glm::vec3 *ps, const size_t count) {
+    if (count == 0) {
         return {};
     }
-    ps.resize(loaded_file.first.size());
-    indices = loaded_file.second;
+    MeshBounds bounds{ps[0], ps[0]};
+    for (size_t i = 1; i < count; ++i) {
+        bounds.highest = glm::max(bounds.highest, ps[i]);
+        bounds.lowest = glm::min(bounds.lowest, ps[i]);
+    }
+    return bounds;
+}
 
-    // we find the bounding box for the mesh, in order to resize and center the
-    // mesh
-    glm::vec3 bb_lowest = loaded_file.first[0];
-    glm::vec3 bb_highest = loaded_file.first[0];
-    for (int i = 1; i < ps.size(); ++i) {
-        bb_highest.x = std::max(bb_highest.x, loaded_file.first[i].x);
-        bb_highest.y = std::max(bb_highest.y, loaded_file.first[i].y);
-        bb_highest.z = std::max(bb_highest.z, loaded_file.first[i].z);
-        bb_lowest.x = std::min(bb_lowest.x, loaded_file.first[i].x);
-        bb_lowest.y = std::min(bb_lowest.y, loaded_file.first[i].y);
-        bb_lowest.z = std::min(bb_lowest.z, loaded_file.first[i].z);
-    }
-    glm::vec3 bb_center = (bb_highest + bb_lowest) / glm::vec3(2.0);
-    glm::vec3 bb_dimension = glm::abs(bb_highest - bb_lowest);
-    float bb_diag_size = glm::length(bb_highest - bb_lowest);
-
-    // center the mesh, using the bounding box center
-    for (int i = 0; i < ps.size(); ++i) {
-        if (y_up) {
-            ps[i].y = loaded_file.first[i].y - bb_center.y;
-            if (x_front) {
-                ps[i].x = loaded_file.first[i].x - bb_center.x;
-                ps[i].z = loaded_file.first[i].z - bb_center.z;
-            } else {
-                ps[i].x = loaded_file.first[i].z - bb_center.z;
-                ps[i].z = loaded_file.first[i].x - bb_center.x;
-            }
-        } else {
-            ps[i].y = loaded_file.first[i].z - bb_center.z;
-            if (x_front) {
-                ps[i].x = loaded_file.first[i].x - bb_center.x;
-                ps[i].z = loaded_file.first[i].y - bb_center.y;
-            } else {
-                ps[i].x = loaded_file.first[i].y - bb_center.y;
-                ps[i].z = loaded_file.first[i].x - bb_center.x;
-            }
-        }
+// turn p so y is up and x is the front, without moving or scaling it
+inline glm::vec3 orient(const glm::vec3 &p, const bool y_up,
+                        const bool x_front) {
+    if (y_up) {
+        return x_front ? glm::vec3{p.x, p.y, p.z} : glm::vec3{p.z, p.y, p.x};
+    }
+    return x_front ? glm::vec3{p.x, p.z, p.y} : glm::vec3{p.y, p.z, p.x};
+}
+
+// center the positions on the bounding box, scale them to a unit diagonal
+// and turn them so y is up and x is the front. the scale is uniform, so the
+// normals computed afterwards come out the same
+inline void recenter_positions(glm::vec3 *ps, const size_t count,
+                               const MeshBounds &bounds, const bool y_up,
+                               const bool x_front) {
+    const glm::vec3 center = bounds.center();
+    const float diagonal = bounds.diagonal();
+    for (size_t i = 0; i < count; ++i) {
+        ps[i] = orient((ps[i] - center) / diagonal, y_up, x_front);
     }
+}
 
-    // calculate vertex normal
-    Mesh mesh;
-    std::vector<glm::vec3> vns(ps.size(), glm::vec3{});
-    for (int i = 0; i < indices.size(); i += 3) {
+// area weighted vertex normals of the triangles into vns
+inline void vertex_normals(const glm::vec3 *ps, const size_t count,
+                           const int *indices, const size_t index_count,
+                           glm::vec3 *vns) {
+    std::fill(vns, vns + count, glm::vec3{});
+    for (size_t i = 0; i + 2 < index_count; i += 3) {
         glm::vec3 u = ps[indices[i + 1]] - ps[indices[i]],
                   v = ps[indices[i + 2]] - ps[indices[i]];
         glm::vec3 n = glm::cross(u, v);
@@ -163,55 +187,420 @@ inline Mesh load_mesh(const std::filesystem::path &file_path,
         vns[indices[i + 1]] += n;
         vns[indices[i + 2]] += n;
     }
-    for (int i = 0; i < ps.size(); ++i) {
+    for (size_t i = 0; i < count; ++i) {
         vns[i] = glm::normalize(vns[i]);
     }
+}
+
+// merging of the vertices that share a position, such as the split vertices
+// along the seams of exported meshes
+struct WeldOptions {
+    bool enabled = false;
+    // positions closer than this fraction of the bounding box diagonal merge
+    float tolerance = 1e-5f;
+    // vertices whose normals differ by more than this angle, in degrees, stay
+    // apart so hard edges keep their shading. 180 ignores the normals
+    float hard_angle = 180.f;
 
-    // calculate abstracted normal
-    std::vector<glm::vec3> ans(ps.size(), glm::vec3{});
-    std::vector<Vertex> vertices(ps.size());
-    if (abstracted_shape == 0) { // smooth
-        std::vector<glm::vec3> tns = vns;
-        const int iterations = 4; // iterations of laplace operator
-        for (int it = 0; it < iterations; ++it) {
-            for (int i = 0; i < indices.size(); i += 3) {
-                ans[indices[i]] += tns[indices[i + 1]] + tns[indices[i + 2]];
-                ans[indices[i + 1]] += tns[indices[i]] + tns[indices[i + 2]];
-                ans[indices[i + 2]] += tns[indices[i]] + tns[indices[i + 1]];
+    inline bool operator==(const WeldOptions &) const = default;
+};
+
+// merge the vertices closer than tolerance, and whose normals vns differ by
+// at most hard_angle when vns is given. every vertex goes into a lock-free
+// hash of grid cells, then looks for the lowest vertex in the cells around
+// it that it merges with. the positions are
+// compacted in place, indices rewritten and collapsed triangles dropped.
+// returns the number of vertices left, temporaries live in the scratch arena
+inline size_t weld_vertices(glm::vec3 *ps, const glm::vec3 *vns,
+                            const size_t count, std::vector<int> &indices,
+                            const float tolerance, const float hard_angle) {
+    ScratchArena &scratch = scratch_arena();
+    // cells four times the tolerance, so a vertex only looks into the
+    // neighbour cells whose faces are within the tolerance. the least size
+    // keeps the cell coordinates of a unit sized mesh within int
+    const float cell_size = std::max(4.f * tolerance, 1e-7f);
+    const float near_face = tolerance / cell_size;
+    const float max_distance2 = tolerance * tolerance;
+    const float min_dot = std::cos(glm::radians(hard_angle));
+    size_t table_size = 64;
+    while (table_size < 2 * count) {
+        table_size *= 2;
+    }
+    const size_t mask = table_size - 1;
+    // the first vertex of each cell in the table claims the slot, the
+    // others are pushed onto the list of the slot
+    glm::ivec3 *cells = scratch.alloc<glm::ivec3>(count);
+    int *owners = scratch.alloc<int>(table_size, -1);
+    int *heads = scratch.alloc<int>(table_size, -1);
+    int *next = scratch.alloc<int>(count);
+    int *remap = scratch.alloc<int>(count);
+    auto slot = [&](const glm::ivec3 &cell, const int insert) -> int64_t {
+        uint64_t h = (uint64_t(uint32_t(cell.x)) * 0x9e3779b97f4a7c15ull) ^
+                     (uint64_t(uint32_t(cell.y)) * 0xc2b2ae3d27d4eb4full) ^
+                     (uint64_t(uint32_t(cell.z)) * 0x165667b19e3779f9ull);
+        h ^= h >> 32;
+        size_t s = size_t(h) & mask;
+        for (;; s = (s + 1) & mask) {
+            std::atomic_ref<int> owner{owners[s]};
+            int o = owner.load(std::memory_order_acquire);
+            if (o < 0) {
+                if (insert < 0) {
+                    return -1;
+                }
+                if (owner.compare_exchange_strong(o, insert,
+                                                  std::memory_order_acq_rel)) {
+                    return int64_t(s);
+                }
             }
-            for (int i = 0; i < ps.size(); ++i) {
-                ans[i] = glm::normalize(ans[i]);
-                tns[i] = ans[i];
+            if (cells[o] == cell) {
+                return int64_t(s);
             }
         }
-    } else if (abstracted_shape == 1) { // ellipse
-        for (int i = 0; i < ps.size(); ++i) {
-            ans[i] = glm::normalize(glm::normalize(ps[i]) * bb_dimension);
-        }
-    } else if (abstracted_shape == 2) { // cylinder
-        for (int i = 0; i < ps.size(); ++i) {
-            ans[i] = ps[i];
-            if (bb_dimension.x > bb_dimension.y &&
-                bb_dimension.x > bb_dimension.z) {
-                ans[i].x = 0;
-            } else if (bb_dimension.y > bb_dimension.z &&
-                       bb_dimension.y > bb_dimension.x) {
-                ans[i].y = 0;
-            } else if (bb_dimension.z > bb_dimension.x &&
-                       bb_dimension.z > bb_dimension.y) {
-                ans[i].z = 0;
+    };
+
+    parallel_for(count, [&](const size_t begin, const size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            cells[v] = glm::ivec3{glm::floor(ps[v] / cell_size)};
+        }
+    });
+    parallel_for(count, [&](const size_t begin, const size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            std::atomic_ref<int> head{heads[slot(cells[v], int(v))]};
+            int h = head.load(std::memory_order_relaxed);
+            do {
+                next[v] = h;
+            } while (!head.compare_exchange_weak(h, int(v),
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+        }
+    });
+    // the lowest vertex each vertex merges with, itself at worst
+    parallel_for(count, [&](const size_t begin, const size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            // the neighbour cell along each axis, if any is close enough
+            const glm::vec3 f = ps[v] / cell_size - glm::vec3{cells[v]};
+            glm::ivec3 side{0, 0, 0};
+            for (int a = 0; a < 3; ++a) {
+                side[a] = f[a] <= near_face          ? -1
+                          : f[a] >= 1.f - near_face ? 1
+                                                    : 0;
             }
+            int lowest = int(v);
+            for (int n = 0; n < 8; ++n) {
+                if ((n & 1 && !side.x) || (n & 2 && !side.y) ||
+                    (n & 4 && !side.z)) {
+                    continue;
+                }
+                const int64_t s =
+                    slot(cells[v] + glm::ivec3{n & 1 ? side.x : 0,
+                                               n & 2 ? side.y : 0,
+                                               n & 4 ? side.z : 0},
+                         -1);
+                if (s < 0) {
+                    continue;
+                }
+                for (int u = heads[s]; u >= 0; u = next[u]) {
+                    const glm::vec3 d = ps[u] - ps[v];
+                    if (u < lowest && glm::dot(d, d) <= max_distance2 &&
+                        (!vns || glm::dot(vns[u], vns[v]) >= min_dot)) {
+                        lowest = u;
+                    }
+                }
+            }
+            remap[v] = lowest;
+        }
+    });
+
+    // number the kept vertices in order. a vertex merges into a lower one,
+    // which is numbered already, so chains of merges resolve on the way
+    size_t kept = 0;
+    for (size_t v = 0; v < count; ++v) {
+        if (remap[v] == int(v)) {
+            ps[kept] = ps[v];
+            remap[v] = int(kept++);
+        } else {
+            remap[v] = remap[remap[v]];
+        }
+    }
+    size_t index_count = 0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const int a = remap[indices[i]], b = remap[indices[i + 1]],
+                  c = remap[indices[i + 2]];
+        if (a != b && b != c && a != c) {
+            indices[index_count++] = a;
+            indices[index_count++] = b;
+            indices[index_count++] = c;
+        }
+    }
+    indices.resize(index_count);
+    return kept;
+}
+
+// abstracted normal of the smooth shape into ans, a few iterations of the
+// laplace operator over the vertex normals. tns is scratch of the same size
+inline void smooth_normals(const glm::vec3 *vns, const size_t count,
+                           const int *indices, const size_t index_count,
+                           glm::vec3 *ans, glm::vec3 *tns) {
+    std::fill(ans, ans + count, glm::vec3{});
+    std::copy(vns, vns + count, tns);
+    const int iterations = 4; // iterations of laplace operator
+    for (int it = 0; it < iterations; ++it) {
+        for (size_t i = 0; i + 2 < index_count; i += 3) {
+            ans[indices[i]] += tns[indices[i + 1]] + tns[indices[i + 2]];
+            ans[indices[i + 1]] += tns[indices[i]] + tns[indices[i + 2]];
+            ans[indices[i + 2]] += tns[indices[i]] + tns[indices[i + 1]];
+        }
+        for (size_t i = 0; i < count; ++i) {
             ans[i] = glm::normalize(ans[i]);
+            tns[i] = ans[i];
+        }
+    }
+}
+
+// interleave positions and normals into the final vertices
+inline void assemble_vertices(const glm::vec3 *ps, const glm::vec3 *vns,
+                              const size_t count, Vertex *vertices) {
+    parallel_for(count, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            vertices[i] = {ps[i], vns[i]};
+        }
+    });
+}
+
+// create a mesh from file_path, adjust the orientation and scale, and generate
+// the smooth abstracted normal if asked to, the other shapes are analytic.
+// coincident vertices are merged first when weld is enabled.
+// the results go to output, which provides
+// - Vertex *vertices(count, tally), memory for the final vertices, which may
+//   be a mapped buffer, or nullptr to give up. they are written once
+// - abstracted_normals(normals, count), the smooth normals when generated
+// - finish(indices, bb_dimension), once the vertices are written
+// temporaries live in the scratch arena
+template <class Output>
+inline bool load_mesh_into(const std::filesystem::path &file_path,
+                           const bool smooth, const bool y_up,
+                           const bool x_front, Output &output,
+                           MeshLoadStats *stats = nullptr,
+                           const WeldOptions &weld = {}) {
+    const auto start = std::chrono::steady_clock::now();
+    ScratchArena &scratch = scratch_arena();
+    // the arena is reset on every way out
+    struct ScratchReset {
+        ScratchArena &arena;
+        ~ScratchReset() { arena.reset(); }
+    } scratch_reset{scratch};
+    MemoryTally tally;
+
+    std::string file_extension = file_path.filename().extension();
+    // positions live in the arena for the streaming ply reader, and in the
+    // vector returned by the other loaders
+    std::pair<std::vector<glm::vec3>, std::vector<int>> loaded_file;
+    glm::vec3 *ps = nullptr;
+    size_t vertex_count = 0;
+    // position indices, which is equivalent to vertex indices in this case
+    std::vector<int> indices;
+    if (file_extension == ".obj") {
+        loaded_file = load_obj_file(file_path);
+    } else if (file_extension == ".ply") {
+        // ply goes straight from the mapped file into the arena, with miniply
+        // as a fallback for files the streaming reader rejects
+        PlyFile ply{file_path};
+        if (ply.valid()) {
+            vertex_count = ply.vertex_count();
+            ps = scratch.alloc<glm::vec3>(vertex_count);
+            indices.resize(ply.triangle_count() * 3);
+            if (!ply.read_positions(ps, sizeof(glm::vec3)) ||
+                !ply.read_triangles(indices.data())) {
+                return false;
+            }
+        } else {
+            loaded_file = load_ply_file(file_path);
+        }
+    } else if (is_generated(file_path)) {
+        loaded_file = generate_mesh(file_path);
+    } else {
+        return false;
+    }
+    if (!ps) {
+        vertex_count = loaded_file.first.size();
+        ps = loaded_file.first.data();
+        indices = std::move(loaded_file.second);
+    }
+    if (vertex_count == 0) {
+        return false;
+    }
+    tally.add(vertex_count * sizeof(glm::vec3));
+    tally.add(indices.size() * sizeof(int));
+
+    // we find the bounding box for the mesh, in order to resize and center the
+    // mesh
+    const MeshBounds bounds = mesh_bounds(ps, vertex_count);
+    recenter_positions(ps, vertex_count, bounds, y_up, x_front);
+    // calculate vertex normal
+    glm::vec3 *vns = scratch.alloc<glm::vec3>(vertex_count);
+    tally.add(vertex_count * sizeof(glm::vec3));
+    size_t welded_count = 0;
+    if (weld.enabled) {
+        // hard edges are told apart by the normals of the split vertices,
+        // the positions are unit sized so the tolerance applies as is
+        const bool hard_edges = weld.hard_angle < 180.f;
+        if (hard_edges) {
+            vertex_normals(ps, vertex_count, indices.data(), indices.size(),
+                           vns);
         }
-    } else if (abstracted_shape == 3) { // sphere
-        for (int i = 0; i < ps.size(); ++i) {
-            ans[i] = glm::normalize(ps[i]);
+        const size_t used = scratch.used();
+        const size_t welded =
+            weld_vertices(ps, hard_edges ? vns : nullptr, vertex_count,
+                          indices, weld.tolerance, weld.hard_angle);
+        tally.add(scratch.used() - used);
+        welded_count = vertex_count - welded;
+        vertex_count = welded;
+    }
+    vertex_normals(ps, vertex_count, indices.data(), indices.size(), vns);
+
+    // calculate abstracted normal of the smooth shape
+    if (smooth) {
+        glm::vec3 *ans = scratch.alloc<glm::vec3>(vertex_count);
+        glm::vec3 *tns = scratch.alloc<glm::vec3>(vertex_count);
+        tally.add(2 * vertex_count * sizeof(glm::vec3));
+        smooth_normals(vns, vertex_count, indices.data(), indices.size(), ans,
+                       tns);
+        output.abstracted_normals(ans, vertex_count);
+    }
+
+    // assembling into the output, which is written once and never read
+    Vertex *vertices = output.vertices(vertex_count, tally);
+    if (!vertices) {
+        return false;
+    }
+    assemble_vertices(ps, vns, vertex_count, vertices);
+
+    if (stats) {
+        stats->vertex_count = vertex_count;
+        stats->triangle_count = indices.size() / 3;
+        stats->welded_count = welded_count;
+        stats->peak_bytes = tally.peak();
+        stats->mesh_bytes = vertex_count * sizeof(Vertex) +
+                            (smooth ? vertex_count * sizeof(glm::vec3) : 0) +
+                            indices.size() * sizeof(int);
+        stats->peak_rss_bytes = peak_rss_bytes();
+        stats->load_ms = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+    }
+    output.finish(std::move(indices), bounds.dimension() / bounds.diagonal());
+    return true;
+}
+
+// load_mesh_into output for a mesh in cpu memory
+class MeshOutput {
+  public:
+    MeshOutput(Mesh &mesh) : _mesh{mesh} {}
+
+    inline Vertex *vertices(const size_t count, MemoryTally &tally) {
+        _mesh.vertices.resize(count);
+        tally.add(count * sizeof(Vertex));
+        return _mesh.vertices.data();
+    }
+    inline void abstracted_normals(const glm::vec3 *normals,
+                                   const size_t count) {
+        _mesh.abstracted_normals.assign(normals, normals + count);
+    }
+    inline void finish(std::vector<int> &&indices,
+                       const glm::vec3 &bb_dimension) {
+        _mesh.indices = std::move(indices);
+        _mesh.bb_dimension = bb_dimension;
+    }
+
+  private:
+    Mesh &_mesh;
+};
+
+// load_mesh_into output straight into gpu buffers. the vertices are written
+// through a mapping of the vertex buffer so no cpu copy of them is made, the
+// smooth normals are uploaded from the scratch arena
+class BufferOutput {
+  public:
+    BufferOutput(const Buffer &vertex_buffer, const Buffer &abstracted_buffer,
+                 const Buffer &index_buffer)
+        : _vertex_buffer{vertex_buffer}, _abstracted_buffer{abstracted_buffer},
+          _index_buffer{index_buffer} {}
+
+    inline Vertex *vertices(const size_t count, MemoryTally &tally) {
+        _vertex_count = count;
+        const GLsizeiptr size = GLsizeiptr(count * sizeof(Vertex));
+        _vertex_buffer.bind();
+        // orphan the old storage, so the map does not wait for draws still
+        // reading it
+        _vertex_buffer.data(size, nullptr, GL_STATIC_DRAW);
+        void *p = glMapBufferRange(
+            _vertex_buffer.target(), 0, size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (p) {
+            _mapped = true;
+            return static_cast<Vertex *>(p);
         }
+        // used when the buffer cannot be mapped
+        _fallback.resize(count);
+        tally.add(size_t(size));
+        return _fallback.data();
     }
-    // assembling into mesh
-    for (int i = 0; i < ps.size(); ++i) {
-        vertices[i] = {ps[i] / bb_diag_size, vns[i], ans[i]};
+    inline void abstracted_normals(const glm::vec3 *normals,
+                                   const size_t count) {
+        _abstracted_buffer.bind();
+        _abstracted_buffer.data(GLsizeiptr(count * sizeof(glm::vec3)), normals,
+                                GL_STATIC_DRAW);
+        _abstracted = true;
+    }
+    inline void finish(std::vector<int> &&indices,
+                       const glm::vec3 &bb_dimension) {
+        _vertex_buffer.bind();
+        if (_mapped && glUnmapBuffer(_vertex_buffer.target()) == GL_FALSE) {
+            // the contents were lost while mapped, nothing to draw this time
+            indices.clear();
+        } else if (!_fallback.empty()) {
+            glBufferSubData(_vertex_buffer.target(), 0,
+                            GLsizeiptr(_fallback.size() * sizeof(Vertex)),
+                            _fallback.data());
+            _fallback = {};
+        }
+        if (!_abstracted) {
+            // release the smooth normals of a previous mesh
+            _abstracted_buffer.bind();
+            _abstracted_buffer.data(0, nullptr, GL_STATIC_DRAW);
+        }
+        _index_buffer.bind();
+        _index_buffer.data(GLsizeiptr(indices.size() * sizeof(int)),
+                           indices.data(), GL_STATIC_DRAW);
+        _index_count = indices.size();
+        _bb_dimension = bb_dimension;
+    }
+
+    inline bool mapped() const { return _mapped; }
+    inline bool has_abstracted_normals() const { return _abstracted; }
+    inline size_t vertex_count() const { return _vertex_count; }
+    inline size_t index_count() const { return _index_count; }
+    inline const glm::vec3 &bb_dimension() const { return _bb_dimension; }
+
+  private:
+    const Buffer &_vertex_buffer, &_abstracted_buffer, &_index_buffer;
+    std::vector<Vertex> _fallback;
+    bool _mapped = false, _abstracted = false;
+    size_t _vertex_count = 0, _index_count = 0;
+    glm::vec3 _bb_dimension{1.f};
+};
+
+// create a mesh in cpu memory, see load_mesh_into
+inline Mesh load_mesh(const std::filesystem::path &file_path,
+                      const bool smooth, const bool y_up, const bool x_front,
+                      MeshLoadStats *stats = nullptr,
+                      const WeldOptions &weld = {}) {
+    Mesh mesh;
+    MeshOutput output{mesh};
+    load_mesh_into(file_path, smooth, y_up, x_front, output, stats, weld);
+    if (stats) {
+        stats->mapped = false;
     }
-    return {vertices, indices};
+    return mesh;
 }
 } // namespace xtr
@@ -0,0 +1,49 @@
+// minimal fork-join helpers over std::thread, used by the loaders and the
+// cpu side preprocessing
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace xtr {
+// number of worker threads to split work across
+inline size_t thread_count() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// split [0, count) into at most chunks contiguous ranges and call
+// f(chunk, begin, end) for each of them in parallel, the calling thread takes
+// the first range. a single range runs inline
+template <class F>
+inline void parallel_chunks(const size_t count, const size_t chunks, F &&f) {
+    if (count == 0) {
+        return;
+    }
+    const size_t n = std::max<size_t>(1, std::min(chunks, count));
+    if (n == 1) {
+        f(size_t(0), size_t(0), count);
+        return;
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(n - 1);
+    for (size_t c = 1; c < n; ++c) {
+        threads.emplace_back(
+            [&f, c, n, count]() { f(c, count * c / n, count * (c + 1) / n); });
+    }
+    f(size_t(0), size_t(0), count / n);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+// call f(begin, end) over [0, count) split across all threads, ranges smaller
+// than min_chunk are not worth a thread
+template <class F>
+inline void parallel_for(const size_t count, F &&f,
+                         const size_t min_chunk = 4096) {
+    const size_t chunks = std::min(thread_count(), count / min_chunk + 1);
+    parallel_chunks(count, chunks,
+                    [&f](size_t, size_t begin, size_t end) { f(begin, end); });
+}
+} // namespace xtr
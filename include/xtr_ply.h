@@ -0,0 +1,757 @@
+// streaming ply reader
+// the file is memory-mapped and decoded in place, without loading whole
+// elements first. binary rows are decoded and ascii rows are parsed in
+// parallel chunks, positions and normals are written with a caller-given
+// stride so they can land directly in an interleaved vertex layout or a
+// mapped buffer, and faces are triangulated in parallel straight into the
+// index array
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <xtr_parallel.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace xtr {
+// read-only mapping of a whole file, the file is read into memory instead
+// when it cannot be mapped
+class MappedFile {
+  public:
+    MappedFile(const std::filesystem::path &file_path) {
+#ifdef _WIN32
+        _file = CreateFileW(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+        LARGE_INTEGER size;
+        if (_file != INVALID_HANDLE_VALUE && GetFileSizeEx(_file, &size) &&
+            size.QuadPart > 0) {
+            _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0,
+                                          nullptr);
+            if (_mapping) {
+                _data = (const char *)MapViewOfFile(_mapping, FILE_MAP_READ, 0,
+                                                    0, 0);
+                _size = size_t(size.QuadPart);
+            }
+        }
+#else
+        const int fd = open(file_path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *mapped = mmap(nullptr, size_t(st.st_size), PROT_READ,
+                                MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                _data = (const char *)mapped;
+                _size = size_t(st.st_size);
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+        if (!_data) {
+            std::ifstream ifs(file_path, std::ios::binary);
+            _fallback.assign(std::istreambuf_iterator<char>(ifs), {});
+            _size = _fallback.size();
+        }
+    }
+    MappedFile(MappedFile &&) = delete;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(MappedFile &&) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() {
+#ifdef _WIN32
+        if (_data) {
+            UnmapViewOfFile(_data);
+        }
+        if (_mapping) {
+            CloseHandle(_mapping);
+        }
+        if (_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(_file);
+        }
+#else
+        if (_data) {
+            munmap((void *)_data, _size);
+        }
+#endif
+    }
+
+    inline const char *data() const {
+        return _data ? _data : _fallback.data();
+    }
+    inline size_t size() const { return _size; }
+
+  private:
+    const char *_data = nullptr;
+    size_t _size = 0;
+    std::vector<char> _fallback;
+#ifdef _WIN32
+    HANDLE _file = INVALID_HANDLE_VALUE;
+    HANDLE _mapping = nullptr;
+#endif
+};
+
+class PlyFile {
+  public:
+    PlyFile(const std::filesystem::path &file_path) : _file{file_path} {
+        _valid = parse_header() && locate_elements();
+    }
+
+    // false if the file is not a ply this reader understands
+    inline bool valid() const { return _valid; }
+    inline size_t vertex_count() const {
+        return _vertex ? _vertex->count : 0;
+    }
+    // number of triangles after triangulating every face
+    inline size_t triangle_count() const { return _triangle_count; }
+
+    // write the x, y, z of every vertex as floats at dst + i * stride
+    inline bool read_positions(void *dst, const size_t stride) const {
+        return _valid && read_vertex_triple(_position, dst, stride);
+    }
+
+    // whether the vertices have normals, nx, ny and nz
+    inline bool has_normals() const { return _normal[0] >= 0; }
+    // write the normal of every vertex as floats at dst + i * stride
+    inline bool read_normals(void *dst, const size_t stride) const {
+        return _valid && has_normals() &&
+               read_vertex_triple(_normal, dst, stride);
+    }
+
+    // write triangle_count() * 3 vertex indices into dst, larger polygons are
+    // fan-triangulated. an index outside the vertices makes the file invalid
+    inline bool read_triangles(int *dst) {
+        if (!_valid) {
+            return false;
+        } else if (!_face) {
+            return true;
+        }
+        if (_format == Format::Ascii) {
+            parallel_chunks(_chunks.size(), _chunks.size(),
+                            [&](size_t c, size_t, size_t) {
+                                ascii_faces(_chunks[c], dst);
+                            });
+        } else {
+            parallel_chunks(_checkpoints.size(), _checkpoints.size(),
+                            [&](size_t c, size_t, size_t) {
+                                binary_faces(_checkpoints[c], dst);
+                            });
+        }
+        std::atomic<bool> in_range{true};
+        parallel_for(_triangle_count * 3, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (dst[i] < 0 || size_t(dst[i]) >= vertex_count()) {
+                    in_range = false;
+                    return;
+                }
+            }
+        });
+        _valid = in_range;
+        return _valid;
+    }
+
+  private:
+    enum class Format { Ascii, BinaryLittleEndian, BinaryBigEndian };
+    enum class Type {
+        Invalid,
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Float32,
+        Float64
+    };
+    struct Property {
+        std::string name;
+        Type type;
+        // type of the item count, Invalid if the property is not a list
+        Type count_type = Type::Invalid;
+    };
+    struct Element {
+        std::string name;
+        size_t count;
+        std::vector<Property> properties;
+        // byte size of a row, 0 if the rows contain lists
+        size_t row_size = 0;
+        // first byte in binary files, first line of the body in ascii files
+        size_t offset = 0;
+    };
+    // where a parallel chunk of binary faces starts
+    struct Checkpoint {
+        size_t row, end_row, offset, first_triangle;
+    };
+    // a parallel chunk of ascii lines
+    struct Chunk {
+        size_t begin, end, first_line, first_triangle;
+    };
+
+    static inline Type parse_type(const std::string_view name) {
+        if (name == "char" || name == "int8") {
+            return Type::Int8;
+        } else if (name == "uchar" || name == "uint8") {
+            return Type::UInt8;
+        } else if (name == "short" || name == "int16") {
+            return Type::Int16;
+        } else if (name == "ushort" || name == "uint16") {
+            return Type::UInt16;
+        } else if (name == "int" || name == "int32") {
+            return Type::Int32;
+        } else if (name == "uint" || name == "uint32") {
+            return Type::UInt32;
+        } else if (name == "float" || name == "float32") {
+            return Type::Float32;
+        } else if (name == "double" || name == "float64") {
+            return Type::Float64;
+        }
+        return Type::Invalid;
+    }
+
+    static inline size_t type_size(const Type type) {
+        switch (type) {
+        case Type::Int8:
+        case Type::UInt8:
+            return 1;
+        case Type::Int16:
+        case Type::UInt16:
+            return 2;
+        case Type::Int32:
+        case Type::UInt32:
+        case Type::Float32:
+            return 4;
+        case Type::Float64:
+            return 8;
+        default:
+            return 0;
+        }
+    }
+
+    // decode one binary value, swapping bytes for big endian files
+    inline double decode(const char *p, const Type type) const {
+        unsigned char bytes[8];
+        const size_t size = type_size(type);
+        memcpy(bytes, p, size);
+        if (_format == Format::BinaryBigEndian) {
+            for (size_t i = 0; i < size / 2; ++i) {
+                std::swap(bytes[i], bytes[size - 1 - i]);
+            }
+        }
+        switch (type) {
+        case Type::Int8:
+            return double(*(const int8_t *)bytes);
+        case Type::UInt8:
+            return double(*(const uint8_t *)bytes);
+        case Type::Int16: {
+            int16_t v;
+            memcpy(&v, bytes, 2);
+            return double(v);
+        }
+        case Type::UInt16: {
+            uint16_t v;
+            memcpy(&v, bytes, 2);
+            return double(v);
+        }
+        case Type::Int32: {
+            int32_t v;
+            memcpy(&v, bytes, 4);
+            return double(v);
+        }
+        case Type::UInt32: {
+            uint32_t v;
+            memcpy(&v, bytes, 4);
+            return double(v);
+        }
+        case Type::Float32: {
+            float v;
+            memcpy(&v, bytes, 4);
+            return double(v);
+        }
+        case Type::Float64: {
+            double v;
+            memcpy(&v, bytes, 8);
+            return v;
+        }
+        default:
+            return 0.;
+        }
+    }
+
+    inline bool parse_header() {
+        const std::string_view text{_file.data(), _file.size()};
+        size_t pos = 0;
+        bool has_magic = false, has_format = false;
+        while (pos < text.size()) {
+            size_t eol = text.find('\n', pos);
+            if (eol == std::string_view::npos) {
+                return false;
+            }
+            std::string_view line = text.substr(pos, eol - pos);
+            pos = eol + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            std::vector<std::string_view> words;
+            for (size_t w = 0; w < line.size();) {
+                const size_t e = std::min(line.find(' ', w), line.size());
+                if (e > w) {
+                    words.push_back(line.substr(w, e - w));
+                }
+                w = e + 1;
+            }
+            if (words.empty()) {
+                continue;
+            }
+            if (!has_magic) {
+                if (words[0] != "ply") {
+                    return false;
+                }
+                has_magic = true;
+            } else if (words[0] == "format" && words.size() >= 2) {
+                if (words[1] == "ascii") {
+                    _format = Format::Ascii;
+                } else if (words[1] == "binary_little_endian") {
+                    _format = Format::BinaryLittleEndian;
+                } else if (words[1] == "binary_big_endian") {
+                    _format = Format::BinaryBigEndian;
+                } else {
+                    return false;
+                }
+                has_format = true;
+            } else if (words[0] == "element" && words.size() >= 3) {
+                Element element{std::string{words[1]}, 0, {}};
+                std::from_chars(words[2].data(),
+                                words[2].data() + words[2].size(),
+                                element.count);
+                _elements.push_back(std::move(element));
+            } else if (words[0] == "property" && !_elements.empty()) {
+                Property property;
+                if (words.size() >= 5 && words[1] == "list") {
+                    property = {std::string{words[4]}, parse_type(words[3]),
+                                parse_type(words[2])};
+                    if (property.count_type == Type::Invalid) {
+                        return false;
+                    }
+                } else if (words.size() >= 3) {
+                    property = {std::string{words[2]}, parse_type(words[1])};
+                } else {
+                    return false;
+                }
+                if (property.type == Type::Invalid) {
+                    return false;
+                }
+                _elements.back().properties.push_back(std::move(property));
+            } else if (words[0] == "end_header") {
+                _body = pos;
+                return has_format;
+            }
+        }
+        return false;
+    }
+
+    inline bool locate_elements() {
+        for (auto &element : _elements) {
+            bool fixed = true;
+            for (const auto &property : element.properties) {
+                fixed &= property.count_type == Type::Invalid;
+                element.row_size += type_size(property.type);
+            }
+            if (!fixed) {
+                element.row_size = 0;
+            }
+            if (element.name == "vertex") {
+                _vertex = &element;
+            } else if (element.name == "face") {
+                _face = &element;
+            }
+        }
+        if (!_vertex) {
+            return false;
+        }
+        const char *names[] = {"x", "y", "z"};
+        for (int a = 0; a < 3; ++a) {
+            _position[a] = find_property(*_vertex, names[a]);
+            if (_position[a] < 0) {
+                return false;
+            }
+        }
+        const char *normal_names[] = {"nx", "ny", "nz"};
+        int normal[3];
+        for (int a = 0; a < 3; ++a) {
+            normal[a] = find_property(*_vertex, normal_names[a]);
+        }
+        if (normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0) {
+            std::copy_n(normal, 3, _normal);
+        }
+        if (_face) {
+            _face_list = find_property(*_face, "vertex_indices");
+            if (_face_list < 0) {
+                _face_list = find_property(*_face, "vertex_index");
+            }
+            if (_face_list < 0 ||
+                _face->properties[_face_list].count_type == Type::Invalid) {
+                _face = nullptr;
+            }
+        }
+        return _format == Format::Ascii ? index_ascii() : index_binary();
+    }
+
+    static inline int find_property(const Element &element,
+                                    const std::string_view name) {
+        for (size_t i = 0; i < element.properties.size(); ++i) {
+            if (element.properties[i].name == name) {
+                return int(i);
+            }
+        }
+        return -1;
+    }
+
+    // bytes in a vertex row before the property at index
+    inline size_t property_offset(const int index) const {
+        size_t offset = 0;
+        for (int p = 0; p < index; ++p) {
+            offset += type_size(_vertex->properties[p].type);
+        }
+        return offset;
+    }
+
+    // write three properties of every vertex as floats at dst + i * stride
+    inline bool read_vertex_triple(const int (&properties)[3], void *dst,
+                                   const size_t stride) const {
+        char *out = (char *)dst;
+        auto write = [&](const size_t i, const double x, const double y,
+                         const double z) {
+            float *p = (float *)(out + i * stride);
+            p[0] = float(x);
+            p[1] = float(y);
+            p[2] = float(z);
+        };
+        if (_format == Format::Ascii) {
+            parallel_chunks(_chunks.size(), _chunks.size(),
+                            [&](size_t c, size_t, size_t) {
+                                ascii_vertices(_chunks[c], properties, write);
+                            });
+            return true;
+        }
+        const size_t row_size = _vertex->row_size;
+        const char *base = _file.data() + _vertex->offset;
+        const size_t ox = property_offset(properties[0]),
+                     oy = property_offset(properties[1]),
+                     oz = property_offset(properties[2]);
+        const Type tx = _vertex->properties[properties[0]].type,
+                   ty = _vertex->properties[properties[1]].type,
+                   tz = _vertex->properties[properties[2]].type;
+        parallel_for(_vertex->count, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const char *row = base + i * row_size;
+                write(i, decode(row + ox, tx), decode(row + oy, ty),
+                      decode(row + oz, tz));
+            }
+        });
+        return true;
+    }
+
+    // byte offsets of every element, and of the parallel face chunks. rows
+    // with lists have no fixed size, so walking over them is sequential, but
+    // it only touches the list counts
+    inline bool index_binary() {
+        if (_vertex->row_size == 0) {
+            return false;
+        }
+        const size_t chunk_rows =
+            _face ? std::max<size_t>(1024, _face->count / (thread_count() * 4))
+                  : 1;
+        size_t offset = _body;
+        for (auto &element : _elements) {
+            element.offset = offset;
+            if (element.row_size > 0) {
+                offset += element.row_size * element.count;
+            } else {
+                const bool is_face = &element == _face;
+                for (size_t row = 0; row < element.count; ++row) {
+                    if (is_face && row % chunk_rows == 0) {
+                        _checkpoints.push_back(
+                            {row, std::min(row + chunk_rows, element.count),
+                             offset, _triangle_count});
+                    }
+                    for (int p = 0; p < int(element.properties.size()); ++p) {
+                        const Property &property = element.properties[p];
+                        if (property.count_type == Type::Invalid) {
+                            offset += type_size(property.type);
+                            continue;
+                        }
+                        if (offset + type_size(property.count_type) >
+                            _file.size()) {
+                            return false;
+                        }
+                        const size_t n =
+                            size_t(decode(_file.data() + offset,
+                                          property.count_type));
+                        offset += type_size(property.count_type) +
+                                  n * type_size(property.type);
+                        if (is_face && p == _face_list && n >= 3) {
+                            _triangle_count += n - 2;
+                        }
+                    }
+                }
+            }
+            if (offset > _file.size()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // quads are split along the 1-3 diagonal like miniply does, so that
+    // normals come out the same whichever reader loaded the file
+    static inline int *write_quad(int *out, const int a, const int b,
+                                  const int c, const int d) {
+        out[0] = a;
+        out[1] = b;
+        out[2] = d;
+        out[3] = c;
+        out[4] = d;
+        out[5] = b;
+        return out + 6;
+    }
+
+    inline void binary_faces(const Checkpoint &checkpoint, int *dst) const {
+        const char *data = _file.data();
+        size_t offset = checkpoint.offset;
+        int *out = dst + checkpoint.first_triangle * 3;
+        for (size_t row = checkpoint.row; row < checkpoint.end_row; ++row) {
+            for (int p = 0; p < int(_face->properties.size()); ++p) {
+                const Property &property = _face->properties[p];
+                if (property.count_type == Type::Invalid) {
+                    offset += type_size(property.type);
+                    continue;
+                }
+                const size_t n =
+                    size_t(decode(data + offset, property.count_type));
+                offset += type_size(property.count_type);
+                const size_t item = type_size(property.type);
+                if (p == _face_list && n >= 3) {
+                    auto index = [&](const size_t k) {
+                        return int(decode(data + offset + k * item,
+                                          property.type));
+                    };
+                    if (n == 4) {
+                        out = write_quad(out, index(0), index(1), index(2),
+                                         index(3));
+                    } else {
+                        const int first = index(0);
+                        int previous = index(1);
+                        for (size_t k = 2; k < n; ++k) {
+                            const int next = index(k);
+                            *out++ = first;
+                            *out++ = previous;
+                            *out++ = next;
+                            previous = next;
+                        }
+                    }
+                }
+                offset += n * item;
+            }
+        }
+    }
+
+    // split the ascii body into per-thread chunks on line boundaries, count
+    // the lines of each chunk in parallel, then the triangles of the faces
+    inline bool index_ascii() {
+        const char *data = _file.data();
+        const size_t size = _file.size();
+        const size_t chunk_count =
+            std::min(thread_count() * 4, (size - _body) / 65536 + 1);
+        std::vector<size_t> bounds{_body};
+        for (size_t c = 1; c < chunk_count; ++c) {
+            size_t b = _body + (size - _body) * c / chunk_count;
+            const void *eol = memchr(data + b, '\n', size - b);
+            b = eol ? size_t((const char *)eol - data) + 1 : size;
+            if (b > bounds.back()) {
+                bounds.push_back(b);
+            }
+        }
+        bounds.push_back(size);
+        _chunks.resize(bounds.size() - 1);
+        for (size_t c = 0; c + 1 < bounds.size(); ++c) {
+            _chunks[c] = {bounds[c], bounds[c + 1], 0, 0};
+        }
+
+        std::vector<size_t> lines(_chunks.size());
+        parallel_chunks(_chunks.size(), _chunks.size(),
+                        [&](size_t c, size_t, size_t) {
+                            lines[c] = std::count(data + _chunks[c].begin,
+                                                  data + _chunks[c].end, '\n');
+                        });
+        for (size_t c = 1; c < _chunks.size(); ++c) {
+            _chunks[c].first_line = _chunks[c - 1].first_line + lines[c - 1];
+        }
+
+        size_t line = 0;
+        for (auto &element : _elements) {
+            element.offset = line;
+            line += element.count;
+        }
+
+        if (_face) {
+            std::vector<size_t> triangles(_chunks.size());
+            parallel_chunks(_chunks.size(), _chunks.size(),
+                            [&](size_t c, size_t, size_t) {
+                                triangles[c] = ascii_faces(_chunks[c], nullptr);
+                            });
+            for (size_t c = 0; c < _chunks.size(); ++c) {
+                _chunks[c].first_triangle = _triangle_count;
+                _triangle_count += triangles[c];
+            }
+        }
+        return true;
+    }
+
+    // parse the next number of a line, false at the end of the line
+    template <class T>
+    static inline bool next_number(const char *&p, const char *end, T &value) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            ++p;
+        }
+        if (p >= end || *p == '\n') {
+            return false;
+        }
+        if (*p == '+') {
+            ++p;
+        }
+        const auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc{}) {
+            return false;
+        }
+        p = result.ptr;
+        return true;
+    }
+
+    template <class F>
+    inline void ascii_vertices(const Chunk &chunk, const int (&properties)[3],
+                               F &&write) const {
+        const char *p = _file.data() + chunk.begin;
+        const char *end = _file.data() + chunk.end;
+        const size_t first = _vertex->offset, last = first + _vertex->count;
+        double values[3] = {};
+        for (size_t line = chunk.first_line; p < end && line < last; ++line) {
+            if (line >= first) {
+                const char *q = p;
+                for (int i = 0; i < int(_vertex->properties.size()); ++i) {
+                    double value = 0.;
+                    size_t n = 0;
+                    if (_vertex->properties[i].count_type != Type::Invalid) {
+                        next_number(q, end, n);
+                        for (size_t k = 0; k < n; ++k) {
+                            next_number(q, end, value);
+                        }
+                        continue;
+                    }
+                    next_number(q, end, value);
+                    for (int a = 0; a < 3; ++a) {
+                        if (properties[a] == i) {
+                            values[a] = value;
+                        }
+                    }
+                }
+                write(line - first, values[0], values[1], values[2]);
+            }
+            const void *eol = memchr(p, '\n', size_t(end - p));
+            p = eol ? (const char *)eol + 1 : end;
+        }
+    }
+
+    // triangulate the faces of a chunk into dst, or only count the triangles
+    // when dst is nullptr
+    inline size_t ascii_faces(const Chunk &chunk, int *dst) const {
+        const char *p = _file.data() + chunk.begin;
+        const char *end = _file.data() + chunk.end;
+        const size_t first = _face->offset, last = first + _face->count;
+        int *out = dst ? dst + chunk.first_triangle * 3 : nullptr;
+        size_t triangles = 0;
+        for (size_t line = chunk.first_line; p < end && line < last; ++line) {
+            if (line >= first) {
+                const char *q = p;
+                for (int i = 0; i < int(_face->properties.size()); ++i) {
+                    double value = 0.;
+                    if (_face->properties[i].count_type == Type::Invalid) {
+                        next_number(q, end, value);
+                        continue;
+                    }
+                    size_t n = 0;
+                    next_number(q, end, n);
+                    if (i != _face_list) {
+                        for (size_t k = 0; k < n; ++k) {
+                            next_number(q, end, value);
+                        }
+                        continue;
+                    }
+                    if (n >= 3) {
+                        triangles += n - 2;
+                    }
+                    if (!out) {
+                        break;
+                    }
+                    if (n == 4) {
+                        int quad[4] = {};
+                        for (int &index : quad) {
+                            next_number(q, end, index);
+                        }
+                        out = write_quad(out, quad[0], quad[1], quad[2],
+                                         quad[3]);
+                        continue;
+                    }
+                    int first_index = 0, previous = 0, next = 0;
+                    next_number(q, end, first_index);
+                    next_number(q, end, previous);
+                    for (size_t k = 2; k < n; ++k) {
+                        next_number(q, end, next);
+                        *out++ = first_index;
+                        *out++ = previous;
+                        *out++ = next;
+                        previous = next;
+                    }
+                }
+            }
+            const void *eol = memchr(p, '\n', size_t(end - p));
+            p = eol ? (const char *)eol + 1 : end;
+        }
+        return triangles;
+    }
+
+    MappedFile _file;
+    bool _valid = false;
+    Format _format = Format::Ascii;
+    size_t _body = 0;
+    std::vector<Element> _elements;
+    const Element *_vertex = nullptr;
+    const Element *_face = nullptr;
+    int _position[3] = {-1, -1, -1};
+    // all -1 when the vertices have no normals
+    int _normal[3] = {-1, -1, -1};
+    int _face_list = -1;
+    size_t _triangle_count = 0;
+    std::vector<Checkpoint> _checkpoints;
+    std::vector<Chunk> _chunks;
+};
+} // namespace xtr
@@ -0,0 +1,451 @@
+// point cloud splatting
+// a ply with vertices but no faces is a point cloud. its points are drawn by
+// the mesh pass as round splats into the same position, normal and id
+// buffers as a mesh, so the xtoon shading and the screen space outlines work
+// on them unchanged. missing normals are estimated from the nearest
+// neighbours of every point. the points are shuffled once at load, so any
+// prefix of them is an even subsample and the level of detail is only a
+// shorter draw with larger splats
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <miniply.h>
+#include <xtr_buffer.h>
+#include <xtr_memory.h>
+#include <xtr_mesh.h>
+#include <xtr_obj.h>
+#include <xtr_parallel.h>
+#include <xtr_ply.h>
+#include <xtr_trace.h>
+
+namespace xtr {
+// points of a cloud in a random order, centered and scaled like a mesh
+struct PointCloud {
+    std::vector<Vertex> points;
+    // bounding box dimensions relative to its diagonal, for the analytic
+    // shapes
+    glm::vec3 bb_dimension{1.f};
+    // mean distance of a point to its nearest neighbour
+    float spacing = 0.f;
+    // whether the normals were estimated, the file had none
+    bool estimated_normals = false;
+};
+
+// whether file_path is a ply with vertices and no faces, from the header
+inline bool is_point_cloud(const std::filesystem::path &file_path) {
+    if (file_path.extension() != ".ply") {
+        return false;
+    }
+    miniply::PLYReader r(file_path.c_str());
+    if (!r.valid()) {
+        return false;
+    }
+    const uint32_t vertex = r.find_element(miniply::kPLYVertexElement);
+    const uint32_t face = r.find_element(miniply::kPLYFaceElement);
+    return vertex != miniply::kInvalidIndex &&
+           r.get_element(vertex)->count > 0 &&
+           (face == miniply::kInvalidIndex || r.get_element(face)->count == 0);
+}
+
+// points bucketed by their grid cell and counting sorted into a copy, so
+// the points of a cell are next to each other in memory. the buckets of
+// cells next to each other along x are next to each other as well. the
+// cells are kept along, so that telling apart the cells of a bucket takes
+// no rounding. arrays live in the scratch arena
+class PointGrid {
+  public:
+    PointGrid(const glm::vec3 *ps, const size_t count, const float cell_size)
+        : _count{count}, _cell_size{cell_size} {
+        ScratchArena &scratch = scratch_arena();
+        size_t table_size = 64;
+        while (table_size < count) {
+            table_size *= 2;
+        }
+        _mask = table_size - 1;
+        uint32_t *buckets = scratch.alloc<uint32_t>(count);
+        glm::ivec3 *cells = scratch.alloc<glm::ivec3>(count);
+        _starts = scratch.alloc<uint32_t>(table_size + 1, 0u);
+        _order = scratch.alloc<uint32_t>(count);
+        _points = scratch.alloc<glm::vec3>(count);
+        _cells = scratch.alloc<glm::ivec3>(count);
+        parallel_for(count, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                cells[i] = cell(ps[i]);
+                buckets[i] = bucket(cells[i]);
+            }
+        });
+        for (size_t i = 0; i < count; ++i) {
+            ++_starts[buckets[i]];
+        }
+        for (size_t b = 1; b <= table_size; ++b) {
+            _starts[b] += _starts[b - 1];
+        }
+        // scatter with the ends of the buckets, which become their starts
+        for (size_t i = count; i-- > 0;) {
+            _order[--_starts[buckets[i]]] = uint32_t(i);
+        }
+        parallel_for(count, [&](const size_t begin, const size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                _points[k] = ps[_order[k]];
+                _cells[k] = cells[_order[k]];
+            }
+        });
+    }
+
+    // the points in grid order, and their index in the original order
+    inline size_t size() const { return _count; }
+    inline const glm::vec3 &point(const size_t k) const { return _points[k]; }
+    inline uint32_t index(const size_t k) const { return _order[k]; }
+
+    // f(q) for every point q in the 27 cells around p
+    template <class F> inline void near(const glm::vec3 &p, F &&f) const {
+        const glm::ivec3 c = cell(p);
+        for (int z = -1; z <= 1; ++z) {
+            for (int y = -1; y <= 1; ++y) {
+                for (int x = -1; x <= 1; ++x) {
+                    const glm::ivec3 n = c + glm::ivec3{x, y, z};
+                    const uint32_t b = bucket(n);
+                    for (uint32_t k = _starts[b]; k < _starts[b + 1]; ++k) {
+                        // other cells can share the bucket
+                        if (_cells[k] == n) {
+                            f(_points[k]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+  private:
+    inline glm::ivec3 cell(const glm::vec3 &p) const {
+        return glm::ivec3{glm::floor(p / _cell_size)};
+    }
+
+    inline uint32_t bucket(const glm::ivec3 &c) const {
+        return uint32_t((uint64_t(uint32_t(c.x)) +
+                         uint64_t(uint32_t(c.y)) * 73856093ull +
+                         uint64_t(uint32_t(c.z)) * 19349663ull) &
+                        _mask);
+    }
+
+    size_t _count;
+    float _cell_size;
+    uint64_t _mask;
+    uint32_t *_starts;
+    uint32_t *_order;
+    glm::vec3 *_points;
+    glm::ivec3 *_cells;
+};
+
+// unit eigenvector of the smallest eigenvalue of the symmetric matrix with
+// the upper triangle xx, xy, xz, yy, yz, zz, or a zero vector when there is
+// no single one
+inline glm::vec3 smallest_eigenvector(const double (&m)[6]) {
+    const double p1 = m[1] * m[1] + m[2] * m[2] + m[4] * m[4];
+    const double q = (m[0] + m[3] + m[5]) / 3.;
+    const double p2 = (m[0] - q) * (m[0] - q) + (m[3] - q) * (m[3] - q) +
+                      (m[5] - q) * (m[5] - q) + 2. * p1;
+    if (p2 <= 0.) {
+        return glm::vec3{0.f};
+    }
+    // closed form of the eigenvalues of a symmetric 3x3 matrix
+    const double p = std::sqrt(p2 / 6.);
+    const double b0 = (m[0] - q) / p, b3 = (m[3] - q) / p, b5 = (m[5] - q) / p,
+                 b1 = m[1] / p, b2 = m[2] / p, b4 = m[4] / p;
+    const double r = std::clamp((b0 * (b3 * b5 - b4 * b4) -
+                                 b1 * (b1 * b5 - b4 * b2) +
+                                 b2 * (b1 * b4 - b3 * b2)) /
+                                    2.,
+                                -1., 1.);
+    const double third_turn = 2.0943951023931957;
+    const double lowest = q + 2. * p * std::cos(std::acos(r) / 3. + third_turn);
+    // the eigenvector is orthogonal to the rows of m - lowest, the cross
+    // product of the two rows furthest from parallel is the most accurate
+    const glm::dvec3 rows[3] = {{m[0] - lowest, m[1], m[2]},
+                                {m[1], m[3] - lowest, m[4]},
+                                {m[2], m[4], m[5] - lowest}};
+    glm::dvec3 best{0.};
+    double best_length = 0.;
+    for (int a = 0; a < 3; ++a) {
+        const glm::dvec3 c = glm::cross(rows[a], rows[(a + 1) % 3]);
+        const double length = glm::dot(c, c);
+        if (length > best_length) {
+            best = c;
+            best_length = length;
+        }
+    }
+    return best_length > 0. ? glm::vec3{best / std::sqrt(best_length)}
+                            : glm::vec3{0.f};
+}
+
+// normal of every point from the plane through its k nearest neighbours,
+// the direction of least variance, into ns in the original order. the
+// normals point away from the origin, which is the center of the cloud
+inline void estimate_normals(const PointGrid &grid, glm::vec3 *ns) {
+    constexpr int k = 16;
+    // in grid order, the neighbours of consecutive points are mostly the
+    // same and stay in cache
+    parallel_for(
+        grid.size(),
+        [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const glm::vec3 &p = grid.point(i);
+                // offsets of the k nearest so far, sorted by distance
+                float distances[k];
+                glm::vec3 nearest[k];
+                int found = 0;
+                grid.near(p, [&](const glm::vec3 &q) {
+                    const glm::vec3 d = q - p;
+                    const float distance = glm::dot(d, d);
+                    if (found == k && distance >= distances[k - 1]) {
+                        return;
+                    }
+                    int s = found < k ? found++ : k - 1;
+                    for (; s > 0 && distances[s - 1] > distance; --s) {
+                        distances[s] = distances[s - 1];
+                        nearest[s] = nearest[s - 1];
+                    }
+                    distances[s] = distance;
+                    nearest[s] = d;
+                });
+                glm::dvec3 mean{0.};
+                for (int n = 0; n < found; ++n) {
+                    mean += glm::dvec3{nearest[n]};
+                }
+                mean /= double(std::max(found, 1));
+                double covariance[6] = {};
+                for (int n = 0; n < found; ++n) {
+                    const glm::dvec3 d = glm::dvec3{nearest[n]} - mean;
+                    covariance[0] += d.x * d.x;
+                    covariance[1] += d.x * d.y;
+                    covariance[2] += d.x * d.z;
+                    covariance[3] += d.y * d.y;
+                    covariance[4] += d.y * d.z;
+                    covariance[5] += d.z * d.z;
+                }
+                glm::vec3 n = found >= 3 ? smallest_eigenvector(covariance)
+                                         : glm::vec3{0.f};
+                if (n == glm::vec3{0.f}) {
+                    // too few neighbours, or all of them on a line
+                    n = glm::length(p) > 0.f ? glm::normalize(p)
+                                             : glm::vec3{0.f, 1.f, 0.f};
+                }
+                ns[grid.index(i)] = glm::dot(n, p) < 0.f ? -n : n;
+            }
+        },
+        256);
+}
+
+// mean distance of a point to its nearest neighbour, over a sample of the
+// points
+inline float point_spacing(const PointGrid &grid) {
+    const size_t step = std::max<size_t>(1, grid.size() / 4096);
+    double sum = 0.;
+    size_t samples = 0;
+    for (size_t i = 0; i < grid.size(); i += step) {
+        const glm::vec3 &p = grid.point(i);
+        // the first point at no distance is p itself
+        bool self = false;
+        float nearest = INFINITY;
+        grid.near(p, [&](const glm::vec3 &q) {
+            const float distance = glm::length(q - p);
+            if (distance == 0.f && !self) {
+                self = true;
+            } else {
+                nearest = std::min(nearest, distance);
+            }
+        });
+        if (std::isfinite(nearest)) {
+            sum += nearest;
+            ++samples;
+        }
+    }
+    return samples ? float(sum / double(samples)) : 0.f;
+}
+
+// read a point cloud from file_path, adjust the orientation and scale like
+// load_mesh does, and estimate the normals when the file has none. points
+// is empty when the file cannot be read. temporaries live in the scratch
+// arena
+inline PointCloud load_point_cloud(const std::filesystem::path &file_path,
+                                   const bool y_up, const bool x_front,
+                                   MeshLoadStats *stats = nullptr) {
+    XTR_TRACE_SCOPE("point cloud load");
+    const auto start = std::chrono::steady_clock::now();
+    ScratchArena &scratch = scratch_arena();
+    struct ScratchReset {
+        ScratchArena &arena;
+        ~ScratchReset() { arena.reset(); }
+    } scratch_reset{scratch};
+    MemoryTally tally;
+    PointCloud cloud;
+
+    glm::vec3 *ps = nullptr, *ns = nullptr;
+    size_t count = 0;
+    // the streaming reader first, miniply for the files it rejects
+    PlyFile ply{file_path};
+    if (ply.valid()) {
+        count = ply.vertex_count();
+        ps = scratch.alloc<glm::vec3>(count);
+        ns = scratch.alloc<glm::vec3>(count);
+        if (!ply.read_positions(ps, sizeof(glm::vec3))) {
+            return cloud;
+        }
+        cloud.estimated_normals = !ply.read_normals(ns, sizeof(glm::vec3));
+    } else {
+        miniply::PLYReader r(file_path.c_str());
+        for (; r.has_element(); r.next_element()) {
+            uint32_t properties[3];
+            if (!r.element_is(miniply::kPLYVertexElement) ||
+                !r.load_element() || !r.find_pos(properties)) {
+                continue;
+            }
+            count = r.num_rows();
+            ps = scratch.alloc<glm::vec3>(count);
+            ns = scratch.alloc<glm::vec3>(count);
+            if (!r.extract_properties(properties, 3,
+                                      miniply::PLYPropertyType::Float, ps)) {
+                return cloud;
+            }
+            cloud.estimated_normals =
+                !r.find_normal(properties) ||
+                !r.extract_properties(properties, 3,
+                                      miniply::PLYPropertyType::Float, ns);
+            break;
+        }
+    }
+    if (count == 0) {
+        return cloud;
+    }
+    tally.add(2 * count * sizeof(glm::vec3));
+
+    const MeshBounds bounds = mesh_bounds(ps, count);
+    recenter_positions(ps, count, bounds, y_up, x_front);
+    cloud.bb_dimension = bounds.dimension() / bounds.diagonal();
+    // the spacing first, on cells sized by the area of the box, which is at
+    // least the area of the surface a scan samples
+    const glm::vec3 &d = cloud.bb_dimension;
+    const float area = 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    const size_t used = scratch.used();
+    cloud.spacing = point_spacing(
+        {ps, count, std::max(std::sqrt(4.f * area / float(count)), 1e-6f)});
+    if (cloud.estimated_normals) {
+        // cells of four spacings hold about three times k points in the 27
+        // around a point
+        estimate_normals({ps, count, std::max(4.f * cloud.spacing, 1e-6f)},
+                         ns);
+    } else {
+        parallel_for(count, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const float length = glm::length(ns[i]);
+                ns[i] = length > 0.f ? orient(ns[i] / length, y_up, x_front)
+                                     : glm::vec3{0.f};
+            }
+        });
+    }
+    tally.add(scratch.used() - used);
+
+    // the same order every time, so a recorded session replays the same
+    // subsample
+    uint32_t *order = scratch.alloc<uint32_t>(count);
+    tally.add(count * sizeof(uint32_t));
+    std::iota(order, order + count, 0u);
+    std::shuffle(order, order + count, std::mt19937{uint32_t(count)});
+    cloud.points.resize(count);
+    tally.add(count * sizeof(Vertex));
+    parallel_for(count, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            cloud.points[i] = {ps[order[i]], ns[order[i]]};
+        }
+    });
+
+    if (stats) {
+        *stats = {};
+        stats->vertex_count = count;
+        stats->peak_bytes = tally.peak();
+        stats->mesh_bytes = count * sizeof(Vertex);
+        stats->peak_rss_bytes = peak_rss_bytes();
+        stats->load_ms = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+    }
+    return cloud;
+}
+
+// the points of a cloud on the gpu, drawn as splats through
+// MeshPass::draw_splats
+class PointSplats {
+  public:
+    PointSplats() {
+        _vertex_buffer.label("point cloud");
+        _array.bind();
+        _vertex_buffer.bind();
+        attrib_mesh(0, 1);
+        // the smooth shape uses the normals as they are, estimated normals
+        // are smooth already
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                              (void *)offsetof(Vertex, normal));
+        glEnableVertexAttribArray(2);
+        _array.unbind();
+    }
+
+    inline void upload(const PointCloud &cloud) {
+        _vertex_buffer.bind();
+        _vertex_buffer.data(GLsizeiptr(cloud.points.size() * sizeof(Vertex)),
+                            cloud.points.data(), GL_STATIC_DRAW);
+        _count = cloud.points.size();
+        _bb_dimension = cloud.bb_dimension;
+        _spacing = cloud.spacing;
+        _estimated_normals = cloud.estimated_normals;
+    }
+
+    // points to draw for a view where a unit at the distance of the cloud
+    // covers pixels_per_unit pixels, and the diameter of their splats. no
+    // more than budget points are drawn, nor more than it takes to put
+    // about one point on every pixel, the splats of the remaining points
+    // grow to keep the surface closed
+    inline size_t level_of_detail(const float pixels_per_unit,
+                                  const size_t budget, const float scale,
+                                  float &diameter) const {
+        const float spacing_pixels = _spacing * pixels_per_unit;
+        size_t count = std::min(_count, budget);
+        if (spacing_pixels < 1.f) {
+            count = std::min(
+                count, std::max<size_t>(1, size_t(double(_count) *
+                                                  spacing_pixels *
+                                                  spacing_pixels)));
+        }
+        diameter = count ? _spacing *
+                               std::sqrt(float(_count) / float(count)) * scale
+                         : 0.f;
+        return count;
+    }
+
+    // draw the first count points, the mesh pass program is in use
+    inline void draw(const size_t count) {
+        _drawn = std::min(count, _count);
+        _array.bind();
+        glDrawArrays(GL_POINTS, 0, GLsizei(_drawn));
+        _array.unbind();
+    }
+
+    inline size_t count() const { return _count; }
+    inline size_t drawn() const { return _drawn; }
+    inline const glm::vec3 &bb_dimension() const { return _bb_dimension; }
+    inline bool estimated_normals() const { return _estimated_normals; }
+
+  private:
+    xtr::Array _array;
+    xtr::Buffer _vertex_buffer{GL_ARRAY_BUFFER};
+    size_t _count = 0, _drawn = 0;
+    glm::vec3 _bb_dimension{1.f};
+    float _spacing = 0.f;
+    bool _estimated_normals = false;
+};
+} // namespace xtr
@@ -0,0 +1,191 @@
+// golden image regression of the render chain
+// fixed poses are rendered and compared against stored pngs with a
+// perceptual tolerance: a pixel differs when the yiq distance of its color
+// (the metric of pixelmatch) exceeds a threshold, and a case fails when too
+// many pixels differ. the gpu time of each pass comes from the timeline
+#pragma once
+#include <SDL_image.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <xtr_trace.h>
+
+namespace xtr {
+// pixels of two images that differ noticeably
+struct ImageDiff {
+    size_t differing = 0, pixels = 0;
+    // largest distance of a pixel, 0 to 1
+    double max_delta = 0.;
+
+    inline double fraction() const {
+        return pixels ? double(differing) / double(pixels) : 1.;
+    }
+};
+
+// perceived distance of two rgb colors, 0 for equal and 1 for black against
+// white, weighted in yiq so that brightness counts more than hue
+inline double perceptual_delta(const unsigned char *a, const unsigned char *b) {
+    const double r = double(a[0]) - double(b[0]);
+    const double g = double(a[1]) - double(b[1]);
+    const double bl = double(a[2]) - double(b[2]);
+    const double y = r * 0.29889531 + g * 0.58662247 + bl * 0.11448223;
+    const double i = r * 0.59597799 - g * 0.27417610 - bl * 0.32180189;
+    const double q = r * 0.21147017 - g * 0.52261711 + bl * 0.31114694;
+    const double delta = 0.5053 * y * y + 0.299 * i * i + 0.1957 * q * q;
+    return std::sqrt(delta / 35215.);
+}
+
+// compare two rgba images of the same size. diff, if given, receives the
+// expected image faded to grey with the differing pixels in red
+inline ImageDiff compare_images(const std::vector<unsigned char> &expected,
+                                const std::vector<unsigned char> &actual,
+                                const double threshold,
+                                std::vector<unsigned char> *diff = nullptr) {
+    ImageDiff result;
+    if (expected.size() != actual.size()) {
+        return result;
+    }
+    result.pixels = actual.size() / 4;
+    if (diff) {
+        diff->resize(actual.size());
+    }
+    for (size_t p = 0; p < result.pixels; ++p) {
+        const double delta =
+            perceptual_delta(&expected[p * 4], &actual[p * 4]);
+        result.max_delta = std::max(result.max_delta, delta);
+        const bool differs = delta > threshold;
+        result.differing += differs;
+        if (diff) {
+            const unsigned char grey =
+                (unsigned char)(160 + (expected[p * 4] + expected[p * 4 + 1] +
+                                       expected[p * 4 + 2]) /
+                                          9);
+            unsigned char *d = diff->data() + p * 4;
+            d[0] = differs ? 255 : grey;
+            d[1] = differs ? 0 : grey;
+            d[2] = differs ? 0 : grey;
+            d[3] = 255;
+        }
+    }
+    return result;
+}
+
+// bottom-up rgba of a png, as glReadPixels returns it. empty when the file
+// is missing or of another size
+inline std::vector<unsigned char> load_png(const std::filesystem::path &path,
+                                           const int width, const int height) {
+    std::vector<unsigned char> rgba;
+    SDL_Surface *loaded = IMG_Load(path.string().c_str());
+    if (!loaded) {
+        return rgba;
+    }
+    SDL_Surface *surface =
+        SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(loaded);
+    if (surface && surface->w == width && surface->h == height) {
+        const size_t pitch = size_t(width) * 4;
+        rgba.resize(pitch * height);
+        for (int y = 0; y < height; ++y) {
+            const auto *row =
+                static_cast<const unsigned char *>(surface->pixels) +
+                size_t(y) * surface->pitch;
+            std::copy_n(row, pitch, rgba.data() + (height - 1 - y) * pitch);
+        }
+    }
+    SDL_FreeSurface(surface);
+    return rgba;
+}
+
+// lowercase name with every other character as a dash, for file names
+inline std::string case_name_part(const char *name) {
+    std::string part;
+    for (const char *c = name; *c; ++c) {
+        part += std::isalnum((unsigned char)*c)
+                    ? char(std::tolower((unsigned char)*c))
+                    : '-';
+    }
+    return part;
+}
+
+// median gpu time of each pass that ended since, in ms
+inline std::map<std::string, double> gpu_pass_ms(const int64_t since) {
+    std::map<std::string, std::vector<double>> times;
+    for (const TraceEvent &event : tracer().gpu_events(since)) {
+        times[event.name].push_back(double(event.end - event.begin) * 1e-6);
+    }
+    std::map<std::string, double> medians;
+    for (auto &[name, ms] : times) {
+        std::sort(ms.begin(), ms.end());
+        medians[name] = ms[ms.size() / 2];
+    }
+    return medians;
+}
+
+class RegressionReport {
+  public:
+    struct Case {
+        std::string name;
+        bool golden_found = false;
+        bool passed = false;
+        ImageDiff diff;
+        std::map<std::string, double> pass_ms;
+    };
+
+    inline void add(Case c) {
+        _failed += !c.passed;
+        _cases.push_back(std::move(c));
+    }
+
+    inline size_t failed() const { return _failed; }
+
+    // one line per failing case, the summed pass times and the verdict
+    inline void report(std::ostream &os) const {
+        std::map<std::string, double> total_ms;
+        for (const Case &c : _cases) {
+            for (const auto &[pass, ms] : c.pass_ms) {
+                total_ms[pass] += ms;
+            }
+            if (c.passed) {
+                continue;
+            }
+            if (c.golden_found) {
+                os << "FAIL " << c.name << ": "
+                   << c.diff.fraction() * 100. << "% of pixels differ, max "
+                   << c.diff.max_delta << "\n";
+            } else {
+                os << "FAIL " << c.name << ": no golden\n";
+            }
+        }
+        for (const auto &[pass, ms] : total_ms) {
+            os << pass << ": " << ms << " ms over " << _cases.size()
+               << " cases\n";
+        }
+        os << _cases.size() - _failed << " of " << _cases.size()
+           << " cases passed\n";
+    }
+
+    // one row per case and pass
+    inline bool write_csv(const std::filesystem::path &path) const {
+        std::ofstream file{path};
+        file << "case,passed,differing_fraction,max_delta,pass,gpu_ms\n";
+        for (const Case &c : _cases) {
+            for (const auto &[pass, ms] : c.pass_ms) {
+                file << c.name << "," << c.passed << ","
+                     << c.diff.fraction() << "," << c.diff.max_delta << ","
+                     << pass << "," << ms << "\n";
+            }
+        }
+        return bool(file);
+    }
+
+  private:
+    std::vector<Case> _cases;
+    size_t _failed = 0;
+};
+} // namespace xtr
@@ -2,30 +2,49 @@
 // used to combine framebuffer data, or perform post-processing on an image
 // the fragment shader is customized
 #pragma once
+#include <glm/glm.hpp>
 #include <xtr_buffer.h>
 #include <xtr_shader.h>
 namespace xtr {
 static const int indices[] = {0, 1, 2};
 class ScreenPass {
   public:
-    ScreenPass(const std::filesystem::path &frag)
-        : _program{load_program("./data/shaders/screen.vert", frag)}, _array{},
+    // vert is screen.vert, or screen_tiles.vert for draw_tiles
+    ScreenPass(const std::filesystem::path &frag,
+               const std::filesystem::path &vert = "./data/shaders/screen.vert")
+        : _program{load_program(vert, frag)}, _array{},
           _element_buffer{GL_ELEMENT_ARRAY_BUFFER} {
+        _element_buffer.label("screen pass indices");
         _array.bind();
         _element_buffer.bind();
         _element_buffer.data(sizeof(indices), indices, GL_STATIC_DRAW);
         _array.unbind();
     }
 
+    // the part of the sampled targets the screen covers, less than one when
+    // they are allocated larger than the viewport
+    glm::vec2 uv_scale{1.f, 1.f};
+
     // simply draw a big triangle that cover the whole screen
     // more on screen.vert
     inline void draw() const {
         _program.use();
+        _program.uni_2f(_program.loc("uni_uv_scale"), uv_scale.x, uv_scale.y);
         _array.bind();
         glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
         _array.unbind();
     }
 
+    // draw count instanced quads, the tiles of screen_tiles.vert, whose
+    // uniforms ScreenTiles::bind sets
+    inline void draw_tiles(const GLsizei count) const {
+        _program.use();
+        _program.uni_2f(_program.loc("uni_uv_scale"), uv_scale.x, uv_scale.y);
+        _array.bind();
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+        _array.unbind();
+    }
+
     inline const xtr::Program &get_program() const { return _program; }
 
   private:
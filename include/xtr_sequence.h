@@ -0,0 +1,603 @@
+// animated mesh sequences
+// a sequence is a directory of .ply or .obj frames sharing one topology, or
+// a vertex animation cache (.xtrv) built from one that keeps the triangles
+// once and every frame as 16 bit positions. frames are decoded ahead of
+// playback on worker threads, where the normals are gathered through the
+// triangles around each vertex, found once for the shared topology. a
+// decoded frame is copied into one of two vertex buffers while the other
+// one is drawn, and a frame that is not ready in time keeps the last one on
+// screen instead of waiting for it
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <xtr_buffer.h>
+#include <xtr_mesh.h>
+#include <xtr_obj.h>
+#include <xtr_parallel.h>
+#include <xtr_ply.h>
+#include <xtr_trace.h>
+
+namespace xtr {
+constexpr char sequence_magic[4] = {'X', 'T', 'R', 'V'};
+constexpr uint32_t sequence_version = 1;
+
+// header of a vertex animation cache. the indices of the triangles follow
+// it, then every frame as three 16 bit coordinates per vertex within the
+// bounds
+struct SequenceHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t frame_count;
+    float fps;
+    // of all frames, which are already centered, scaled and turned
+    glm::vec3 lowest, highest;
+    // of the first frame, for the analytic abstracted shapes
+    glm::vec3 bb_dimension;
+};
+
+// the frames of a sequence directory, .ply and .obj files in name order
+inline std::vector<std::filesystem::path>
+sequence_frames(const std::filesystem::path &directory) {
+    std::vector<std::filesystem::path> frames;
+    std::error_code error;
+    for (const auto &file :
+         std::filesystem::directory_iterator{directory, error}) {
+        const auto extension = file.path().extension();
+        if (extension == ".ply" || extension == ".obj") {
+            frames.push_back(file.path());
+        }
+    }
+    std::sort(frames.begin(), frames.end());
+    return frames;
+}
+
+// whether file_path is a vertex animation cache or a directory of frames
+inline bool is_sequence(const std::filesystem::path &file_path) {
+    return file_path.extension() == ".xtrv" ||
+           (std::filesystem::is_directory(file_path) &&
+            !sequence_frames(file_path).empty());
+}
+
+// positions of a frame file, and its triangles when indices is given
+inline bool read_frame_file(const std::filesystem::path &file_path,
+                            std::vector<glm::vec3> &ps,
+                            std::vector<int> *indices) {
+    if (file_path.extension() == ".ply") {
+        PlyFile ply{file_path};
+        if (ply.valid()) {
+            ps.resize(ply.vertex_count());
+            if (indices) {
+                indices->resize(ply.triangle_count() * 3);
+                if (!ply.read_triangles(indices->data())) {
+                    return false;
+                }
+            }
+            return ply.read_positions(ps.data(), sizeof(glm::vec3)) &&
+                   !ps.empty();
+        }
+    }
+    auto loaded = file_path.extension() == ".obj"
+                      ? load_obj_file(file_path)
+                      : load_ply_file(file_path);
+    ps = std::move(loaded.first);
+    if (indices) {
+        *indices = std::move(loaded.second);
+    }
+    return !ps.empty();
+}
+
+// the triangles around every vertex of the shared topology, so that the
+// normals of a frame are gathered per vertex instead of scattered per
+// triangle. the results match vertex_normals and smooth_normals
+class SequenceTopology {
+  public:
+    SequenceTopology() = default;
+    SequenceTopology(std::vector<int> indices, const size_t vertex_count)
+        : _indices{std::move(indices)}, _offsets(vertex_count + 1, 0),
+          _faces(_indices.size()) {
+        for (const int v : _indices) {
+            ++_offsets[v + 1];
+        }
+        for (size_t v = 0; v < vertex_count; ++v) {
+            _offsets[v + 1] += _offsets[v];
+        }
+        std::vector<uint32_t> next(_offsets.begin(), _offsets.end() - 1);
+        for (size_t i = 0; i < _indices.size(); ++i) {
+            _faces[next[_indices[i]]++] = uint32_t(i / 3);
+        }
+    }
+
+    inline const std::vector<int> &indices() const { return _indices; }
+    inline size_t vertex_count() const { return _offsets.size() - 1; }
+    inline size_t triangle_count() const { return _indices.size() / 3; }
+
+    // area weighted vertex normals into vns, face_normals receives the
+    // normal of every triangle
+    inline void vertex_normals(const glm::vec3 *ps, glm::vec3 *face_normals,
+                               glm::vec3 *vns) const {
+        for (size_t f = 0; f < triangle_count(); ++f) {
+            const glm::vec3 &a = ps[_indices[f * 3]];
+            face_normals[f] = glm::cross(ps[_indices[f * 3 + 1]] - a,
+                                         ps[_indices[f * 3 + 2]] - a);
+        }
+        for (size_t v = 0; v < vertex_count(); ++v) {
+            glm::vec3 n{0.f};
+            for (uint32_t k = _offsets[v]; k < _offsets[v + 1]; ++k) {
+                n += face_normals[_faces[k]];
+            }
+            vns[v] = glm::normalize(n);
+        }
+    }
+
+    // abstracted normal of the smooth shape into ans, tns is scratch of the
+    // same size
+    inline void smooth_normals(const glm::vec3 *vns, glm::vec3 *ans,
+                               glm::vec3 *tns) const {
+        const int iterations = 4; // iterations of laplace operator
+        std::fill(ans, ans + vertex_count(), glm::vec3{});
+        std::copy(vns, vns + vertex_count(), tns);
+        for (int it = 0; it < iterations; ++it) {
+            for (size_t v = 0; v < vertex_count(); ++v) {
+                // the other two corners of every triangle around v
+                glm::vec3 n = ans[v];
+                for (uint32_t k = _offsets[v]; k < _offsets[v + 1]; ++k) {
+                    const int *t = &_indices[size_t(_faces[k]) * 3];
+                    n += tns[t[0]] + tns[t[1]] + tns[t[2]] - tns[v];
+                }
+                ans[v] = glm::normalize(n);
+            }
+            std::copy(ans, ans + vertex_count(), tns);
+        }
+    }
+
+  private:
+    std::vector<int> _indices;
+    // the triangles around vertex v are _faces[_offsets[v]] up to
+    // _faces[_offsets[v + 1]]
+    std::vector<uint32_t> _offsets;
+    std::vector<uint32_t> _faces;
+};
+
+// write the frames of a sequence directory into a vertex animation cache,
+// centered, scaled and turned like load_mesh with the first frame. frames
+// whose vertex count differs from the first are left out
+inline bool build_vertex_cache(const std::filesystem::path &directory,
+                               const std::filesystem::path &out_path,
+                               const bool y_up, const bool x_front,
+                               const float fps) {
+    const std::vector<std::filesystem::path> frames =
+        sequence_frames(directory);
+    std::vector<glm::vec3> ps;
+    std::vector<int> indices;
+    if (frames.empty() || !read_frame_file(frames[0], ps, &indices) ||
+        indices.empty()) {
+        return false;
+    }
+    const size_t vertex_count = ps.size();
+    const MeshBounds first = mesh_bounds(ps.data(), ps.size());
+    // the bounds of every frame are needed before the first is quantized,
+    // so the frames are read twice
+    std::vector<bool> kept(frames.size(), false);
+    MeshBounds bounds{glm::vec3{1e30f}, glm::vec3{-1e30f}};
+    for (size_t f = 0; f < frames.size(); ++f) {
+        if (!read_frame_file(frames[f], ps, nullptr) ||
+            ps.size() != vertex_count) {
+            continue;
+        }
+        kept[f] = true;
+        recenter_positions(ps.data(), ps.size(), first, y_up, x_front);
+        const MeshBounds frame = mesh_bounds(ps.data(), ps.size());
+        bounds.lowest = glm::min(bounds.lowest, frame.lowest);
+        bounds.highest = glm::max(bounds.highest, frame.highest);
+    }
+
+    std::ofstream file{out_path, std::ios::out | std::ios::binary};
+    SequenceHeader header{};
+    memcpy(header.magic, sequence_magic, 4);
+    header.version = sequence_version;
+    header.vertex_count = uint32_t(vertex_count);
+    header.index_count = uint32_t(indices.size());
+    header.frame_count = uint32_t(std::count(kept.begin(), kept.end(), true));
+    header.fps = fps;
+    header.lowest = bounds.lowest;
+    header.highest = bounds.highest;
+    header.bb_dimension = first.dimension() / first.diagonal();
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)indices.data(),
+               std::streamsize(indices.size() * sizeof(int)));
+    const glm::vec3 extent =
+        glm::max(bounds.highest - bounds.lowest, glm::vec3{1e-12f});
+    std::vector<uint16_t> quantized(vertex_count * 3);
+    for (size_t f = 0; f < frames.size(); ++f) {
+        if (!kept[f] || !read_frame_file(frames[f], ps, nullptr)) {
+            continue;
+        }
+        recenter_positions(ps.data(), ps.size(), first, y_up, x_front);
+        for (size_t v = 0; v < vertex_count; ++v) {
+            const glm::vec3 q = (ps[v] - bounds.lowest) / extent * 65535.f;
+            for (int a = 0; a < 3; ++a) {
+                quantized[v * 3 + a] =
+                    uint16_t(std::clamp(q[a] + 0.5f, 0.f, 65535.f));
+            }
+        }
+        file.write((const char *)quantized.data(),
+                   std::streamsize(quantized.size() * sizeof(uint16_t)));
+    }
+    return header.frame_count > 0 && bool(file);
+}
+
+// player of a sequence. update picks the frame for the playback time, asks
+// the workers for the frames after it and swaps in the frame when it is
+// decoded, draw draws the last frame swapped in
+class MeshSequence {
+  public:
+    // the directory frames are turned like load_mesh, a cache was turned
+    // when it was built
+    MeshSequence(const std::filesystem::path &file_path, const bool smooth,
+                 const bool y_up, const bool x_front, const float fps = 24.f)
+        : _path{file_path}, _smooth{smooth}, _y_up{y_up}, _x_front{x_front},
+          _fps{fps} {
+        std::vector<int> indices;
+        size_t vertex_count = 0;
+        if (file_path.extension() == ".xtrv") {
+            std::ifstream file{file_path, std::ios::in | std::ios::binary};
+            SequenceHeader header{};
+            file.read((char *)&header, sizeof(header));
+            if (!file || memcmp(header.magic, sequence_magic, 4) != 0 ||
+                header.version != sequence_version ||
+                header.vertex_count == 0 || header.index_count == 0 ||
+                header.frame_count == 0) {
+                return;
+            }
+            indices.resize(header.index_count);
+            file.read((char *)indices.data(),
+                      std::streamsize(indices.size() * sizeof(int)));
+            for (const int i : indices) {
+                if (i < 0 || uint32_t(i) >= header.vertex_count) {
+                    file.setstate(std::ios::failbit);
+                }
+            }
+            if (!file) {
+                return;
+            }
+            _cached = true;
+            _frame_count = header.frame_count;
+            _fps = header.fps > 0.f ? header.fps : fps;
+            _lowest = header.lowest;
+            _extent = (header.highest - header.lowest) / 65535.f;
+            _bb_dimension = header.bb_dimension;
+            _frames_offset =
+                sizeof(SequenceHeader) + indices.size() * sizeof(int);
+            vertex_count = header.vertex_count;
+        } else {
+            _frames = sequence_frames(file_path);
+            std::vector<glm::vec3> ps;
+            if (_frames.empty() || !read_frame_file(_frames[0], ps, &indices) ||
+                indices.empty()) {
+                return;
+            }
+            _first = mesh_bounds(ps.data(), ps.size());
+            _bb_dimension = _first.dimension() / _first.diagonal();
+            _frame_count = _frames.size();
+            vertex_count = ps.size();
+        }
+        _topology = SequenceTopology{std::move(indices), vertex_count};
+
+        _element_buffer.label("sequence indices");
+        for (FrameBuffers &buffers : _buffers) {
+            buffers.vertex_buffer.label("sequence vertices");
+            buffers.abstracted_buffer.label("sequence abstracted normals");
+            buffers.array.bind();
+            buffers.vertex_buffer.bind();
+            _element_buffer.bind();
+            attrib_mesh(0, 1);
+            buffers.abstracted_buffer.bind();
+            attrib_abstracted(2, _smooth);
+            buffers.array.unbind();
+        }
+        _buffers[0].array.bind();
+        _element_buffer.data(
+            GLsizeiptr(_topology.indices().size() * sizeof(int)),
+            _topology.indices().data(), GL_STATIC_DRAW);
+        _buffers[0].array.unbind();
+
+        // the first frame is decoded right away, so there is always
+        // something to draw
+        SequenceFrame first;
+        first.index = 0;
+        std::ifstream cache;
+        if (_cached) {
+            cache.open(_path, std::ios::in | std::ios::binary);
+        }
+        if (!decode(first, cache)) {
+            _frame_count = 0;
+            return;
+        }
+        upload(first);
+        _requested.assign(_frame_count, false);
+        const size_t workers =
+            std::clamp<size_t>(thread_count() - 1, 1, 4);
+        for (size_t w = 0; w < workers; ++w) {
+            _workers.emplace_back([this]() { work(); });
+        }
+    }
+    MeshSequence(const MeshSequence &) = delete;
+    MeshSequence &operator=(const MeshSequence &) = delete;
+    ~MeshSequence() {
+        {
+            std::lock_guard lock{_mutex};
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (std::thread &worker : _workers) {
+            worker.join();
+        }
+    }
+
+    inline bool valid() const { return _frame_count > 0; }
+
+    // show the frame at seconds into the sequence if it is decoded, and
+    // queue the ones after it. call once per frame before draw
+    inline void update(const double seconds) {
+        if (!valid()) {
+            return;
+        }
+        XTR_TRACE_SCOPE("sequence update");
+        const size_t target =
+            size_t(std::max(0., std::floor(seconds * _fps))) % _frame_count;
+        const size_t ahead = std::min(frames_ahead, _frame_count);
+        // how far a frame is past the target, wrapping around at the end
+        auto distance = [&](const size_t index) {
+            return (index + _frame_count - target) % _frame_count;
+        };
+        {
+            std::lock_guard lock{_mutex};
+            for (SequenceFrame &frame : _decoded) {
+                _ready.push_back(std::move(frame));
+            }
+            _decoded.clear();
+            // drop the queued frames playback has passed
+            for (auto it = _queue.begin(); it != _queue.end();) {
+                if (distance(*it) >= ahead) {
+                    _requested[*it] = false;
+                    it = _queue.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        // swap in the target, or the latest frame before it that arrived
+        // late, and recycle the frames behind
+        std::sort(_ready.begin(), _ready.end(),
+                  [&](const SequenceFrame &a, const SequenceFrame &b) {
+                      return distance(a.index) < distance(b.index);
+                  });
+        size_t kept = 0;
+        for (SequenceFrame &frame : _ready) {
+            if (frame.index == target && !frame.vertices.empty()) {
+                if (_shown != target) {
+                    upload(frame);
+                }
+            }
+            if (frame.index == target || distance(frame.index) >= ahead) {
+                _requested[frame.index] = false;
+                std::lock_guard lock{_mutex};
+                _spare.push_back(std::move(frame));
+            } else {
+                _ready[kept++] = std::move(frame);
+            }
+        }
+        _ready.resize(kept);
+        if (_shown != target && _late_target != target) {
+            _late_target = target;
+            ++_late;
+        }
+        {
+            std::lock_guard lock{_mutex};
+            for (size_t i = 0; i < ahead; ++i) {
+                const size_t index = (target + i) % _frame_count;
+                if (index != _shown && !_requested[index]) {
+                    _requested[index] = true;
+                    _queue.push_back(index);
+                }
+            }
+        }
+        _wake.notify_all();
+    }
+
+    // draw the frame shown, with the program of the mesh pass in use
+    inline void draw() const {
+        if (!valid()) {
+            return;
+        }
+        _buffers[_front].array.bind();
+        glDrawElements(GL_TRIANGLES, GLsizei(_topology.indices().size()),
+                       GL_UNSIGNED_INT, 0);
+        _buffers[_front].array.unbind();
+    }
+
+    // frames decoded ahead of the one shown
+    size_t frames_ahead = 8;
+
+    inline float fps() const { return _fps; }
+    inline double duration() const { return double(_frame_count) / _fps; }
+    inline size_t frame_count() const { return _frame_count; }
+    inline size_t shown_frame() const { return _shown; }
+    inline size_t ready_count() const { return _ready.size(); }
+    // frames that were not decoded by the time they were due
+    inline size_t late_count() const { return _late; }
+    // directory frames left out for a different vertex count
+    inline size_t mismatched_count() const { return _mismatched; }
+    inline size_t vertex_count() const { return _topology.vertex_count(); }
+    inline size_t triangle_count() const { return _topology.triangle_count(); }
+    inline size_t streamed_bytes() const { return _streamed_bytes; }
+    inline const glm::vec3 &bb_dimension() const { return _bb_dimension; }
+
+  private:
+    // a decoded frame, with the scratch of decoding it kept for reuse
+    struct SequenceFrame {
+        size_t index = 0;
+        std::vector<Vertex> vertices;
+        std::vector<glm::vec3> abstracted_normals;
+        std::vector<glm::vec3> positions, normals, face_normals, smoothing;
+        std::vector<uint16_t> quantized;
+    };
+
+    struct FrameBuffers {
+        xtr::Array array;
+        xtr::Buffer vertex_buffer{GL_ARRAY_BUFFER};
+        xtr::Buffer abstracted_buffer{GL_ARRAY_BUFFER};
+    };
+
+    // positions, normals and smooth normals of frame.index. vertices stays
+    // empty when the frame cannot be read
+    inline bool decode(SequenceFrame &frame, std::ifstream &cache) const {
+        const size_t count = _topology.vertex_count();
+        frame.vertices.clear();
+        std::vector<glm::vec3> &ps = frame.positions;
+        if (_cached) {
+            frame.quantized.resize(count * 3);
+            cache.seekg(std::streamoff(_frames_offset + frame.index *
+                                                            count * 3 *
+                                                            sizeof(uint16_t)));
+            cache.read((char *)frame.quantized.data(),
+                       std::streamsize(count * 3 * sizeof(uint16_t)));
+            if (!cache) {
+                cache.clear();
+                return false;
+            }
+            ps.resize(count);
+            for (size_t v = 0; v < count; ++v) {
+                const uint16_t *q = &frame.quantized[v * 3];
+                ps[v] = _lowest +
+                        glm::vec3{float(q[0]), float(q[1]), float(q[2])} *
+                            _extent;
+            }
+        } else {
+            if (!read_frame_file(_frames[frame.index], ps, nullptr) ||
+                ps.size() != count) {
+                return false;
+            }
+            recenter_positions(ps.data(), count, _first, _y_up, _x_front);
+        }
+        frame.face_normals.resize(_topology.triangle_count());
+        frame.normals.resize(count);
+        _topology.vertex_normals(ps.data(), frame.face_normals.data(),
+                                 frame.normals.data());
+        if (_smooth) {
+            frame.abstracted_normals.resize(count);
+            frame.smoothing.resize(count);
+            _topology.smooth_normals(frame.normals.data(),
+                                     frame.abstracted_normals.data(),
+                                     frame.smoothing.data());
+        }
+        frame.vertices.resize(count);
+        for (size_t v = 0; v < count; ++v) {
+            frame.vertices[v] = {ps[v], frame.normals[v]};
+        }
+        return true;
+    }
+
+    // copy a frame into the buffers not drawn and draw those from now on.
+    // respecifying the storage lets the driver hand out fresh memory
+    // instead of waiting for draws of the frame before last
+    inline void upload(const SequenceFrame &frame) {
+        FrameBuffers &back = _buffers[1 - _front];
+        back.vertex_buffer.bind();
+        back.vertex_buffer.data(
+            GLsizeiptr(frame.vertices.size() * sizeof(Vertex)),
+            frame.vertices.data(), GL_STREAM_DRAW);
+        _streamed_bytes += frame.vertices.size() * sizeof(Vertex);
+        if (_smooth) {
+            back.abstracted_buffer.bind();
+            back.abstracted_buffer.data(
+                GLsizeiptr(frame.abstracted_normals.size() *
+                           sizeof(glm::vec3)),
+                frame.abstracted_normals.data(), GL_STREAM_DRAW);
+            _streamed_bytes +=
+                frame.abstracted_normals.size() * sizeof(glm::vec3);
+        }
+        _front = 1 - _front;
+        _shown = frame.index;
+    }
+
+    // worker thread, decodes queued frames into spare ones
+    inline void work() {
+        tracer().name_thread("sequence decoder");
+        std::ifstream cache;
+        if (_cached) {
+            cache.open(_path, std::ios::in | std::ios::binary);
+        }
+        std::unique_lock lock{_mutex};
+        for (;;) {
+            _wake.wait(lock, [this]() { return _stop || !_queue.empty(); });
+            if (_stop) {
+                return;
+            }
+            SequenceFrame frame;
+            if (!_spare.empty()) {
+                frame = std::move(_spare.back());
+                _spare.pop_back();
+            }
+            frame.index = _queue.front();
+            _queue.pop_front();
+            lock.unlock();
+            bool ok = false;
+            {
+                XTR_TRACE_SCOPE("decode frame");
+                ok = decode(frame, cache);
+            }
+            lock.lock();
+            // a frame that cannot be read stays empty and is never shown
+            _mismatched += !ok;
+            _decoded.push_back(std::move(frame));
+        }
+    }
+
+    std::filesystem::path _path;
+    bool _smooth, _y_up, _x_front;
+    float _fps;
+    size_t _frame_count = 0;
+    SequenceTopology _topology;
+    glm::vec3 _bb_dimension{1.f};
+    // directory frames, turned with the bounds of the first
+    std::vector<std::filesystem::path> _frames;
+    MeshBounds _first;
+    // cache frames, dequantized within the bounds
+    bool _cached = false;
+    glm::vec3 _lowest{0.f}, _extent{0.f};
+    size_t _frames_offset = 0;
+
+    xtr::Buffer _element_buffer{GL_ELEMENT_ARRAY_BUFFER};
+    FrameBuffers _buffers[2];
+    int _front = 0;
+    size_t _shown = 0;
+    size_t _late = 0, _late_target = 0;
+    size_t _streamed_bytes = 0;
+    // decoded frames waiting for their turn, only on the render thread
+    std::vector<SequenceFrame> _ready;
+    std::vector<bool> _requested;
+
+    // shared with the workers
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::deque<size_t> _queue;
+    std::vector<SequenceFrame> _decoded, _spare;
+    size_t _mismatched = 0;
+    bool _stop = false;
+    std::vector<std::thread> _workers;
+};
+} // namespace xtr
@@ -6,6 +6,8 @@
 #include <glm/glm.hpp>
 #include <iostream>
 #include <sstream>
+#include <utility>
+#include <xtr_gl_state.h>
 
 namespace xtr {
 // shader object, load and compile shaders
@@ -23,14 +25,18 @@ class Shader {
     }
 
     Shader(GLenum shader_type) : _shader{glCreateShader(shader_type)} {}
-    Shader(Shader &&o) : _shader{o._shader} {};
+    Shader(Shader &&o) : _shader{std::exchange(o._shader, 0)} {};
     Shader(const Shader &) = delete;
     Shader &operator=(Shader &&o) {
-        _shader = o._shader;
+        std::swap(_shader, o._shader);
         return *this;
     };
     Shader &operator=(const Shader &) = delete;
-    ~Shader() { glDeleteShader(_shader); }
+    ~Shader() {
+        if (_shader) {
+            glDeleteShader(_shader);
+        }
+    }
 
     inline void source(const char *shader_source) const {
         glShaderSource(_shader, 1, &shader_source, nullptr);
@@ -60,14 +66,19 @@ class Shader {
 class Program {
   public:
     Program() : _program{glCreateProgram()} {};
-    Program(Program &&o) : _program{o._program} {};
+    Program(Program &&o) : _program{std::exchange(o._program, 0)} {};
     Program(const Program &) = delete;
     Program &operator=(Program &&o) {
-        _program = o._program;
+        std::swap(_program, o._program);
         return *this;
     };
     Program &operator=(const Program &) = delete;
-    ~Program() { glDeleteProgram(_program); };
+    ~Program() {
+        if (_program) {
+            gl_state().forget_program(_program);
+            glDeleteProgram(_program);
+        }
+    };
 
     inline void attach(const Shader &shader) const {
         glAttachShader(_program, shader);
@@ -88,7 +99,7 @@ class Program {
         }
     }
 
-    inline void use() const { glUseProgram(_program); }
+    inline void use() const { gl_state().use_program(_program); }
 
     // uniform variable location from variable name
     inline GLint loc(const std::string &name) const {
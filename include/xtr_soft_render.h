@@ -0,0 +1,675 @@
+// the x-toon chain on the cpu, for machines without a gl context
+// - the mesh pass is rasterized into the same g-buffer as MeshPass: triangles
+//   are set up and binned into tiles in parallel, then each tile is
+//   rasterized by one thread with a depth test, back face culling and
+//   perspective correct attributes
+// - screen_xtoon, screen_pp and screen_outline are evaluated per pixel in
+//   parallel rows, with nearest sampling and clamped edges like the textures
+// the g-buffer and the frame are rounded to half floats as their gl formats
+// are, so the output matches the gl one up to rasterization rules
+#pragma once
+#include <SDL_image.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <numbers>
+#include <vector>
+#include <xtr_camera.h>
+#include <xtr_mesh.h>
+#include <xtr_parallel.h>
+
+namespace xtr {
+// every uniform of the mesh pass and the screen passes, angles in radians.
+// the defaults are those of the app
+struct SoftRenderParams {
+    float normal_factor = 0.f;
+    int abstracted_shape = 0;
+    int id = 69;
+    // screen_xtoon
+    int detail_mapping = 3;
+    float near_silhouette_r = 0.f;
+    float specular_s = 1.f;
+    float dbam_z_min = 0.5f;
+    float dbam_r = 5.f;
+    // distance from the camera to the depth-of-field focus point
+    float dof_z_c = 0.f;
+    glm::vec3 light_dir{std::sin(-1.1f) * std::cos(-0.61f), std::cos(-1.1f),
+                        std::sin(-1.1f) * std::sin(-0.61f)};
+    bool nl_halftone = true;
+    float halftone_dot_size = 4.f;
+    float halftone_rotation = 69.f / 180.f * std::numbers::pi_v<float>;
+    // screen_pp
+    int pp_effect = 0;
+    float dot_size = 4.f;
+    float rotation_c = 15.f / 180.f * std::numbers::pi_v<float>;
+    float rotation_m = 75.f / 180.f * std::numbers::pi_v<float>;
+    float rotation_y = 0.f;
+    float rotation_k = 45.f / 180.f * std::numbers::pi_v<float>;
+    glm::vec4 background{0.1f, 0.5f, 0.8f, 1.f};
+    // screen_outline
+    int outline_type = 3;
+    glm::vec3 outline_col{0.f};
+    float outline_thr = 0.4f;
+    bool outline_id_fac = true;
+    float outline_normal_fac = 0.f;
+    float outline_position_fac = 1.f;
+    float outline_edge_fac = 1.f;
+};
+
+// an rgba8 image with its rows as stored in the file, top first, which is
+// how the gl path uploads the tonemaps
+struct SoftImage {
+    int width = 0, height = 0;
+    std::vector<unsigned char> rgba;
+
+    inline bool load(const std::filesystem::path &file_path) {
+        SDL_Surface *loaded = IMG_Load(file_path.string().c_str());
+        if (!loaded) {
+            return false;
+        }
+        SDL_Surface *surface =
+            SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+        SDL_FreeSurface(loaded);
+        if (!surface) {
+            return false;
+        }
+        width = surface->w;
+        height = surface->h;
+        rgba.resize(size_t(width) * height * 4);
+        for (int y = 0; y < height; ++y) {
+            std::copy_n(static_cast<const unsigned char *>(surface->pixels) +
+                            size_t(y) * surface->pitch,
+                        size_t(width) * 4, rgba.data() + size_t(y) * width * 4);
+        }
+        SDL_FreeSurface(surface);
+        return true;
+    }
+};
+
+// cpu time of each stage of the last render
+struct SoftRenderStats {
+    size_t triangles = 0, binned = 0;
+    double vertex_ms = 0., setup_ms = 0., raster_ms = 0., xtoon_ms = 0.,
+           composite_ms = 0.;
+};
+
+class SoftRenderer {
+  public:
+    static constexpr int tile_size = 32;
+
+    SoftRenderer(const int width, const int height) { resize(width, height); }
+
+    inline void resize(const int width, const int height) {
+        _width = std::max(1, width);
+        _height = std::max(1, height);
+        const size_t pixels = size_t(_width) * _height;
+        _position.resize(pixels);
+        _normal.resize(pixels);
+        _id.resize(pixels);
+        _depth.resize(pixels);
+        _frame.resize(pixels);
+        _edge_value.resize(pixels);
+        _rgba.resize(pixels * 4);
+        _tiles_x = (_width + tile_size - 1) / tile_size;
+        _tiles_y = (_height + tile_size - 1) / tile_size;
+        for (auto &bins : _bins) {
+            bins.assign(size_t(_tiles_x) * _tiles_y, {});
+        }
+    }
+
+    // render mesh from camera into the rgba8 output, the same chain as the
+    // gl path renders into the window
+    inline void render(const Mesh &mesh, const TurnTableCamera &camera,
+                       const glm::mat4 &model_matrix, const SoftImage &tonemap,
+                       const SoftRenderParams &params) {
+        using clock = std::chrono::steady_clock;
+        auto ms = [](const clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(clock::now() -
+                                                             start)
+                .count();
+        };
+        const glm::mat4 projection_matrix = glm::perspective(
+            glm::half_pi<float>(), float(_width) / float(_height), 1e-3f,
+            1e4f);
+        _stats = {};
+        auto start = clock::now();
+        shade_vertices(mesh, model_matrix,
+                       projection_matrix * camera.view_matrix() * model_matrix,
+                       params);
+        _stats.vertex_ms = ms(start);
+        start = clock::now();
+        setup_triangles(mesh.indices);
+        _stats.setup_ms = ms(start);
+        start = clock::now();
+        rasterize(params.id);
+        _stats.raster_ms = ms(start);
+        start = clock::now();
+        parallel_for(
+            size_t(_height),
+            [&](const size_t begin, const size_t end) {
+                for (size_t y = begin; y < end; ++y) {
+                    xtoon_row(int(y), camera, tonemap, params);
+                }
+            },
+            8);
+        _stats.xtoon_ms = ms(start);
+        start = clock::now();
+        parallel_for(
+            size_t(_height),
+            [&](const size_t begin, const size_t end) {
+                for (size_t y = begin; y < end; ++y) {
+                    composite_row(int(y), camera, params);
+                }
+            },
+            8);
+        _stats.composite_ms = ms(start);
+    }
+
+    // bottom-up rgba8 of the last render, as glReadPixels returns it
+    inline const std::vector<unsigned char> &rgba() const { return _rgba; }
+    inline int width() const { return _width; }
+    inline int height() const { return _height; }
+    inline const SoftRenderStats &stats() const { return _stats; }
+
+  private:
+    // a vertex after the vertex shader, varyings in world space
+    struct ClipVertex {
+        glm::vec4 clip;
+        glm::vec3 position, normal;
+    };
+    // a triangle ready for rasterization, in window coordinates
+    struct Triangle {
+        glm::vec2 p[3];
+        float z[3], inv_w[3];
+        glm::vec3 position[3], normal[3];
+        float area;
+        bool top_left[3];
+        int x0, y0, x1, y1;
+    };
+
+    // rounding of the 16 bit float formats of the g-buffer and the frame,
+    // to nearest even. the values stay far from the half float limits
+    static inline float half_float(const float x) {
+        uint32_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        bits += 0x0fffu + ((bits >> 13) & 1u);
+        bits &= ~0x1fffu;
+        float rounded;
+        std::memcpy(&rounded, &bits, sizeof(rounded));
+        return rounded;
+    }
+    static inline glm::vec3 half_float(const glm::vec3 &v) {
+        return {half_float(v.x), half_float(v.y), half_float(v.z)};
+    }
+
+    // float to 8 bit unorm, nan goes to 0 as in gl
+    static inline unsigned char unorm8(const float x) {
+        if (!(x > 0.f)) {
+            return 0;
+        }
+        return (unsigned char)(std::min(x, 1.f) * 255.f + 0.5f);
+    }
+
+    // texel index of a nearest sample with clamped edges
+    static inline int texel(const float t, const int size) {
+        if (std::isnan(t)) {
+            return 0;
+        }
+        return std::clamp(int(std::floor(t * float(size))), 0, size - 1);
+    }
+    inline size_t sample_index(const glm::vec2 &uv) const {
+        return size_t(texel(uv.y, _height)) * _width + texel(uv.x, _width);
+    }
+
+    // v * mat2(cos(r), sin(r), -sin(r), cos(r)) of the screen shaders
+    static inline glm::vec2 rotate(const glm::vec2 &v, const float r) {
+        const float c = std::cos(r), s = std::sin(r);
+        return {v.x * c + v.y * s, -v.x * s + v.y * c};
+    }
+
+    // nearest halftone dot center of frag_coord
+    static inline glm::vec2 dot_center(const glm::vec2 &frag_coord,
+                                       const float rotation,
+                                       const float dot_size) {
+        const glm::vec2 r = rotate(frag_coord, rotation) / dot_size;
+        return rotate(glm::vec2{std::round(r.x), std::round(r.y)} * dot_size,
+                      -rotation);
+    }
+
+    // mesh.vert
+    inline void shade_vertices(const Mesh &mesh, const glm::mat4 &model_matrix,
+                               const glm::mat4 &mvp,
+                               const SoftRenderParams &params) {
+        _vertices.resize(mesh.vertices.size());
+        const int axis = dominant_axis(mesh.bb_dimension);
+        parallel_for(mesh.vertices.size(), [&](const size_t begin,
+                                               const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const Vertex &v = mesh.vertices[i];
+                ClipVertex &out = _vertices[i];
+                out.clip = mvp * glm::vec4(v.position, 1.f);
+                out.position =
+                    glm::vec3(model_matrix * glm::vec4(v.position, 1.f));
+                out.normal =
+                    glm::vec3(model_matrix * glm::vec4(v.normal, 1.f));
+                if (params.normal_factor <= 0.f) {
+                    continue;
+                }
+                glm::vec3 p = v.position, abstracted{0.f};
+                if (params.abstracted_shape == 1) {
+                    abstracted =
+                        glm::normalize(glm::normalize(p) * mesh.bb_dimension);
+                } else if (params.abstracted_shape == 2) {
+                    if (axis >= 0) {
+                        p[axis] = 0.f;
+                    }
+                    abstracted = glm::normalize(p);
+                } else if (params.abstracted_shape == 3) {
+                    abstracted = glm::normalize(p);
+                } else if (i < mesh.abstracted_normals.size()) {
+                    abstracted = mesh.abstracted_normals[i];
+                }
+                abstracted =
+                    glm::vec3(model_matrix * glm::vec4(abstracted, 1.f));
+                out.normal =
+                    glm::mix(out.normal, abstracted, params.normal_factor);
+            }
+        });
+    }
+
+    // clip against the near and far planes, polygon holds n vertices and
+    // room for the ones clipping adds
+    static inline int clip_polygon(ClipVertex *polygon, int n) {
+        for (const float side : {1.f, -1.f}) {
+            ClipVertex clipped[8];
+            int m = 0;
+            for (int i = 0; i < n; ++i) {
+                const ClipVertex &a = polygon[i], &b = polygon[(i + 1) % n];
+                const float da = a.clip.w + side * a.clip.z;
+                const float db = b.clip.w + side * b.clip.z;
+                if (da >= 0.f) {
+                    clipped[m++] = a;
+                }
+                if ((da >= 0.f) != (db >= 0.f)) {
+                    const float t = da / (da - db);
+                    clipped[m++] = {glm::mix(a.clip, b.clip, t),
+                                    glm::mix(a.position, b.position, t),
+                                    glm::mix(a.normal, b.normal, t)};
+                }
+            }
+            std::copy(clipped, clipped + m, polygon);
+            n = m;
+        }
+        return n;
+    }
+
+    // a left edge, or a top edge of a counter-clockwise triangle with y up
+    static inline bool is_top_left(const glm::vec2 &a, const glm::vec2 &b) {
+        return b.y < a.y || (b.y == a.y && b.x < a.x);
+    }
+
+    static inline float edge(const glm::vec2 &a, const glm::vec2 &b,
+                             const glm::vec2 &p) {
+        return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+    }
+
+    // cull, set up and bin one clipped triangle of the chunk
+    inline void emit(const size_t chunk, const ClipVertex &a,
+                     const ClipVertex &b, const ClipVertex &c) {
+        Triangle t;
+        const ClipVertex *v[3] = {&a, &b, &c};
+        for (int k = 0; k < 3; ++k) {
+            const float inv_w = 1.f / v[k]->clip.w;
+            const glm::vec3 ndc = glm::vec3(v[k]->clip) * inv_w;
+            t.p[k] = {(ndc.x * 0.5f + 0.5f) * float(_width),
+                      (ndc.y * 0.5f + 0.5f) * float(_height)};
+            t.z[k] = ndc.z * 0.5f + 0.5f;
+            t.inv_w[k] = inv_w;
+            t.position[k] = v[k]->position * inv_w;
+            t.normal[k] = v[k]->normal * inv_w;
+        }
+        // back faces and degenerate triangles are culled
+        t.area = edge(t.p[0], t.p[1], t.p[2]);
+        if (!(t.area > 0.f)) {
+            return;
+        }
+        for (int k = 0; k < 3; ++k) {
+            t.top_left[k] = is_top_left(t.p[(k + 1) % 3], t.p[(k + 2) % 3]);
+        }
+        const glm::vec2 lo = glm::min(t.p[0], glm::min(t.p[1], t.p[2]));
+        const glm::vec2 hi = glm::max(t.p[0], glm::max(t.p[1], t.p[2]));
+        t.x0 = std::max(0, int(std::floor(lo.x)));
+        t.y0 = std::max(0, int(std::floor(lo.y)));
+        t.x1 = std::min(_width - 1, int(std::ceil(hi.x)));
+        t.y1 = std::min(_height - 1, int(std::ceil(hi.y)));
+        if (t.x0 > t.x1 || t.y0 > t.y1) {
+            return;
+        }
+        std::vector<Triangle> &triangles = _triangles[chunk];
+        const uint32_t index = uint32_t(triangles.size());
+        triangles.push_back(t);
+        for (int ty = t.y0 / tile_size; ty <= t.y1 / tile_size; ++ty) {
+            for (int tx = t.x0 / tile_size; tx <= t.x1 / tile_size; ++tx) {
+                _bins[chunk][size_t(ty) * _tiles_x + tx].push_back(index);
+            }
+        }
+    }
+
+    // each thread sets up a contiguous range of triangles into its own bins,
+    // so walking the bins of every thread in order keeps the draw order
+    inline void setup_triangles(const std::vector<int> &indices) {
+        const size_t chunks = thread_count();
+        const size_t tiles = size_t(_tiles_x) * _tiles_y;
+        _triangles.resize(chunks);
+        _bins.resize(chunks);
+        for (size_t c = 0; c < chunks; ++c) {
+            _triangles[c].clear();
+            _bins[c].resize(tiles);
+            for (auto &bin : _bins[c]) {
+                bin.clear();
+            }
+        }
+        const size_t count = indices.size() / 3;
+        parallel_chunks(count, chunks, [&](const size_t chunk,
+                                           const size_t begin,
+                                           const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                ClipVertex polygon[8] = {_vertices[indices[i * 3]],
+                                         _vertices[indices[i * 3 + 1]],
+                                         _vertices[indices[i * 3 + 2]]};
+                int n = 3;
+                for (int k = 0; k < 3; ++k) {
+                    const glm::vec4 &c = polygon[k].clip;
+                    if (c.w + c.z < 0.f || c.w - c.z < 0.f) {
+                        n = clip_polygon(polygon, 3);
+                        break;
+                    }
+                }
+                for (int k = 1; k + 1 < n; ++k) {
+                    emit(chunk, polygon[0], polygon[k], polygon[k + 1]);
+                }
+            }
+        });
+        _stats.triangles = count;
+        for (const auto &triangles : _triangles) {
+            _stats.binned += triangles.size();
+        }
+    }
+
+    // mesh.frag, one tile per thread at a time
+    inline void rasterize(const int id) {
+        std::fill(_position.begin(), _position.end(), glm::vec3{0.f});
+        std::fill(_normal.begin(), _normal.end(), glm::vec3{0.f});
+        std::fill(_id.begin(), _id.end(), 0.f);
+        std::fill(_depth.begin(), _depth.end(), 1.f);
+        const int tiles = _tiles_x * _tiles_y;
+        std::atomic<int> next{0};
+        parallel_chunks(thread_count(), thread_count(),
+                        [&](size_t, size_t, size_t) {
+                            for (int tile = next++; tile < tiles;
+                                 tile = next++) {
+                                raster_tile(tile, half_float(float(id)));
+                            }
+                        });
+    }
+
+    inline void raster_tile(const int tile, const float id) {
+        const int tx0 = tile % _tiles_x * tile_size;
+        const int ty0 = tile / _tiles_x * tile_size;
+        const int tx1 = std::min(_width - 1, tx0 + tile_size - 1);
+        const int ty1 = std::min(_height - 1, ty0 + tile_size - 1);
+        for (size_t chunk = 0; chunk < _bins.size(); ++chunk) {
+            for (const uint32_t index : _bins[chunk][tile]) {
+                const Triangle &t = _triangles[chunk][index];
+                const int x0 = std::max(t.x0, tx0), x1 = std::min(t.x1, tx1);
+                const int y0 = std::max(t.y0, ty0), y1 = std::min(t.y1, ty1);
+                for (int y = y0; y <= y1; ++y) {
+                    for (int x = x0; x <= x1; ++x) {
+                        const glm::vec2 p{float(x) + 0.5f, float(y) + 0.5f};
+                        float w[3];
+                        bool inside = true;
+                        for (int k = 0; k < 3; ++k) {
+                            w[k] = edge(t.p[(k + 1) % 3], t.p[(k + 2) % 3], p);
+                            inside &= w[k] > 0.f ||
+                                      (w[k] == 0.f && t.top_left[k]);
+                        }
+                        if (!inside) {
+                            continue;
+                        }
+                        const float b0 = w[0] / t.area, b1 = w[1] / t.area,
+                                    b2 = w[2] / t.area;
+                        const float z = b0 * t.z[0] + b1 * t.z[1] + b2 * t.z[2];
+                        const size_t i = size_t(y) * _width + x;
+                        if (!(z < _depth[i])) {
+                            continue;
+                        }
+                        _depth[i] = z;
+                        const float q0 = b0 * t.inv_w[0], q1 = b1 * t.inv_w[1],
+                                    q2 = b2 * t.inv_w[2];
+                        const float s = 1.f / (q0 + q1 + q2);
+                        _position[i] = half_float(
+                            (b0 * t.position[0] + b1 * t.position[1] +
+                             b2 * t.position[2]) *
+                            s);
+                        _normal[i] = half_float((b0 * t.normal[0] +
+                                                 b1 * t.normal[1] +
+                                                 b2 * t.normal[2]) *
+                                                s);
+                        _id[i] = id;
+                    }
+                }
+            }
+        }
+    }
+
+    // screen_xtoon of one row into the frame, which is cleared to 0 where
+    // the shader discards
+    inline void xtoon_row(const int y, const TurnTableCamera &camera,
+                          const SoftImage &tonemap,
+                          const SoftRenderParams &params) {
+        const glm::vec3 camera_pos = camera.get_position();
+        const glm::vec3 camera_dir = camera.get_direction();
+        const glm::vec2 screen_size{float(_width), float(_height)};
+        auto sample_tonemap = [&](const float s, const float t) {
+            if (tonemap.rgba.empty()) {
+                return glm::vec4{0.f};
+            }
+            const unsigned char *c =
+                tonemap.rgba.data() +
+                (size_t(texel(t, tonemap.height)) * tonemap.width +
+                 texel(s, tonemap.width)) *
+                    4;
+            return glm::vec4{float(c[0]), float(c[1]), float(c[2]),
+                             float(c[3])} /
+                   255.f;
+        };
+        for (int x = 0; x < _width; ++x) {
+            const size_t i = size_t(y) * _width + x;
+            // weighted sum the edge detection of the outline convolves, made
+            // once per pixel instead of once per tap
+            _edge_value[i] =
+                glm::vec3(float(int(_id[i])) * float(params.outline_id_fac)) +
+                _position[i] * params.outline_position_fac +
+                _normal[i] * params.outline_normal_fac;
+            glm::vec4 &color = _frame[i];
+            color = glm::vec4{0.f};
+            if (int(_id[i]) != params.id) {
+                continue;
+            }
+            const glm::vec3 &position = _position[i];
+            const glm::vec3 &normal = _normal[i];
+            float nl = glm::dot(normal, params.light_dir);
+            if (params.nl_halftone) {
+                const glm::vec2 frag_coord{float(x) + 0.5f, float(y) + 0.5f};
+                const glm::vec2 center =
+                    dot_center(frag_coord, params.halftone_rotation,
+                               params.halftone_dot_size);
+                const float d_nl = glm::distance(frag_coord, center) *
+                                   std::sqrt(2.f) / params.halftone_dot_size;
+                const float v_nl =
+                    glm::dot(_normal[sample_index(center / screen_size)],
+                             params.light_dir);
+                nl *= float(d_nl < v_nl);
+            }
+            float d = 0.f;
+            if (params.detail_mapping == 0) { // LOA
+                const float z = glm::dot(glm::normalize(camera_dir),
+                                         position - camera_pos);
+                const float z_min = params.dbam_z_min;
+                const float z_max = params.dbam_z_min * params.dbam_r;
+                d = 1.f - std::log(z / z_min) / std::log(z_max / z_min);
+            } else if (params.detail_mapping == 1) { // depth-of-field
+                const float z = glm::length(position - camera_pos);
+                if (z < params.dof_z_c) {
+                    const float z_min = params.dof_z_c - params.dbam_z_min;
+                    const float z_max =
+                        params.dof_z_c - params.dbam_r * params.dbam_z_min;
+                    d = 1.f - std::log(z / z_min) / std::log(z_max / z_min);
+                } else {
+                    const float z_min = params.dof_z_c + params.dbam_z_min;
+                    const float z_max =
+                        params.dof_z_c + params.dbam_r * params.dbam_z_min;
+                    d = std::log(z / z_max) / std::log(z_min / z_max);
+                }
+            } else if (params.detail_mapping == 2) { // near-silhouette
+                d = std::pow(std::abs(glm::dot(normal, camera_dir)),
+                             params.near_silhouette_r);
+            } else if (params.detail_mapping == 3) { // specular highlights
+                const glm::vec3 reflected =
+                    2.f * glm::dot(params.light_dir, normal) * normal -
+                    params.light_dir;
+                d = std::pow(std::abs(glm::dot(camera_dir, reflected)),
+                             params.specular_s);
+            } else {
+                continue;
+            }
+            // textures are flipped vertically
+            const glm::vec4 c = sample_tonemap(nl, 1.f - d);
+            color = {half_float(c.x), half_float(c.y), half_float(c.z),
+                     half_float(c.w)};
+        }
+    }
+
+    // screen_pp over the background, then screen_outline blended on top,
+    // into the rgba8 output
+    inline void composite_row(const int y, const TurnTableCamera &camera,
+                              const SoftRenderParams &params) {
+        const glm::vec3 camera_dir = camera.get_direction();
+        const glm::vec2 screen_size{float(_width), float(_height)};
+        auto cmyk = [](const glm::vec4 &rgb) {
+            const float k = 1.f - std::max(rgb.x, std::max(rgb.y, rgb.z));
+            return glm::vec4{(1.f - rgb.x - k) / (1.f - k),
+                             (1.f - rgb.y - k) / (1.f - k),
+                             (1.f - rgb.z - k) / (1.f - k), k};
+        };
+        auto soft_threshold = [](const float value, const float threshold) {
+            const float v = threshold - value;
+            if (v < -1.f) {
+                return 0.f;
+            }
+            if (v > 0.f) {
+                return 1.f;
+            }
+            return v + 1.f;
+        };
+        // weighted id, position and normal of the pixel at offset
+        const glm::vec3 *rows[3] = {
+            _edge_value.data() + size_t(std::min(y + 1, _height - 1)) * _width,
+            _edge_value.data() + size_t(y) * _width,
+            _edge_value.data() + size_t(std::max(y - 1, 0)) * _width};
+        auto outline_sample = [&](const int x, const int dx, const int dy) {
+            return rows[dy + 1][std::clamp(x - dx, 0, _width - 1)];
+        };
+        for (int x = 0; x < _width; ++x) {
+            const size_t i = size_t(y) * _width + x;
+            const bool covered = int(_id[i]) == params.id;
+            glm::vec4 color = params.background;
+            if (covered && params.pp_effect == 0) {
+                color = _frame[i];
+            } else if (covered && params.pp_effect == 1) {
+                const glm::vec2 frag_coord{float(x) + 0.5f, float(y) + 0.5f};
+                const float rotations[4] = {params.rotation_c,
+                                            params.rotation_m,
+                                            params.rotation_y,
+                                            params.rotation_k};
+                const glm::vec3 inks[4] = {
+                    {1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.f, 0.f, 1.f}, {1.f}};
+                glm::vec3 mixed{1.f};
+                for (int layer = 0; layer < 4; ++layer) {
+                    const glm::vec2 center = dot_center(
+                        frag_coord, rotations[layer], params.dot_size);
+                    const float v =
+                        cmyk(_frame[sample_index(center / screen_size)])[layer];
+                    mixed *= glm::vec3(1.f) -
+                             inks[layer] *
+                                 soft_threshold(
+                                     glm::distance(frag_coord, center),
+                                     v / std::sqrt(2.f) * params.dot_size);
+                }
+                color = glm::vec4(mixed, 1.f);
+            }
+
+            // outline, blended with the source alpha
+            bool outline = false;
+            float alpha = 1.f;
+            if (params.outline_type == 1 && covered) {
+                outline = std::abs(glm::dot(_normal[i], camera_dir)) <
+                          params.outline_thr;
+            } else if (params.outline_type == 2 || params.outline_type == 3) {
+                glm::vec3 horizontal{0.f}, vertical{0.f};
+                if (params.outline_type == 2) { // roberts cross
+                    horizontal = outline_sample(x, -1, -1) -
+                                 outline_sample(x, 1, 1);
+                    vertical = outline_sample(x, -1, 1) -
+                               outline_sample(x, 1, -1);
+                } else { // sobel
+                    const glm::vec3 s00 = outline_sample(x, -1, -1),
+                                    s01 = outline_sample(x, -1, 0),
+                                    s02 = outline_sample(x, -1, 1),
+                                    s10 = outline_sample(x, 0, -1),
+                                    s12 = outline_sample(x, 0, 1),
+                                    s20 = outline_sample(x, 1, -1),
+                                    s21 = outline_sample(x, 1, 0),
+                                    s22 = outline_sample(x, 1, 1);
+                    horizontal = s00 - s02 + 2.f * s10 - 2.f * s12 + s20 - s22;
+                    vertical = s00 + 2.f * s01 + s02 - s20 - 2.f * s21 - s22;
+                }
+                const float edge_value =
+                    std::sqrt(glm::dot(horizontal, horizontal) +
+                              glm::dot(vertical, vertical));
+                outline = edge_value > 1.f - params.outline_thr;
+                alpha = params.outline_edge_fac;
+            }
+            if (outline) {
+                color = {params.outline_col * alpha +
+                             glm::vec3(color) * (1.f - alpha),
+                         alpha * alpha + color.w * (1.f - alpha)};
+            }
+            unsigned char *out = _rgba.data() + i * 4;
+            out[0] = unorm8(color.x);
+            out[1] = unorm8(color.y);
+            out[2] = unorm8(color.z);
+            out[3] = unorm8(color.w);
+        }
+    }
+
+    int _width = 0, _height = 0, _tiles_x = 0, _tiles_y = 0;
+    std::vector<ClipVertex> _vertices;
+    // triangles and the tiles they touch, per setup thread
+    std::vector<std::vector<Triangle>> _triangles;
+    std::vector<std::vector<std::vector<uint32_t>>> _bins;
+    // g-buffer of the mesh pass, rows bottom-up like the gl textures
+    std::vector<glm::vec3> _position, _normal;
+    std::vector<float> _id, _depth;
+    // output of the xtoon pass
+    std::vector<glm::vec4> _frame;
+    std::vector<glm::vec3> _edge_value;
+    std::vector<unsigned char> _rgba;
+    SoftRenderStats _stats;
+};
+} // namespace xtr
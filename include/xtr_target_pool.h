@@ -0,0 +1,142 @@
+// pool of render targets, bucketed by size class
+// targets are allocated at the size of their class, the screen size rounded
+// up to a multiple of 256 pixels, and drawn into a viewport in their lower
+// left corner. a resize within the class reallocates nothing. textures get
+// immutable storage where the context has it, so another class takes new
+// textures, and the released ones are kept for the way back
+#pragma once
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <xtr_framebuffer.h>
+#include <xtr_texture.h>
+
+namespace xtr {
+class TargetPool {
+  public:
+    static constexpr int granularity = 256;
+
+    // the allocated size of targets for a width x height screen
+    static inline glm::ivec2 size_class(const int width, const int height) {
+        const auto round_up = [](const int size) {
+            return std::max(1, (size + granularity - 1) / granularity) *
+                   granularity;
+        };
+        return {round_up(width), round_up(height)};
+    }
+
+    // a 2d texture of format and size, released before or new
+    inline Texture texture(const GLenum format, const glm::ivec2 &size,
+                           const std::string &owner) {
+        for (auto it = _textures.begin(); it != _textures.end(); ++it) {
+            if (it->format == format && it->size == size) {
+                Texture texture = std::move(it->target);
+                _textures.erase(it);
+                texture.label(owner);
+                ++_reused;
+                return texture;
+            }
+        }
+        Texture texture{GL_TEXTURE_2D};
+        texture.storage_2d(format, size.x, size.y);
+        texture.label(owner);
+        ++_allocated;
+        return texture;
+    }
+    inline Renderbuffer renderbuffer(const GLenum format,
+                                     const glm::ivec2 &size,
+                                     const std::string &owner) {
+        for (auto it = _renderbuffers.begin(); it != _renderbuffers.end();
+             ++it) {
+            if (it->format == format && it->size == size) {
+                Renderbuffer renderbuffer = std::move(it->target);
+                _renderbuffers.erase(it);
+                renderbuffer.label(owner);
+                ++_reused;
+                return renderbuffer;
+            }
+        }
+        Renderbuffer renderbuffer;
+        renderbuffer.storage(format, size.x, size.y);
+        renderbuffer.label(owner);
+        ++_allocated;
+        return renderbuffer;
+    }
+
+    // hand back a target of format and size. only the most recently released
+    // class is kept, older ones are deleted, except for entries of the class
+    // keep that a resize to it is still about to take
+    inline void release(const GLenum format, const glm::ivec2 &size,
+                        Texture &&texture) {
+        release(format, size, std::move(texture), size);
+    }
+    inline void release(const GLenum format, const glm::ivec2 &size,
+                        Texture &&texture, const glm::ivec2 &keep) {
+        texture.label("target pool");
+        trim(_textures, size, keep);
+        _textures.push_back({format, size, std::move(texture)});
+    }
+    inline void release(const GLenum format, const glm::ivec2 &size,
+                        Renderbuffer &&renderbuffer) {
+        release(format, size, std::move(renderbuffer), size);
+    }
+    inline void release(const GLenum format, const glm::ivec2 &size,
+                        Renderbuffer &&renderbuffer, const glm::ivec2 &keep) {
+        renderbuffer.label("target pool");
+        trim(_renderbuffers, size, keep);
+        _renderbuffers.push_back({format, size, std::move(renderbuffer)});
+    }
+
+    // replace target, of format and size from, with one of size to. the
+    // other targets of size to stay pooled for the rest of the resize
+    template <class T>
+    inline void reallocate(T &target, const GLenum format,
+                           const glm::ivec2 &from, const glm::ivec2 &to,
+                           const std::string &owner) {
+        T previous = take(format, to, owner, target);
+        std::swap(target, previous);
+        release(format, from, std::move(previous), to);
+    }
+
+    // targets created and targets taken from the pool, since the start
+    inline size_t allocated() const { return _allocated; }
+    inline size_t reused() const { return _reused; }
+    inline size_t free_count() const {
+        return _textures.size() + _renderbuffers.size();
+    }
+
+  private:
+    template <class T> struct Entry {
+        GLenum format;
+        glm::ivec2 size;
+        T target;
+    };
+
+    template <class T>
+    static inline void trim(std::vector<Entry<T>> &entries,
+                            const glm::ivec2 &size, const glm::ivec2 &keep) {
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [&](const Entry<T> &entry) {
+                                         return entry.size != size &&
+                                                entry.size != keep;
+                                     }),
+                      entries.end());
+    }
+
+    inline Texture take(const GLenum format, const glm::ivec2 &size,
+                        const std::string &owner, const Texture &) {
+        return texture(format, size, owner);
+    }
+    inline Renderbuffer take(const GLenum format, const glm::ivec2 &size,
+                             const std::string &owner, const Renderbuffer &) {
+        return renderbuffer(format, size, owner);
+    }
+
+    std::vector<Entry<Texture>> _textures;
+    std::vector<Entry<Renderbuffer>> _renderbuffers;
+    size_t _allocated = 0, _reused = 0;
+};
+} // namespace xtr
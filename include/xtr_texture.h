@@ -4,36 +4,89 @@
 #include <SDL_image.h>
 #include <filesystem>
 #include <glad/gl.h>
+#include <string>
+#include <utility>
+#include <xtr_gl_state.h>
+#include <xtr_gpu_memory.h>
 
 namespace xtr {
 class Texture {
   public:
     Texture(GLenum target, const bool is_repeat = false,
             const bool is_linear = false)
-        : _target{target} {
-        glGenTextures(1, &_texture);
-        bind();
-        glTexParameteri(_target, GL_TEXTURE_WRAP_S,
-                        is_repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
-        glTexParameteri(_target, GL_TEXTURE_WRAP_T,
-                        is_repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
-        glTexParameteri(_target, GL_TEXTURE_MIN_FILTER,
-                        is_linear ? GL_LINEAR : GL_NEAREST);
-        glTexParameteri(_target, GL_TEXTURE_MAG_FILTER,
-                        is_linear ? GL_LINEAR : GL_NEAREST);
-        unbind();
+        : _target{target}, _texture{gl_state().create_texture(target)} {
+        GLState &state = gl_state();
+        state.texture_parameter(_target, _texture, GL_TEXTURE_WRAP_S,
+                                is_repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+        state.texture_parameter(_target, _texture, GL_TEXTURE_WRAP_T,
+                                is_repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+        state.texture_parameter(_target, _texture, GL_TEXTURE_MIN_FILTER,
+                                is_linear ? GL_LINEAR : GL_NEAREST);
+        state.texture_parameter(_target, _texture, GL_TEXTURE_MAG_FILTER,
+                                is_linear ? GL_LINEAR : GL_NEAREST);
+        gpu_memory().add(GpuKind::Texture, _texture, GpuCategory::Texture);
     }
-    Texture(Texture &&o) : _texture{o._texture} {};
+    // a moved-from texture owns nothing, or what the assigned-to one had
+    Texture(Texture &&o)
+        : _target{o._target}, _texture{std::exchange(o._texture, 0)} {};
     Texture(const Texture &) = delete;
     Texture &operator=(Texture &&o) {
-        _texture = o._texture;
+        std::swap(_target, o._target);
+        std::swap(_texture, o._texture);
         return *this;
     };
     Texture &operator=(const Texture &) = delete;
-    ~Texture() { glDeleteTextures(1, &_texture); }
+    ~Texture() {
+        if (_texture) {
+            gl_state().forget_texture(_texture);
+            gpu_memory().remove(GpuKind::Texture, _texture);
+            glDeleteTextures(1, &_texture);
+        }
+    }
 
-    inline void bind() const { glBindTexture(_target, _texture); }
-    inline void unbind() const { glBindTexture(_target, 0); }
+    // name the owner in the gpu memory report
+    inline void label(const std::string &owner) const {
+        gpu_memory().set_owner(GpuKind::Texture, _texture, owner);
+    }
+
+    // bind to the active texture unit
+    inline void bind() const { gl_state().bind_texture(_target, _texture); }
+    inline void unbind() const { gl_state().bind_texture(_target, 0); }
+    // bind to texture unit, the active unit may change
+    inline void bind_unit(GLuint unit) const {
+        gl_state().bind_texture_unit(unit, _target, _texture);
+    }
+
+    // (re)allocate level 0 and fill it from pixels, when given. mutable
+    // storage has no dsa equivalent, so this binds to the active unit
+    inline void image_2d(GLint internal_format, GLsizei width, GLsizei height,
+                         GLenum format, GLenum type,
+                         const void *pixels = nullptr) const {
+        bind();
+        glTexImage2D(_target, 0, internal_format, width, height, 0, format,
+                     type, pixels);
+        gpu_memory().resize(GpuKind::Texture, _texture,
+                            size_t(width) * size_t(height) *
+                                gpu_texel_bytes(GLenum(internal_format)),
+                            GLenum(internal_format), width, height);
+    }
+
+    // allocate level 0 once. the storage is immutable where the context has
+    // texture storage, so another size takes another texture. without it,
+    // this falls back to mutable storage of the same format
+    inline void storage_2d(GLenum internal_format, GLsizei width,
+                           GLsizei height) const {
+        if (!gl_state().texture_storage_2d(_target, _texture, internal_format,
+                                           width, height)) {
+            const auto [format, type] = transfer_format(internal_format);
+            image_2d(GLint(internal_format), width, height, format, type);
+            return;
+        }
+        gpu_memory().resize(GpuKind::Texture, _texture,
+                            size_t(width) * size_t(height) *
+                                gpu_texel_bytes(internal_format),
+                            internal_format, width, height);
+    }
 
     inline const GLenum target() const { return _target; }
     inline operator GLuint() const { return _texture; }
@@ -42,12 +95,10 @@ class Texture {
     inline void load_surface(const SDL_Surface &surface,
                              const bool is_repeat = false,
                              const bool is_linear = false) {
-        bind();
         SDL_Surface *rgba_surface = SDL_ConvertSurfaceFormat(
             (SDL_Surface *)(&surface), SDL_PIXELFORMAT_RGBA32, 0);
-        glTexImage2D(_target, 0, GL_RGBA, rgba_surface->w, rgba_surface->h, 0,
-                     GL_RGBA, GL_UNSIGNED_BYTE, rgba_surface->pixels);
-        unbind();
+        image_2d(GL_RGBA, rgba_surface->w, rgba_surface->h, GL_RGBA,
+                 GL_UNSIGNED_BYTE, rgba_surface->pixels);
     }
 
     // load texture from file
@@ -60,6 +111,30 @@ class Texture {
     }
 
   private:
+    // a pixel format and type that mutable storage of a sized format accepts
+    static inline std::pair<GLenum, GLenum>
+    transfer_format(const GLenum internal_format) {
+        switch (internal_format) {
+        case GL_R8:
+            return {GL_RED, GL_UNSIGNED_BYTE};
+        case GL_R16F:
+        case GL_R32F:
+            return {GL_RED, GL_FLOAT};
+        case GL_RGB8:
+            return {GL_RGB, GL_UNSIGNED_BYTE};
+        case GL_RGB16F:
+        case GL_RGB32F:
+            return {GL_RGB, GL_FLOAT};
+        case GL_RGBA16F:
+        case GL_RGBA32F:
+            return {GL_RGBA, GL_FLOAT};
+        case GL_RGBA32UI:
+            return {GL_RGBA_INTEGER, GL_UNSIGNED_INT};
+        default:
+            return {GL_RGBA, GL_UNSIGNED_BYTE};
+        }
+    }
+
     GLenum _target;
     GLuint _texture;
 };
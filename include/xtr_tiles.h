@@ -0,0 +1,91 @@
+// classification of screen tiles by mesh coverage
+// a pass draws one fragment per tile of the id buffer and marks the tiles
+// any pixel of the mesh falls in. screen passes drawn with draw_tiles then
+// skip the quads of tiles away from the mesh, so their cost follows the
+// covered part of the screen instead of all of it. this works for any
+// target, the window included, where the stencil of the mesh pass is not
+// available
+#pragma once
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <xtr_framebuffer.h>
+#include <xtr_screen_pass.h>
+#include <xtr_shader.h>
+#include <xtr_target_pool.h>
+#include <xtr_texture.h>
+
+namespace xtr {
+class ScreenTiles {
+  public:
+    static constexpr int tile_size = 16;
+
+    ScreenTiles()
+        : _classify_pass{"./data/shaders/tile_classify.frag"},
+          _coverage{GL_TEXTURE_2D} {
+        resize(1, 1);
+    }
+
+    // classify the tiles of a width x height screen whose ids are bound to
+    // id_unit. leaves the coverage framebuffer bound
+    inline void classify(const int width, const int height, const int id_unit,
+                         const int id) {
+        _screen = {width, height};
+        resize((width + tile_size - 1) / tile_size,
+               (height + tile_size - 1) / tile_size);
+        _framebuffer.bind();
+        glViewport(0, 0, _tiles.x, _tiles.y);
+        const Program &program = _classify_pass.get_program();
+        program.use();
+        program.uni_2i(program.loc("uni_screen_size"), width, height);
+        program.uni_1i(program.loc("uni_tile_size"), tile_size);
+        program.uni_1i(program.loc("uni_id_map"), id_unit);
+        program.uni_1i(program.loc("uni_id"), id);
+        glDisable(GL_DEPTH_TEST);
+        _classify_pass.draw();
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // set the tile uniforms of program, which uses screen_tiles.vert, with
+    // the coverage bound to unit, for the screen last classified. tiles
+    // within dilate tiles of a covered one are drawn, all of them when
+    // dilate is negative
+    inline void bind(const Program &program, const int unit,
+                     const int dilate) const {
+        _coverage.bind_unit(unit);
+        program.use();
+        program.uni_1i(program.loc("uni_tile_coverage"), unit);
+        program.uni_2i(program.loc("uni_tiles"), _tiles.x, _tiles.y);
+        program.uni_1i(program.loc("uni_tile_size"), tile_size);
+        program.uni_2f(program.loc("uni_viewport_size"), float(_screen.x),
+                       float(_screen.y));
+        program.uni_1i(program.loc("uni_dilate"), dilate);
+    }
+
+    // the number of tiles, the instances of draw_tiles
+    inline GLsizei count() const { return GLsizei(_tiles.x * _tiles.y); }
+    inline const glm::ivec2 &tiles() const { return _tiles; }
+
+  private:
+    // fit the coverage to a number of tiles, sized by the size class of the
+    // screen like the other render targets
+    inline void resize(const int x, const int y) {
+        _tiles = {x, y};
+        const glm::ivec2 screen =
+            TargetPool::size_class(x * tile_size, y * tile_size);
+        const glm::ivec2 extent{screen.x / tile_size, screen.y / tile_size};
+        if (extent == _extent) {
+            return;
+        }
+        _extent = extent;
+        _coverage = Texture{GL_TEXTURE_2D};
+        _coverage.label("screen tile coverage");
+        _coverage.storage_2d(GL_R8, extent.x, extent.y);
+        _framebuffer.attach_texture(GL_COLOR_ATTACHMENT0, _coverage);
+    }
+
+    ScreenPass _classify_pass;
+    Texture _coverage;
+    Framebuffer _framebuffer;
+    glm::ivec2 _screen{1, 1}, _tiles{0, 0}, _extent{0, 0};
+};
+} // namespace xtr
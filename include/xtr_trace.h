@@ -0,0 +1,369 @@
+// timeline tracing of cpu and gpu spans, dumped as chrome trace json that
+// chrome://tracing and perfetto open
+// - each thread writes its spans into its own ring, with no locking
+// - gpu spans are timed with timestamp queries and moved onto the cpu clock
+// - the rings always hold the last few seconds, so a hitch can be dumped
+//   after it happened
+// XTR_TRACE_SCOPE(name) times the enclosing scope on the calling thread,
+// XTR_TRACE_GPU(name) also times the gl commands issued in it. names must be
+// string literals. defining XTR_NO_TRACE compiles both away
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <glad/gl.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xtr {
+// a finished span, times are in ns since the tracer started
+struct TraceEvent {
+    const char *name;
+    int64_t begin, end;
+};
+
+class Tracer {
+  public:
+    // events kept per thread, the oldest are overwritten. about 15 s of the
+    // main thread at 60 fps
+    static constexpr size_t ring_size = size_t(1) << 14;
+
+    Tracer() : _epoch{std::chrono::steady_clock::now()} {}
+
+    std::atomic<bool> enabled{true};
+
+    inline int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - _epoch)
+            .count();
+    }
+
+    // record a span of the calling thread
+    inline void add(const char *name, const int64_t begin, const int64_t end) {
+        thread_ring().push({name, begin, end});
+    }
+
+    // name the calling thread in the timeline
+    inline void name_thread(const std::string &name) {
+        Ring &ring = thread_ring();
+        std::lock_guard lock{_mutex};
+        ring.name = name;
+    }
+
+    // spans of the gpu, already on the cpu clock, only from the gl thread
+    inline void add_gpu(const char *name, const int64_t begin,
+                        const int64_t end) {
+        if (!_gpu) {
+            std::lock_guard lock{_mutex};
+            _rings.push_back(std::make_unique<Ring>());
+            _gpu = _rings.back().get();
+            _gpu->name = "GPU";
+            _gpu->id = int(_rings.size());
+        }
+        _gpu->push({name, begin, end});
+    }
+
+    // gpu spans that ended at or after since, oldest first
+    inline std::vector<TraceEvent> gpu_events(const int64_t since) {
+        std::lock_guard lock{_mutex};
+        std::vector<TraceEvent> events;
+        if (_gpu) {
+            for (const TraceEvent &event : _gpu->snapshot()) {
+                if (event.end >= since) {
+                    events.push_back(event);
+                }
+            }
+        }
+        return events;
+    }
+
+    // write the spans that ended in the last seconds as chrome trace json
+    inline bool write_chrome_trace(const std::string &path,
+                                   const double seconds) {
+        const int64_t since = now() - int64_t(seconds * 1e9);
+        std::ofstream file{path};
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        std::lock_guard lock{_mutex};
+        for (const auto &ring : _rings) {
+            file << (first ? "" : ",\n")
+                 << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 << "\"tid\":" << ring->id << ",\"args\":{\"name\":\""
+                 << (ring->name.empty() ? "thread " + std::to_string(ring->id)
+                                        : ring->name)
+                 << "\"}}";
+            first = false;
+            for (const TraceEvent &event : ring->snapshot()) {
+                if (event.end < since) {
+                    continue;
+                }
+                file << ",\n{\"name\":\"" << event.name
+                     << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->id
+                     << ",\"ts\":" << double(event.begin) * 1e-3
+                     << ",\"dur\":" << double(event.end - event.begin) * 1e-3
+                     << "}";
+            }
+        }
+        file << "\n]}\n";
+        return bool(file);
+    }
+
+  private:
+    // single writer ring, the dumping thread reads a copy and drops whatever
+    // the writer may have overwritten while it was copying
+    struct Ring {
+        std::vector<TraceEvent> events = std::vector<TraceEvent>(ring_size);
+        std::atomic<uint64_t> head{0};
+        std::string name;
+        int id = 0;
+        bool retired = false;
+
+        inline void push(const TraceEvent &event) {
+            const uint64_t h = head.load(std::memory_order_relaxed);
+            events[h % ring_size] = event;
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        inline std::vector<TraceEvent> snapshot() const {
+            const uint64_t end = head.load(std::memory_order_acquire);
+            const uint64_t begin = end > ring_size ? end - ring_size : 0;
+            std::vector<TraceEvent> copy;
+            copy.reserve(size_t(end - begin));
+            for (uint64_t i = begin; i < end; ++i) {
+                copy.push_back(events[i % ring_size]);
+            }
+            const uint64_t after = head.load(std::memory_order_acquire);
+            const uint64_t valid = after > ring_size ? after - ring_size : 0;
+            if (valid > begin) {
+                copy.erase(copy.begin(),
+                           copy.begin() +
+                               std::ptrdiff_t(std::min(valid, end) - begin));
+            }
+            return copy;
+        }
+    };
+
+    // rings outlive their threads, so spans of finished loaders remain. a
+    // new thread takes over the ring of a finished one, if any
+    inline Ring &thread_ring() {
+        struct Owner {
+            Tracer *tracer = nullptr;
+            Ring *ring = nullptr;
+            ~Owner() {
+                if (ring) {
+                    std::lock_guard lock{tracer->_mutex};
+                    ring->retired = true;
+                }
+            }
+        };
+        thread_local Owner owner;
+        if (!owner.ring) {
+            owner.tracer = this;
+            std::lock_guard lock{_mutex};
+            for (const auto &ring : _rings) {
+                if (ring->retired) {
+                    owner.ring = ring.get();
+                    owner.ring->retired = false;
+                    break;
+                }
+            }
+            if (!owner.ring) {
+                _rings.push_back(std::make_unique<Ring>());
+                owner.ring = _rings.back().get();
+                owner.ring->id = int(_rings.size());
+            }
+        }
+        return *owner.ring;
+    }
+
+    std::chrono::steady_clock::time_point _epoch;
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<Ring>> _rings;
+    Ring *_gpu = nullptr;
+};
+
+inline Tracer &tracer() {
+    static Tracer instance;
+    return instance;
+}
+
+// times its own lifetime
+class TraceScope {
+  public:
+    TraceScope(const char *name)
+        : _name{name}, _begin{tracer().enabled ? tracer().now() : -1} {}
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+    ~TraceScope() {
+        if (_begin >= 0) {
+            tracer().add(_name, _begin, tracer().now());
+        }
+    }
+
+  private:
+    const char *_name;
+    int64_t _begin;
+};
+
+// gpu spans from timestamp queries, results are collected a few frames later
+// once available, so timing never stalls the pipeline. gl thread only, the
+// queries go away with the context
+class GpuTracer {
+  public:
+    GpuTracer() = default;
+    GpuTracer(const GpuTracer &) = delete;
+    GpuTracer &operator=(const GpuTracer &) = delete;
+
+    // open a span, spans nest
+    inline void begin(const char *name) {
+        _open.push_back({name, query(), 0});
+        glQueryCounter(_open.back().begin, GL_TIMESTAMP);
+    }
+
+    inline void end() {
+        Span span = _open.back();
+        _open.pop_back();
+        span.end = query();
+        glQueryCounter(span.end, GL_TIMESTAMP);
+        _pending.push_back(span);
+    }
+
+    // once per frame, move finished spans into the tracer
+    inline void collect() {
+        calibrate();
+        while (!_pending.empty()) {
+            const Span &span = _pending.front();
+            GLint available = 0;
+            glGetQueryObjectiv(span.end, GL_QUERY_RESULT_AVAILABLE,
+                               &available);
+            if (!available) {
+                break;
+            }
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(span.begin, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(span.end, GL_QUERY_RESULT, &end);
+            tracer().add_gpu(span.name, int64_t(begin) + _offset,
+                             int64_t(end) + _offset);
+            release(span);
+            _pending.pop_front();
+        }
+    }
+
+  private:
+    struct Span {
+        const char *name;
+        GLuint begin, end;
+    };
+
+    inline GLuint query() {
+        if (_free.empty()) {
+            _free.resize(64);
+            glGenQueries(GLsizei(_free.size()), _free.data());
+        }
+        const GLuint q = _free.back();
+        _free.pop_back();
+        return q;
+    }
+
+    inline void release(const Span &span) {
+        _free.push_back(span.begin);
+        _free.push_back(span.end);
+    }
+
+    // the gpu clock is moved onto the cpu one about once a second, reading
+    // the gpu time does not wait for queued commands
+    inline void calibrate() {
+        const int64_t cpu = tracer().now();
+        if (cpu - _calibrated < 1000000000 && _calibrated > 0) {
+            return;
+        }
+        GLint64 gpu = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpu);
+        _offset = cpu - int64_t(gpu);
+        _calibrated = cpu;
+    }
+
+    std::vector<Span> _open;
+    std::deque<Span> _pending;
+    std::vector<GLuint> _free;
+    int64_t _offset = 0, _calibrated = 0;
+};
+
+inline GpuTracer &gpu_tracer() {
+    static GpuTracer instance;
+    return instance;
+}
+
+// times the gl commands of its lifetime as well as the cpu side
+class GpuTraceScope {
+  public:
+    GpuTraceScope(const char *name) : _cpu{name}, _enabled{tracer().enabled} {
+        if (_enabled) {
+            gpu_tracer().begin(name);
+        }
+    }
+    GpuTraceScope(const GpuTraceScope &) = delete;
+    GpuTraceScope &operator=(const GpuTraceScope &) = delete;
+    ~GpuTraceScope() {
+        if (_enabled) {
+            gpu_tracer().end();
+        }
+    }
+
+  private:
+    TraceScope _cpu;
+    bool _enabled;
+};
+
+// consecutive spans of one scope, each next ends the previous span and begins
+// a new one, the last ends with the scope. for passes that follow each other
+// without a block of their own
+class GpuTracePhases {
+  public:
+    GpuTracePhases() = default;
+    GpuTracePhases(const GpuTracePhases &) = delete;
+    GpuTracePhases &operator=(const GpuTracePhases &) = delete;
+    ~GpuTracePhases() { end(); }
+
+    inline void next(const char *name) {
+#ifndef XTR_NO_TRACE
+        end();
+        if (tracer().enabled) {
+            _name = name;
+            _begin = tracer().now();
+            gpu_tracer().begin(name);
+        }
+#endif
+    }
+
+  private:
+    inline void end() {
+        if (_name) {
+            tracer().add(_name, _begin, tracer().now());
+            gpu_tracer().end();
+            _name = nullptr;
+        }
+    }
+
+    const char *_name = nullptr;
+    int64_t _begin = 0;
+};
+} // namespace xtr
+
+#define XTR_TRACE_CONCAT_(a, b) a##b
+#define XTR_TRACE_CONCAT(a, b) XTR_TRACE_CONCAT_(a, b)
+#ifdef XTR_NO_TRACE
+#define XTR_TRACE_SCOPE(name)
+#define XTR_TRACE_GPU(name)
+#else
+#define XTR_TRACE_SCOPE(name)                                                  \
+    xtr::TraceScope XTR_TRACE_CONCAT(xtr_trace_, __LINE__) { name }
+#define XTR_TRACE_GPU(name)                                                    \
+    xtr::GpuTraceScope XTR_TRACE_CONCAT(xtr_trace_, __LINE__) { name }
+#endif
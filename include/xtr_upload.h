@@ -0,0 +1,213 @@
+// streaming buffer uploads
+// data is copied in chunks into a fixed staging ring, a few MiB per frame,
+// and from there into the destination buffers on the gpu. a region of the
+// ring is only reused once the fence of the frame that filled it signaled, so
+// writing never waits for the gpu and the driver never holds more than the
+// ring on top of the destination buffers
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <xtr_buffer.h>
+#include <xtr_trace.h>
+
+namespace xtr {
+class UploadRing {
+  public:
+    UploadRing(const size_t capacity = size_t(16) << 20,
+               const size_t frame_budget = size_t(8) << 20)
+        : frame_budget{frame_budget}, _buffer{GL_COPY_READ_BUFFER},
+          _capacity{capacity} {
+        _buffer.label("upload ring");
+        _buffer.bind();
+        _buffer.storage(GLsizeiptr(_capacity), nullptr, GL_MAP_WRITE_BIT,
+                        GL_STREAM_DRAW);
+        _buffer.unbind();
+    }
+    UploadRing(const UploadRing &) = delete;
+    UploadRing &operator=(const UploadRing &) = delete;
+    ~UploadRing() {
+        for (auto &region : _regions) {
+            glDeleteSync(region.fence);
+        }
+    }
+
+    // queue size bytes of data to be copied into buffer at offset. keep_alive
+    // owns data until the last chunk is written. returns a ticket for
+    // finished
+    inline size_t enqueue(const GLuint buffer, const GLintptr offset,
+                          const void *data, const size_t size,
+                          std::shared_ptr<const void> keep_alive) {
+        if (size == 0) {
+            // nothing to copy, done along with everything queued before
+            return _last_ticket;
+        }
+        _jobs.push_back({buffer, offset, static_cast<const std::byte *>(data),
+                         size, 0, ++_last_ticket, std::move(keep_alive)});
+        _queued_bytes += size;
+        return _last_ticket;
+    }
+
+    // drop everything still queued for buffer, chunks already copied stay
+    inline void cancel(const GLuint buffer) {
+        for (auto it = _jobs.begin(); it != _jobs.end();) {
+            if (it->buffer == buffer) {
+                _queued_bytes -= it->size - it->done;
+                it = _jobs.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // once per frame, copy up to frame_budget bytes of the queue. a job is
+    // finished once all its copies are issued, later draws see its data
+    inline void pump() {
+        XTR_TRACE_SCOPE("upload pump");
+        retire();
+        _frame_bytes = 0;
+        size_t fenced = 0;
+        _buffer.bind();
+        while (!_jobs.empty() && _frame_bytes < frame_budget) {
+            Job &job = _jobs.front();
+            const size_t wanted = std::min(job.size - job.done,
+                                           frame_budget - _frame_bytes);
+            const size_t span = reserve(wanted, fenced);
+            if (span == 0) {
+                // the ring is full of copies the gpu has not done yet
+                ++_stalls;
+                break;
+            }
+            void *p = glMapBufferRange(GL_COPY_READ_BUFFER, GLintptr(_head),
+                                       GLsizeiptr(span),
+                                       GL_MAP_WRITE_BIT |
+                                           GL_MAP_INVALIDATE_RANGE_BIT |
+                                           GL_MAP_UNSYNCHRONIZED_BIT);
+            if (!p) {
+                break;
+            }
+            memcpy(p, job.data + job.done, span);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+            gl_state().copy_buffer(_buffer, job.buffer, GLintptr(_head),
+                                   job.offset + GLintptr(job.done),
+                                   GLsizeiptr(span));
+            _head = (_head + span) % _capacity;
+            _used += span;
+            fenced += span;
+            job.done += span;
+            _frame_bytes += span;
+            _queued_bytes -= span;
+            if (job.done == job.size) {
+                _finished_ticket = job.ticket;
+                _jobs.pop_front();
+            }
+        }
+        _buffer.unbind();
+        if (fenced > 0) {
+            _regions.push_back(
+                {fenced, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+        }
+        _total_bytes += _frame_bytes;
+    }
+
+    // issue everything queued at once, waiting for the gpu whenever the ring
+    // is full. for offline rendering where a frame must not miss data
+    inline void flush() {
+        const size_t budget = frame_budget;
+        frame_budget = std::numeric_limits<size_t>::max();
+        while (!_jobs.empty()) {
+            pump();
+            if (_jobs.empty()) {
+                break;
+            }
+            if (_regions.empty()) {
+                // nothing to wait for, the ring cannot be mapped
+                break;
+            }
+            glClientWaitSync(_regions.front().fence,
+                             GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+        }
+        frame_budget = budget;
+    }
+
+    // all copies of the job with ticket are issued
+    inline bool finished(const size_t ticket) const {
+        return _finished_ticket >= ticket;
+    }
+    inline bool idle() const { return _jobs.empty(); }
+
+    inline size_t capacity() const { return _capacity; }
+    inline size_t queued_bytes() const { return _queued_bytes; }
+    inline size_t frame_bytes() const { return _frame_bytes; }
+    inline size_t total_bytes() const { return _total_bytes; }
+    // frames that stopped early because the ring was full
+    inline size_t stalls() const { return _stalls; }
+
+    // bytes copied per frame at most
+    size_t frame_budget;
+
+  private:
+    struct Job {
+        GLuint buffer;
+        GLintptr offset;
+        const std::byte *data;
+        size_t size, done, ticket;
+        std::shared_ptr<const void> keep_alive;
+    };
+    // bytes of the ring filled during one frame, including skipped ends
+    struct Region {
+        size_t bytes;
+        GLsync fence;
+    };
+
+    // free the regions the gpu is done copying from
+    inline void retire() {
+        while (!_regions.empty()) {
+            const GLenum status =
+                glClientWaitSync(_regions.front().fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED &&
+                status != GL_CONDITION_SATISFIED) {
+                break;
+            }
+            glDeleteSync(_regions.front().fence);
+            _used -= _regions.front().bytes;
+            _regions.pop_front();
+        }
+        if (_used == 0) {
+            _head = 0;
+        }
+    }
+
+    // contiguous free bytes at _head, at most wanted. the end of the ring is
+    // skipped when the start has more room, the skipped bytes are counted in
+    // fenced so they are freed with the region
+    inline size_t reserve(const size_t wanted, size_t &fenced) {
+        if (_used == _capacity) {
+            return 0;
+        }
+        const size_t tail = (_head + _capacity - _used) % _capacity;
+        if (_head < tail) {
+            return std::min(wanted, tail - _head);
+        }
+        const size_t end = _capacity - _head;
+        if (end < wanted && tail > end) {
+            _used += end;
+            fenced += end;
+            _head = 0;
+            return std::min(wanted, tail);
+        }
+        return std::min(wanted, end);
+    }
+
+    Buffer _buffer;
+    size_t _capacity, _head = 0, _used = 0;
+    std::deque<Job> _jobs;
+    std::deque<Region> _regions;
+    size_t _last_ticket = 0, _finished_ticket = 0;
+    size_t _queued_bytes = 0, _frame_bytes = 0, _total_bytes = 0;
+    size_t _stalls = 0;
+};
+} // namespace xtr
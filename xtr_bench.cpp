@@ -0,0 +1,355 @@
+// microbenchmark of the mesh loading stages, without a gl context
+// every stage of load_mesh_into is timed on its own over the bundled models
+// and synthetic spheres, reporting the median time, vertices/s and bytes/s of
+// the input it reads, and heap allocations per run, e.g.
+// xtr_bench --iterations 20 --synthetic 1000000 --csv bench.csv
+// --generate adds a generated mesh, e.g. --generate assembly-10M
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <numbers>
+#include <string>
+#include <vector>
+#include <xtr_args.h>
+#include <xtr_obj.h>
+
+// every heap allocation of the process is counted, so a stage can be checked
+// for allocating in its steady state
+static std::atomic<size_t> allocation_count{0};
+
+void *operator new(const size_t size) {
+    ++allocation_count;
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+void *operator new[](const size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+// positions and triangles of a mesh under test
+struct BenchMesh {
+    std::string name;
+    std::filesystem::path ply, obj;
+    std::vector<glm::vec3> positions;
+    std::vector<int> indices;
+};
+
+// one row of the results
+struct BenchResult {
+    std::string mesh, stage;
+    size_t vertices = 0, triangles = 0, bytes = 0, iterations = 0;
+    double median_ms = 0., min_ms = 0.;
+    double allocations = 0.;
+
+    inline double vertices_per_s() const {
+        return median_ms > 0. ? double(vertices) / median_ms * 1e3 : 0.;
+    }
+    inline double bytes_per_s() const {
+        return median_ms > 0. ? double(bytes) / median_ms * 1e3 : 0.;
+    }
+};
+
+// a uv sphere with about vertex_count vertices
+BenchMesh synthetic_sphere(const size_t vertex_count) {
+    const size_t rings = std::max<size_t>(
+        2, size_t(std::sqrt(double(vertex_count) / 2.)));
+    const size_t segments = std::max<size_t>(3, vertex_count / rings);
+    BenchMesh mesh;
+    mesh.name = "sphere " + std::to_string(rings * segments);
+    mesh.positions.reserve(rings * segments);
+    for (size_t r = 0; r < rings; ++r) {
+        const float theta =
+            std::numbers::pi_v<float> * (float(r) + .5f) / float(rings);
+        for (size_t s = 0; s < segments; ++s) {
+            const float phi =
+                2.f * std::numbers::pi_v<float> * float(s) / float(segments);
+            mesh.positions.push_back({std::sin(theta) * std::cos(phi),
+                                      std::cos(theta),
+                                      std::sin(theta) * std::sin(phi)});
+        }
+    }
+    mesh.indices.reserve((rings - 1) * segments * 6);
+    for (size_t r = 0; r + 1 < rings; ++r) {
+        for (size_t s = 0; s < segments; ++s) {
+            const int a = int(r * segments + s);
+            const int b = int(r * segments + (s + 1) % segments);
+            const int c = a + int(segments), d = b + int(segments);
+            mesh.indices.insert(mesh.indices.end(), {a, c, b, b, c, d});
+        }
+    }
+    return mesh;
+}
+
+// the same mesh as a binary ply and a wavefront obj, so every reader can be
+// timed on it
+void write_mesh_files(BenchMesh &mesh, const std::filesystem::path &dir) {
+    std::string stem = mesh.name;
+    std::replace(stem.begin(), stem.end(), ' ', '_');
+    if (mesh.ply.empty()) {
+        mesh.ply = dir / (stem + ".ply");
+        std::ofstream ply{mesh.ply, std::ios::binary};
+        ply << "ply\nformat binary_little_endian 1.0\nelement vertex "
+            << mesh.positions.size()
+            << "\nproperty float x\nproperty float y\nproperty float z\n"
+            << "element face " << mesh.indices.size() / 3
+            << "\nproperty list uchar int vertex_indices\nend_header\n";
+        ply.write(reinterpret_cast<const char *>(mesh.positions.data()),
+                  std::streamsize(mesh.positions.size() * sizeof(glm::vec3)));
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            const unsigned char n = 3;
+            ply.write(reinterpret_cast<const char *>(&n), 1);
+            ply.write(reinterpret_cast<const char *>(&mesh.indices[i]),
+                      3 * sizeof(int));
+        }
+    }
+    mesh.obj = dir / (stem + ".obj");
+    std::ofstream obj{mesh.obj};
+    for (const glm::vec3 &p : mesh.positions) {
+        obj << "v " << p.x << " " << p.y << " " << p.z << "\n";
+    }
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        obj << "f " << mesh.indices[i] + 1 << " " << mesh.indices[i + 1] + 1
+            << " " << mesh.indices[i + 2] + 1 << "\n";
+    }
+}
+
+// a bundled ply, read with the streaming reader
+bool load_bundled(const std::filesystem::path &path, BenchMesh &mesh) {
+    xtr::PlyFile ply{path};
+    if (!ply.valid()) {
+        return false;
+    }
+    mesh.name = path.stem().string();
+    mesh.ply = path;
+    mesh.positions.resize(ply.vertex_count());
+    mesh.indices.resize(ply.triangle_count() * 3);
+    return ply.read_positions(mesh.positions.data(), sizeof(glm::vec3)) &&
+           ply.read_triangles(mesh.indices.data());
+}
+
+class Bench {
+  public:
+    Bench(const size_t iterations) : _iterations{iterations} {}
+
+    // time run, after one untimed run that warms caches and the scratch
+    // arena. setup runs untimed before each run
+    template <class Setup, class Run>
+    inline void measure(const BenchMesh &mesh, const std::string &stage,
+                        const size_t bytes, Setup &&setup, Run &&run) {
+        std::vector<double> times;
+        size_t allocations = 0;
+        for (size_t i = 0; i <= _iterations; ++i) {
+            setup();
+            const size_t before = allocation_count;
+            const auto start = std::chrono::steady_clock::now();
+            run();
+            const auto stop = std::chrono::steady_clock::now();
+            if (i == 0) {
+                continue;
+            }
+            allocations += allocation_count - before;
+            times.push_back(
+                std::chrono::duration<double, std::milli>(stop - start)
+                    .count());
+        }
+        std::sort(times.begin(), times.end());
+        BenchResult result;
+        result.mesh = mesh.name;
+        result.stage = stage;
+        result.vertices = mesh.positions.size();
+        result.triangles = mesh.indices.size() / 3;
+        result.bytes = bytes;
+        result.iterations = _iterations;
+        result.median_ms = times[times.size() / 2];
+        result.min_ms = times.front();
+        result.allocations = double(allocations) / double(_iterations);
+        std::printf("%-16s %-16s %10.3f ms %10.3f ms %9.2f Mv/s %9.2f MiB/s "
+                    "%8.1f allocs\n",
+                    result.mesh.c_str(), result.stage.c_str(),
+                    result.median_ms, result.min_ms,
+                    result.vertices_per_s() * 1e-6,
+                    result.bytes_per_s() / (1024. * 1024.),
+                    result.allocations);
+        _results.push_back(std::move(result));
+    }
+
+    // every stage of the mesh load, the readers on the files and the rest on
+    // the positions in memory
+    inline void run(const BenchMesh &mesh) {
+        const size_t n = mesh.positions.size();
+        const size_t vec_bytes = n * sizeof(glm::vec3);
+        const size_t index_bytes = mesh.indices.size() * sizeof(int);
+        const size_t ply_bytes = std::filesystem::file_size(mesh.ply);
+        const size_t obj_bytes = std::filesystem::file_size(mesh.obj);
+        auto none = []() {};
+
+        measure(mesh, "read obj", obj_bytes, none,
+                [&]() { xtr::load_obj_file(mesh.obj); });
+        measure(mesh, "read ply miniply", ply_bytes, none,
+                [&]() { xtr::load_ply_file(mesh.ply); });
+        std::vector<glm::vec3> ps(n), vns(n), ans(n), tns(n);
+        std::vector<int> indices(mesh.indices.size());
+        measure(mesh, "read ply stream", ply_bytes, none, [&]() {
+            xtr::PlyFile ply{mesh.ply};
+            ply.read_positions(ps.data(), sizeof(glm::vec3));
+            ply.read_triangles(indices.data());
+        });
+
+        xtr::MeshBounds bounds;
+        measure(mesh, "bounds", vec_bytes, none, [&]() {
+            bounds = xtr::mesh_bounds(mesh.positions.data(), n);
+        });
+        measure(
+            mesh, "recenter", vec_bytes,
+            [&]() {
+                std::copy(mesh.positions.begin(), mesh.positions.end(),
+                          ps.begin());
+            },
+            [&]() {
+                xtr::recenter_positions(ps.data(), n, bounds, true, true);
+            });
+        measure(mesh, "normals", vec_bytes + index_bytes, none, [&]() {
+            xtr::vertex_normals(ps.data(), n, mesh.indices.data(),
+                                mesh.indices.size(), vns.data());
+        });
+        measure(mesh, "smooth shape", vec_bytes + index_bytes, none, [&]() {
+            xtr::smooth_normals(vns.data(), n, mesh.indices.data(),
+                                mesh.indices.size(), ans.data(), tns.data());
+        });
+        std::vector<xtr::Vertex> vertices(n);
+        measure(mesh, "assemble", 2 * vec_bytes, none, [&]() {
+            xtr::assemble_vertices(ps.data(), vns.data(), n, vertices.data());
+        });
+        // last of the stages as it compacts the positions
+        std::vector<int> welded_indices;
+        measure(
+            mesh, "weld", vec_bytes + index_bytes,
+            [&]() {
+                std::copy(mesh.positions.begin(), mesh.positions.end(),
+                          ps.begin());
+                xtr::recenter_positions(ps.data(), n, bounds, true, true);
+                welded_indices = mesh.indices;
+            },
+            [&]() {
+                xtr::weld_vertices(ps.data(), nullptr, n, welded_indices,
+                                   1e-5f, 180.f);
+                xtr::scratch_arena().reset();
+            });
+
+        measure(mesh, "load_mesh ply", ply_bytes, none,
+                [&]() { xtr::load_mesh(mesh.ply, true, true, true); });
+        measure(mesh, "load_mesh obj", obj_bytes, none,
+                [&]() { xtr::load_mesh(mesh.obj, true, true, true); });
+    }
+
+    inline bool write_csv(const std::string &path) const {
+        std::ofstream file{path};
+        file << "mesh,stage,vertices,triangles,bytes,iterations,median_ms,"
+                "min_ms,vertices_per_s,bytes_per_s,allocations\n";
+        for (const BenchResult &r : _results) {
+            file << r.mesh << "," << r.stage << "," << r.vertices << ","
+                 << r.triangles << "," << r.bytes << "," << r.iterations << ","
+                 << r.median_ms << "," << r.min_ms << "," << r.vertices_per_s()
+                 << "," << r.bytes_per_s() << "," << r.allocations << "\n";
+        }
+        return bool(file);
+    }
+
+  private:
+    size_t _iterations;
+    std::vector<BenchResult> _results;
+};
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t iterations = 10;
+    std::filesystem::path models = "./data/models";
+    std::vector<size_t> synthetic;
+    std::vector<std::string> generated;
+    std::string csv_path;
+    const xtr::Args args{argc,
+                         argv,
+                         {{"--iterations", 1},
+                          {"--models", 1},
+                          {"--synthetic", 1},
+                          {"--generate", 1},
+                          {"--csv", 1}}};
+    if (!args.ok()) {
+        std::cerr << args.error() << "\n";
+        return 1;
+    }
+    for (const xtr::Arg &arg : args.list()) {
+        const std::string &flag = arg.flag;
+        const char *value = arg.value();
+        if (flag == "--iterations") {
+            iterations = std::max(1, atoi(value));
+        } else if (flag == "--models") {
+            models = value;
+        } else if (flag == "--synthetic") {
+            synthetic.push_back(size_t(std::max(16L, atol(value))));
+        } else if (flag == "--generate") {
+            generated.push_back(value);
+        } else if (flag == "--csv") {
+            csv_path = value;
+        }
+    }
+    if (synthetic.empty() && generated.empty()) {
+        synthetic = {100000, 1000000};
+    }
+
+    const std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "xtr_bench";
+    std::filesystem::create_directories(dir);
+    std::vector<BenchMesh> meshes;
+    for (const char *name : {"Suzanne.ply", "Augustus.ply"}) {
+        BenchMesh mesh;
+        if (load_bundled(models / name, mesh)) {
+            meshes.push_back(std::move(mesh));
+        } else {
+            std::cerr << "Cannot read " << (models / name).string() << "\n";
+        }
+    }
+    for (const size_t count : synthetic) {
+        meshes.push_back(synthetic_sphere(count));
+    }
+    for (const std::string &name : generated) {
+        auto [positions, indices] = xtr::generate_mesh(name + ".gen");
+        if (positions.empty()) {
+            std::cerr << "Cannot generate " << name << "\n";
+            continue;
+        }
+        BenchMesh mesh;
+        mesh.name = name;
+        mesh.positions = std::move(positions);
+        mesh.indices = std::move(indices);
+        meshes.push_back(std::move(mesh));
+    }
+
+    std::printf("%-16s %-16s %13s %13s %14s %15s %15s\n", "mesh", "stage",
+                "median", "min", "vertices", "bytes", "allocations");
+    Bench bench{iterations};
+    for (BenchMesh &mesh : meshes) {
+        write_mesh_files(mesh, dir);
+        bench.run(mesh);
+    }
+    std::filesystem::remove_all(dir);
+    if (!csv_path.empty()) {
+        const bool ok = bench.write_csv(csv_path);
+        std::cout << (ok ? "Wrote " : "Cannot write ") << csv_path << "\n";
+        return ok ? 0 : 1;
+    }
+    return 0;
+}
@@ -1,19 +1,134 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <imgui.h>
+#include <memory>
 #include <numbers>
 #include <optional>
+#include <string>
+#include <tuple>
 #include <xtr_app.h>
+#include <xtr_args.h>
 #include <xtr_buffer.h>
 #include <xtr_camera.h>
+#include <xtr_edges.h>
+#include <xtr_export.h>
+#include <xtr_input_log.h>
+#include <xtr_lights.h>
 #include <xtr_framebuffer.h>
+#include <xtr_frames.h>
+#include <xtr_gpu_memory.h>
 #include <xtr_mesh_pass.h>
+#include <xtr_meshlet.h>
+#include <xtr_points.h>
 #include <xtr_obj.h>
+#include <xtr_regression.h>
 #include <xtr_screen_pass.h>
+#include <xtr_sequence.h>
 #include <xtr_shader.h>
+#include <xtr_soft_render.h>
+#include <xtr_target_pool.h>
 #include <xtr_texture.h>
+#include <xtr_tiles.h>
+#include <xtr_trace.h>
 
 int main(int argc, char *argv[]) {
+    // flags and the number of values they take
+    const xtr::Args args{
+        argc,
+        argv,
+        {{"--headless"},
+         {"--no-dsa"},
+         {"--build-meshlets", 2},
+         {"--build-vertex-cache", 2, 1},
+         {"--soft-render", 2},
+         {"--tonemap", 1},
+         {"--export", 1},
+         {"--format", 1},
+         {"--frames", 1},
+         {"--size", 1},
+         {"--fps", 1},
+         {"--turns", 1},
+         {"--present", 1},
+         {"--weld", 1},
+         {"--weld-angle", 1},
+         {"--generate", 1},
+         {"--frames-in-flight", 1},
+         {"--depth-pre-pass", 1},
+         {"--mesh-cache", 1},
+         {"--meshlet-pool", 1},
+         {"--gpu-memory-csv", 1},
+         {"--trace", 1},
+         {"--trace-seconds", 1},
+         {"--regress", 1},
+         {"--regress-soft", 1},
+         {"--regress-update", 1},
+         {"--regress-csv", 1},
+         {"--regress-out", 1},
+         {"--record", 1},
+         {"--replay", 1}}};
+    if (!args.ok()) {
+        std::cerr << args.error() << "\n";
+        return 1;
+    }
+    // headless runs still need a context, but keep the window hidden
+    const bool headless = args.has("--headless");
+    // converting a mesh into a streamed cluster file needs no window, e.g.
+    // xtr --build-meshlets scan.ply ./data/models/scan.xtrm
+    if (const xtr::Arg *arg = args.find("--build-meshlets")) {
+        const bool ok = xtr::build_meshlets(arg->values[0], arg->values[1],
+                                            false, false);
+        std::cout << (ok ? "Built " : "Cannot build ") << arg->values[1]
+                  << "\n";
+        return ok ? 0 : 1;
+    }
+    // packing a directory of animation frames into a vertex cache, e.g.
+    // xtr --build-vertex-cache ./frames ./data/models/walk.xtrv 30
+    if (const xtr::Arg *arg = args.find("--build-vertex-cache")) {
+        const float fps =
+            arg->values.size() > 2 ? float(atof(arg->values[2].c_str())) : 24.f;
+        const bool ok =
+            xtr::build_vertex_cache(arg->values[0], arg->values[1], false,
+                                    false, fps > 0.f ? fps : 24.f);
+        std::cout << (ok ? "Built " : "Cannot build ") << arg->values[1]
+                  << "\n";
+        return ok ? 0 : 1;
+    }
+    // rendering on the cpu needs no gl context at all, e.g.
+    // xtr --soft-render ./data/models/Suzanne.ply frame.png --size 1920x1080
+    // with the default parameters and --tonemap to pick the tonemap
+    if (const xtr::Arg *arg = args.find("--soft-render")) {
+        int size[2] = {800, 600};
+        std::filesystem::path tonemap_file = "./data/textures/fig-11b.ppm";
+        if (const xtr::Arg *size_arg = args.find("--size")) {
+            sscanf(size_arg->value(), "%dx%d", &size[0], &size[1]);
+        }
+        if (const xtr::Arg *tonemap_arg = args.find("--tonemap")) {
+            tonemap_file = tonemap_arg->value();
+        }
+        xtr::SoftImage tonemap;
+        tonemap.load(tonemap_file);
+        xtr::SoftRenderer renderer{size[0], size[1]};
+        renderer.render(xtr::load_mesh(arg->values[0], true, false, false),
+                        {1.f, 13.f / 24.f * glm::pi<float>(),
+                         glm::pi<float>(), {}},
+                        glm::mat4{1.f}, tonemap, {});
+        const xtr::SoftRenderStats &stats = renderer.stats();
+        std::cout << stats.binned << " of " << stats.triangles
+                  << " triangles binned, vertex " << stats.vertex_ms
+                  << " ms, setup " << stats.setup_ms << " ms, raster "
+                  << stats.raster_ms << " ms, xtoon " << stats.xtoon_ms
+                  << " ms, composite " << stats.composite_ms << " ms\n";
+        const bool ok = xtr::save_png(arg->values[1], renderer.rgba(),
+                                      size[0], size[1]);
+        std::cout << (ok ? "Wrote " : "Cannot write ") << arg->values[1]
+                  << "\n";
+        return ok ? 0 : 1;
+    }
+    // direct state access is used when available, unless --no-dsa
+    const bool dsa = !args.has("--no-dsa");
     // initialize app
-    xtr::App app{800, 600};
+    xtr::App app{800, 600, headless, dsa};
     // enable depth buffer
     glEnable(GL_DEPTH_TEST);
     // enable back face culling
@@ -21,19 +136,34 @@ int main(int argc, char *argv[]) {
     glCullFace(GL_BACK);
     // xtoon shader as a screen pass
     xtr::ScreenPass xtoon_pass{"./data/shaders/screen_xtoon.frag"};
+    // point lights of the xtoon pass, culled per screen tile
+    xtr::TiledLights tiled_lights;
+    // tiles of the screen the mesh covers, the passes drawn into the window
+    // only draw those
+    xtr::ScreenTiles screen_tiles;
     // outline shader
-    xtr::ScreenPass outline_pass{"./data/shaders/screen_outline.frag"};
+    xtr::ScreenPass outline_pass{"./data/shaders/screen_outline.frag",
+                                 "./data/shaders/screen_tiles.vert"};
+    // object space outline, drawn from the edges of the mesh
+    xtr::EdgePass edge_pass;
     // post-processing shader
-    xtr::ScreenPass pp_pass{"./data/shaders/screen_pp.frag"};
+    xtr::ScreenPass pp_pass{"./data/shaders/screen_pp.frag",
+                            "./data/shaders/screen_tiles.vert"};
+    // fences of the frames the gpu has not finished
+    xtr::FramesInFlight frames;
+    // the depth-of-field pick, read back without stalling
+    xtr::PixelReadback pick_readback;
+    // render targets of the screen, allocated by size class
+    xtr::TargetPool target_pool;
     // mesh pass to generate buffers necessary for xtoon and outline shader
-    xtr::MeshPass mesh_pass(app.get_screen_width(), app.get_screen_height());
+    xtr::MeshPass mesh_pass(target_pool, app.get_screen_width(),
+                            app.get_screen_height());
+    // staging ring for streamed buffer uploads
+    xtr::UploadRing upload_ring;
     // initialize camera object
     xtr::TurnTableCamera camera{1.f, 13.f / 24.f * glm::pi<float>(), glm::pi<float>(), {}};
     // default model matrix
     glm::mat4 model_matrix{1.};
-    // default perspective projection matrix
-    glm::mat4 projection_matrix =
-        glm::perspective(glm::half_pi<float>(), 4.f / 3.f, 1e-3f, 1e4f);
 
     // aggregate model file directories into a list
     const std::filesystem::path mesh_directory = "./data/models";
@@ -42,6 +172,16 @@ int main(int argc, char *argv[]) {
          std::filesystem::directory_iterator{mesh_directory}) {
         mesh_files.push_back(file);
     }
+    // generated meshes for scaling tests, --generate adds more
+    for (const xtr::GeneratedSpec &generated :
+         {xtr::GeneratedSpec{xtr::GeneratedShape::Sphere, 10000},
+          xtr::GeneratedSpec{xtr::GeneratedShape::Sphere, 1000000},
+          xtr::GeneratedSpec{xtr::GeneratedShape::Terrain, 1000000},
+          xtr::GeneratedSpec{xtr::GeneratedShape::Assembly, 1000000}}) {
+        mesh_files.push_back(
+            std::filesystem::path{"generated"} /
+            xtr::generated_name(generated.shape, generated.triangles));
+    }
 
     // aggregate tonemap file directories into a list
     const std::filesystem::path texture_directory = "./data/textures";
@@ -52,24 +192,38 @@ int main(int argc, char *argv[]) {
     }
     std::sort(texture_files.begin(), texture_files.end());
 
-    // create framebuffer and included frame texture for post-processing
-    xtr::Texture frame_texture{GL_TEXTURE_2D};
-    frame_texture.bind();
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, app.get_screen_width(),
-                 app.get_screen_height(), 0, GL_RGBA, GL_FLOAT, nullptr);
-    frame_texture.unbind();
-    xtr::Renderbuffer frame_rb;
-    frame_rb.bind();
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT,
-                          app.get_screen_width(), app.get_screen_height());
-    frame_rb.unbind();
+    // create framebuffer and included frame texture for post-processing,
+    // the same size class as the mesh pass buffers. it shares their depth
+    // and stencil, so the xtoon pass only shades the pixels of the mesh
+    glm::ivec2 frame_extent = mesh_pass.extent();
+    xtr::Texture frame_texture =
+        target_pool.texture(GL_RGBA16F, frame_extent, "frame");
     xtr::Framebuffer frame_fb;
-    frame_fb.bind();
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                           frame_texture, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                              GL_RENDERBUFFER, frame_rb);
-    frame_fb.unbind();
+    frame_fb.attach_texture(GL_COLOR_ATTACHMENT0, frame_texture);
+    frame_fb.attach_renderbuffer(GL_DEPTH_STENCIL_ATTACHMENT,
+                                 mesh_pass.depth_stencil());
+
+    // fit all the screen buffers to width x height, which only replaces them
+    // when the size class changes
+    auto resize_targets = [&](const int width, const int height) {
+        const glm::ivec2 extent = xtr::TargetPool::size_class(width, height);
+        if (extent == frame_extent) {
+            return;
+        }
+        XTR_TRACE_SCOPE("resize targets");
+        mesh_pass.resize(width, height);
+        target_pool.reallocate(frame_texture, GL_RGBA16F, frame_extent, extent,
+                               "frame");
+        frame_extent = extent;
+        frame_fb.attach_texture(GL_COLOR_ATTACHMENT0, frame_texture);
+        frame_fb.attach_renderbuffer(GL_DEPTH_STENCIL_ATTACHMENT,
+                                     mesh_pass.depth_stencil());
+    };
+    // a window resize replaces the targets once the size held still for
+    // this many frames, until then the frame is drawn into the part of the
+    // window the current targets cover
+    const int resize_settle_frames = 10;
+    int resize_wait = 0;
 
     // model selection
     int selected_mesh = 0;
@@ -77,15 +231,16 @@ int main(int argc, char *argv[]) {
     bool mesh_y_up = false;
     // is x the front facing direction
     bool mesh_x_front = false;
-    // Load default model
-    mesh_pass.upload_mesh(xtr::load_mesh(mesh_files[0], 0, mesh_y_up, mesh_x_front));
+    // merge the split vertices along seams
+    xtr::WeldOptions mesh_weld;
 
     // tonemap selection
     int selected_texture = 3;
     // Set up tonemap texture object
     xtr::Texture tonemap_texture{GL_TEXTURE_2D};
-    // Load default tonemap texture
-    tonemap_texture.load_file(texture_files[selected_texture]);
+    tonemap_texture.label("tonemap");
+    // tonemap currently loaded, reloaded whenever the selection changes
+    int loaded_texture = -1;
 
     // detail mapping selection
     const char *detail_mappings[] = {"LOA", "Depth-of-field", "Near-silhouette",
@@ -99,22 +254,30 @@ int main(int argc, char *argv[]) {
 
     // outline options
     const char *outline_types[] = {"Off", "Near-silhouette", "Roberts Cross",
-                                   "Sobel"};
+                                   "Sobel", "Object Space"};
     int outline_type = 3;
 
     // outline parameters
-    float outline_col[3];
+    float outline_col[3] = {0.f, 0.f, 0.f};
     float outline_thr = 0.4f;
     bool outline_id_fac = true; // use id to get object outline
     // edge difference contribution
     float outline_normal_fac = 0.f;
     float outline_position_fac = 1.f;
     float outline_edge_fac = 1.f;
+    // object space outline, line width in pixels and the angle between two
+    // triangles above which their edge is a crease
+    float outline_width = 2.f;
+    float outline_crease_angle = 60.f;
 
     // Depth-based attribute mapping
     float dbam_z_min = 0.5f;
     float dbam_r = 5.f;
     glm::vec3 dof_c = {};
+    // frames the gpu may be behind the cpu by
+    int frames_in_flight = 2;
+    // screen passes skip the pixels away from the mesh
+    bool screen_culling = true;
 
     // Near-silhouette
     float near_silhouette_r = 0.;
@@ -128,9 +291,65 @@ int main(int argc, char *argv[]) {
     int abstracted_shape = 0;
     float normal_factor = 0.;
 
+    // mesh currently uploaded, the mesh is reloaded whenever the selection
+    // no longer matches it. only the smooth shape is generated on load, the
+    // other shapes are analytic and switch without a reload
+    auto mesh_selection = [&]() {
+        return std::make_tuple(selected_mesh, mesh_y_up, mesh_x_front,
+                               mesh_weld);
+    };
+    std::tuple<int, bool, bool, xtr::WeldOptions> loaded_mesh{-1, false,
+                                                              false, {}};
+    bool loaded_smooth = false;
+    // how a loaded mesh reaches the gpu
+    // - streamed in chunks over the next frames, the old mesh stays visible
+    // - written straight into a mapped vertex buffer while loading
+    // - uploaded at once with glBufferData
+    const char *upload_modes[] = {"Streamed", "Mapped", "Blocking"};
+    int upload_mode = 0;
+    int upload_budget_mb = 8;
+    xtr::MeshLoadStats mesh_stats;
+    // gpu memory for meshes kept resident after another one is selected
+    int mesh_cache_mb = 512;
+    // depth pre-pass of the mesh pass, as MeshPass::PrePass, and the
+    // overdraw above which auto turns it on
+    const char *pre_pass_modes[] = {"Off", "On", "Auto"};
+    int pre_pass_mode = 2;
+    float pre_pass_threshold = 1.5f;
+    // what a loaded mesh is kept under, everything that changes its buffers
+    auto mesh_cache_key = [&](const bool smooth) {
+        return mesh_files[selected_mesh].string() + "|" +
+               std::to_string(smooth) + std::to_string(mesh_y_up) +
+               std::to_string(mesh_x_front) + "|" +
+               (mesh_weld.enabled ? std::to_string(mesh_weld.tolerance) + "|" +
+                                        std::to_string(mesh_weld.hard_angle)
+                                  : std::string{"-"});
+    };
+    // .xtrm cluster files are streamed instead of loaded
+    std::unique_ptr<xtr::MeshletStream> meshlets;
+    int meshlet_pool_mb = 256;
+    float meshlet_error = 1.f;
+    // .ply files without faces are drawn as point splats, at most
+    // point_budget_m million points of them
+    std::unique_ptr<xtr::PointSplats> splats;
+    float point_budget_m = 4.f;
+    float splat_scale = 1.5f;
+    // directories of frames and .xtrv vertex caches play as animations
+    std::unique_ptr<xtr::MeshSequence> sequence;
+    bool sequence_playing = true;
+    float sequence_speed = 1.f;
+    float sequence_time = 0.f;
+
     // lighting options. a spherical light is controlled by 2 angles
     float light_theta = -1.1f;
     float light_phi = -0.61f;
+    // coloured point lights scattered around the mesh, regenerated whenever
+    // one of these changes
+    int point_light_count = 0;
+    int point_light_seed = 1;
+    float point_light_radius = 0.3f;
+    float point_light_intensity = 0.5f;
+    std::tuple<int, int, float, float> uploaded_lights{0, 0, 0.f, 0.f};
 
     // background color
     float background_col[4] = {0.1f, 0.5f, 0.8f, 1.f};
@@ -153,28 +372,731 @@ int main(int argc, char *argv[]) {
     float rotation_y = 0.;
     float rotation_k = 45.;
 
+    // presentation options
+    const char *present_modes[] = {"VSync", "Adaptive", "Uncapped", "Capped"};
+    int present_mode = 0;
+    int fps_cap = 60;
+
+    // offline export options
+    const char *export_formats[] = {"PNG sequence", "PPM sequence",
+                                    "PPM stream", "Y4M stream"};
+    int export_format = 0;
+    // output directory for sequences, file, "-" or "|command" for streams
+    char export_target[256] = "./export";
+    int export_size[2] = {1920, 1080};
+    int export_fps = 30;
+    xtr::TurnTablePath export_path;
+    // camera at the start of the export, the path is relative to it
+    xtr::TurnTableCamera export_camera = camera;
+    int export_frame = 0;
+    // quit once the export is done, set when exporting from the command line
+    bool export_and_quit = false;
+    std::unique_ptr<xtr::FrameExporter> exporter;
+    // final image of each exported frame
+    xtr::Renderbuffer export_rb;
+    export_rb.label("export");
+    xtr::Framebuffer export_fb;
+    export_fb.attach_renderbuffer(GL_COLOR_ATTACHMENT0, export_rb);
+
+    // live gpu memory per allocation and category, written as csv from the
+    // panel, or on exit with --gpu-memory-csv
+    char gpu_memory_csv[256] = "./gpu_memory.csv";
+    bool gpu_memory_on_exit = false;
+    auto write_gpu_memory = [&]() {
+        std::ofstream file{gpu_memory_csv};
+        xtr::gpu_memory().write_csv(file);
+        std::cout << (file ? "Wrote " : "Cannot write ") << gpu_memory_csv
+                  << "\n";
+    };
+
+    // timeline of the last seconds on every thread and the gpu, dumped as
+    // chrome trace json with F9, from the panel, or on exit with --trace
+    char trace_path[256] = "./trace.json";
+    float trace_seconds = 10.f;
+    bool trace_on_exit = false;
+    xtr::tracer().name_thread("main");
+    auto dump_trace = [&]() {
+        const bool ok =
+            xtr::tracer().write_chrome_trace(trace_path, trace_seconds);
+        std::cout << (ok ? "Wrote " : "Cannot write ") << trace_path << "\n";
+    };
+
+    // golden image regression, e.g.
+    // xtr --headless --regress ./goldens --regress-csv regress.csv
+    // --regress-update writes the goldens instead of comparing
+    // --regress-soft also renders every case on the cpu and compares it
+    // against the gl render
+    // --regress-out puts the renders and diffs of failing cases somewhere
+    // other than failed/ next to the goldens
+    std::filesystem::path regress_dir, regress_out;
+    bool regress_update = false;
+    bool regress_soft = false;
+    std::string regress_csv;
+
+    // every parameter that affects the rendered frame, recorded and replayed
+    // along with the input events
+    xtr::InputLog input_log;
+    input_log.track(camera);
+    input_log.track(selected_mesh);
+    input_log.track(mesh_y_up);
+    input_log.track(mesh_x_front);
+    input_log.track(mesh_weld);
+    input_log.track(selected_texture);
+    input_log.track(detail_mapping);
+    input_log.track(nl_halftone);
+    input_log.track(xtoon_halftone_dot_size);
+    input_log.track(xtoon_halftone_rotation);
+    input_log.track(outline_type);
+    input_log.track(outline_col);
+    input_log.track(outline_thr);
+    input_log.track(outline_id_fac);
+    input_log.track(outline_normal_fac);
+    input_log.track(outline_position_fac);
+    input_log.track(outline_edge_fac);
+    input_log.track(outline_width);
+    input_log.track(outline_crease_angle);
+    input_log.track(dbam_z_min);
+    input_log.track(dbam_r);
+    input_log.track(dof_c);
+    input_log.track(near_silhouette_r);
+    input_log.track(specular_s);
+    input_log.track(abstracted_shape);
+    input_log.track(normal_factor);
+    input_log.track(light_theta);
+    input_log.track(light_phi);
+    input_log.track(point_light_count);
+    input_log.track(point_light_seed);
+    input_log.track(point_light_radius);
+    input_log.track(point_light_intensity);
+    input_log.track(background_col);
+    input_log.track(pp_effect);
+    input_log.track(dot_size);
+    input_log.track(rotation_c);
+    input_log.track(rotation_m);
+    input_log.track(rotation_y);
+    input_log.track(rotation_k);
+    input_log.track(meshlet_error);
+    input_log.track(point_budget_m);
+    input_log.track(splat_scale);
+    input_log.track(mesh_cache_mb);
+    input_log.track(pre_pass_mode);
+    input_log.track(pre_pass_threshold);
+    input_log.track(frames_in_flight);
+    input_log.track(screen_culling);
+    input_log.track(sequence_playing);
+    input_log.track(sequence_speed);
+    input_log.track(sequence_time);
+    app.set_input_log(&input_log);
+    // frame times of a replay
+    xtr::FrameStats replay_stats;
+
+    // command line export, e.g.
+    // xtr --export "|ffmpeg -i - out.mp4" --format y4m --frames 240
+    for (const xtr::Arg &arg : args.list()) {
+        const std::string &flag = arg.flag;
+        const char *value = arg.value();
+        if (flag == "--export") {
+            snprintf(export_target, sizeof(export_target), "%s", value);
+            export_and_quit = true;
+        } else if (flag == "--format") {
+            const char *names[] = {"png", "ppm", "ppm-stream", "y4m"};
+            for (int f = 0; f < 4; ++f) {
+                if (strcmp(value, names[f]) == 0) {
+                    export_format = f;
+                }
+            }
+        } else if (flag == "--frames") {
+            export_path.frames = std::max(1, atoi(value));
+        } else if (flag == "--size") {
+            sscanf(value, "%dx%d", &export_size[0], &export_size[1]);
+        } else if (flag == "--fps") {
+            export_fps = std::max(1, atoi(value));
+        } else if (flag == "--turns") {
+            export_path.turns = float(atof(value));
+        } else if (flag == "--present") {
+            // vsync, adaptive, uncapped or a frame rate cap
+            const char *names[] = {"vsync", "adaptive", "uncapped"};
+            for (int m = 0; m < 3; ++m) {
+                if (strcmp(value, names[m]) == 0) {
+                    present_mode = m;
+                }
+            }
+            if (atoi(value) > 0) {
+                present_mode = 3;
+                fps_cap = atoi(value);
+            }
+            app.set_present_mode(static_cast<xtr::PresentMode>(present_mode),
+                                 fps_cap);
+        } else if (flag == "--weld") {
+            // tolerance as a fraction of the bounding box diagonal
+            mesh_weld.enabled = true;
+            mesh_weld.tolerance = std::max(0.f, float(atof(value)));
+        } else if (flag == "--weld-angle") {
+            mesh_weld.hard_angle = std::clamp(float(atof(value)), 0.f, 180.f);
+        } else if (flag == "--generate") {
+            // another generated mesh in the list, e.g. terrain-20M, named
+            // like the default ones
+            xtr::GeneratedSpec generated;
+            if (xtr::parse_generated(std::string{value} + ".gen", generated)) {
+                mesh_files.push_back(
+                    std::filesystem::path{"generated"} /
+                    xtr::generated_name(generated.shape, generated.triangles));
+            } else {
+                std::cout << "Cannot generate " << value << "\n";
+            }
+        } else if (flag == "--frames-in-flight") {
+            frames_in_flight =
+                std::clamp(atoi(value), 1, xtr::FramesInFlight::max_count);
+        } else if (flag == "--depth-pre-pass") {
+            // off, on or auto
+            const std::string mode{value};
+            pre_pass_mode = mode == "off" ? 0 : mode == "on" ? 1 : 2;
+        } else if (flag == "--mesh-cache") {
+            // gpu memory for meshes kept resident, in MiB
+            mesh_cache_mb = std::max(0, atoi(value));
+        } else if (flag == "--meshlet-pool") {
+            // gpu memory for streamed clusters, in MiB
+            meshlet_pool_mb = std::max(16, atoi(value));
+        } else if (flag == "--gpu-memory-csv") {
+            snprintf(gpu_memory_csv, sizeof(gpu_memory_csv), "%s", value);
+            gpu_memory_on_exit = true;
+        } else if (flag == "--trace") {
+            snprintf(trace_path, sizeof(trace_path), "%s", value);
+            trace_on_exit = true;
+        } else if (flag == "--trace-seconds") {
+            trace_seconds = std::max(0.1f, float(atof(value)));
+        } else if (flag == "--regress") {
+            regress_dir = value;
+        } else if (flag == "--regress-soft") {
+            regress_dir = value;
+            regress_soft = true;
+        } else if (flag == "--regress-update") {
+            regress_dir = value;
+            regress_update = true;
+        } else if (flag == "--regress-csv") {
+            regress_csv = value;
+        } else if (flag == "--regress-out") {
+            regress_out = value;
+        } else if (flag == "--record") {
+            input_log.record(value, app.get_screen_width(),
+                             app.get_screen_height());
+        } else if (flag == "--replay") {
+            int width, height;
+            if (input_log.replay(value, width, height)) {
+                app.resize(width, height);
+                resize_targets(width, height);
+            }
+        }
+    }
+
+    auto start_export = [&]() {
+        resize_targets(export_size[0], export_size[1]);
+        export_rb.storage(GL_RGBA8, export_size[0], export_size[1]);
+        export_camera = camera;
+        export_frame = 0;
+        exporter = std::make_unique<xtr::FrameExporter>(
+            export_size[0], export_size[1],
+            static_cast<xtr::ExportFormat>(export_format), export_target,
+            export_fps);
+        if (!exporter->ok()) {
+            std::cout << "Cannot open export target " << export_target << "\n";
+            exporter.reset();
+            resize_targets(app.get_screen_width(), app.get_screen_height());
+        }
+    };
+
+    auto finish_export = [&]() {
+        exporter->finish();
+        std::cout << "Exported " << exporter->written() << " frames, "
+                  << exporter->fence_wait_ms() << " ms waiting on the gpu, "
+                  << exporter->queue_wait_ms() << " ms waiting on writers\n";
+        exporter.reset();
+        resize_targets(app.get_screen_width(), app.get_screen_height());
+    };
+
+    // render the whole chain from frame_camera at width x height, the final
+    // image ends up in output_fb, 0 being the window
+    auto render_frame = [&](const xtr::TurnTableCamera &frame_camera,
+                            const int width, const int height,
+                            const GLuint output_fb,
+                            const std::optional<glm::vec2> c_pick) {
+        // one timeline span per pass, on the cpu and the gpu
+        xtr::GpuTracePhases passes;
+        passes.next("mesh pass");
+        glViewport(0, 0, width, height);
+        const glm::mat4 projection_matrix = glm::perspective(
+            glm::half_pi<float>(),
+            static_cast<float>(width) / static_cast<float>(height), 1e-3f,
+            1e4f);
+        // draw mesh into framebuffer
+        mesh_pass.clear_buffer();
+        if (meshlets) {
+            meshlets->error_threshold = meshlet_error;
+            meshlets->update(frame_camera.view_matrix() * model_matrix,
+                             projection_matrix, height);
+            mesh_pass.draw(model_matrix, frame_camera.view_matrix(),
+                           projection_matrix, normal_factor, abstracted_shape,
+                           meshlets->bb_dimension(), 69,
+                           [&]() { meshlets->draw(); });
+        } else if (splats) {
+            // the cloud is centered on the origin of the model
+            const float pixels_per_unit =
+                projection_matrix[1][1] * 0.5f * float(height) /
+                glm::length(frame_camera.get_position());
+            float diameter = 0.f;
+            const size_t count = splats->level_of_detail(
+                pixels_per_unit, size_t(double(point_budget_m) * 1e6),
+                splat_scale, diameter);
+            mesh_pass.draw_splats(model_matrix, frame_camera.view_matrix(),
+                                  projection_matrix, normal_factor,
+                                  abstracted_shape, splats->bb_dimension(),
+                                  69, diameter, height,
+                                  [&]() { splats->draw(count); });
+        } else if (sequence) {
+            mesh_pass.draw(model_matrix, frame_camera.view_matrix(),
+                           projection_matrix, normal_factor, abstracted_shape,
+                           sequence->bb_dimension(), 69,
+                           [&]() { sequence->draw(); });
+        } else {
+            mesh_pass.draw(model_matrix, frame_camera.view_matrix(),
+                           projection_matrix, normal_factor, abstracted_shape,
+                           69);
+        }
+
+        // queue a read of the position under the cursor to pick the point C
+        // for depth-of-field effect, it arrives frames_in_flight frames later
+        if (c_pick.has_value()) {
+            passes.next("readback");
+            mesh_pass.bind_framebuffer();
+            glReadBuffer(GL_COLOR_ATTACHMENT0);
+            const int x =
+                std::clamp(int(c_pick.value().x * width), 0, width - 1);
+            const int y = std::clamp(int((1. - c_pick.value().y) * height), 0,
+                                     height - 1);
+            pick_readback.request(frames, x, y);
+            mesh_pass.unbind_framebuffer();
+        }
+
+        // point lights reaching each tile of the buffers
+        passes.next("light culling");
+        const std::tuple lights{point_light_count, point_light_seed,
+                                point_light_radius, point_light_intensity};
+        if (lights != uploaded_lights) {
+            tiled_lights.upload(xtr::stage_lights(
+                size_t(point_light_count), uint32_t(point_light_seed),
+                point_light_radius, point_light_intensity));
+            uploaded_lights = lights;
+        }
+        mesh_pass.bind_buffers(0, 1, 2);
+        tiled_lights.cull(width, height, 0, 2, 69);
+
+        // the tiles the mesh covers, for the passes drawn into output_fb
+        passes.next("tile classification");
+        screen_tiles.classify(width, height, 2, 69);
+        glViewport(0, 0, width, height);
+
+        // the screen passes sample the width x height corner of the targets
+        const glm::vec2 uv_scale{float(width) / float(frame_extent.x),
+                                 float(height) / float(frame_extent.y)};
+        xtoon_pass.uv_scale = uv_scale;
+        pp_pass.uv_scale = uv_scale;
+        outline_pass.uv_scale = uv_scale;
+
+        // xtoon rendering
+        passes.next("xtoon pass");
+        frame_fb.bind();
+        mesh_pass.bind_buffers(0, 1, 2);
+        tonemap_texture.bind_unit(3);
+        // the depth belongs to the mesh pass, only the color is cleared
+        glClear(GL_COLOR_BUFFER_BIT);
+        const xtr::Program &xtoon_program = xtoon_pass.get_program();
+        xtoon_program.use();
+
+        // the targets may be larger than width x height, texel offsets are
+        // relative to their size
+        xtoon_program.uni_2f(xtoon_program.loc("uni_screen_size"),
+                             float(frame_extent.x), float(frame_extent.y));
+
+        xtoon_program.uni_1i(xtoon_program.loc("uni_position"), 0);
+        xtoon_program.uni_1i(xtoon_program.loc("uni_normal"), 1);
+        xtoon_program.uni_1i(xtoon_program.loc("uni_id_map"), 2);
+        xtoon_program.uni_1i(xtoon_program.loc("uni_tonemap"), 3);
+
+        xtoon_program.uni_1i(xtoon_program.loc("uni_id"), 69);
+
+        xtoon_program.uni_vec3(xtoon_program.loc("uni_camera_pos"),
+                               frame_camera.get_position());
+        xtoon_program.uni_vec3(xtoon_program.loc("uni_camera_dir"),
+                               frame_camera.get_direction());
+
+        xtoon_program.uni_1i(xtoon_program.loc("uni_detail_mapping"),
+                             detail_mapping);
+
+        xtoon_program.uni_1f(xtoon_program.loc("uni_near_silhouette_r"),
+                             near_silhouette_r);
+        xtoon_program.uni_1f(xtoon_program.loc("uni_specular_s"), specular_s);
+
+        xtoon_program.uni_1f(xtoon_program.loc("uni_dbam_z_min"), dbam_z_min);
+        xtoon_program.uni_1f(xtoon_program.loc("uni_dbam_r"), dbam_r);
+        xtoon_program.uni_1f(xtoon_program.loc("uni_dof_z_c"),
+                             glm::length(dof_c - frame_camera.get_position()));
+
+        xtoon_program.uni_vec3(xtoon_program.loc("uni_light_dir"),
+                               glm::vec3{
+                                   sinf(light_theta) * cosf(light_phi),
+                                   cosf(light_theta),
+                                   sinf(light_theta) * sinf(light_phi),
+                               });
+
+        xtoon_program.uni_1i(xtoon_program.loc("uni_nl_halftone"), nl_halftone);
+        xtoon_program.uni_1f(xtoon_program.loc("uni_dot_size"),
+                             xtoon_halftone_dot_size);
+        xtoon_program.uni_1f(xtoon_program.loc("uni_rotation"),
+                             xtoon_halftone_rotation * DEG2RAD);
+        tiled_lights.bind(xtoon_program, 4);
+
+        // the stencil of the mesh pass rejects the background before the
+        // shader runs
+        glDisable(GL_DEPTH_TEST);
+        if (screen_culling) {
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_EQUAL, 1, 0xff);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        }
+        xtoon_pass.draw();
+        glDisable(GL_STENCIL_TEST);
+        glEnable(GL_DEPTH_TEST);
+        xtr::gl_state().bind_framebuffer(GL_FRAMEBUFFER, output_fb);
+
+        frame_texture.bind_unit(0);
+
+        // apply post-processing pass before the outline
+        passes.next("post-processing pass");
+        mesh_pass.bind_buffers(-1, -1, 1);
+        glClearColor(background_col[0], background_col[1], background_col[2],
+                     background_col[3]);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        const xtr::Program &pp_program = pp_pass.get_program();
+        pp_program.use();
+
+        pp_program.uni_2f(pp_program.loc("uni_screen_size"),
+                          float(frame_extent.x), float(frame_extent.y));
+
+        pp_program.uni_1i(pp_program.loc("uni_frame"), 0);
+        pp_program.uni_1i(pp_program.loc("uni_id_map"), 1);
+
+        pp_program.uni_1i(pp_program.loc("uni_id"), 69);
+
+        pp_program.uni_1i(pp_program.loc("uni_pp_effect"), pp_effect);
+
+        pp_program.uni_1f(pp_program.loc("uni_dot_size"), dot_size);
+        // https://en.wikipedia.org/wiki/Halftone#/media/File:CMYK_screen_angles.svg
+        pp_program.uni_1f(pp_program.loc("uni_rotation_c"),
+                          rotation_c * DEG2RAD);
+        pp_program.uni_1f(pp_program.loc("uni_rotation_m"),
+                          rotation_m * DEG2RAD);
+        pp_program.uni_1f(pp_program.loc("uni_rotation_y"),
+                          rotation_y * DEG2RAD);
+        pp_program.uni_1f(pp_program.loc("uni_rotation_k"),
+                          rotation_k * DEG2RAD);
+
+        screen_tiles.bind(pp_program, 8, screen_culling ? 0 : -1);
+        pp_pass.draw_tiles(screen_tiles.count());
+
+        // outline pass
+        passes.next("outline pass");
+        mesh_pass.bind_buffers(0, 1, 2);
+        // only clear depth buffer to draw the outline on the current render
+        glClear(GL_DEPTH_BUFFER_BIT);
+        if (outline_type == 4) {
+            // the edges facing the camera in object space, streamed clusters,
+            // point clouds and sequences have none
+            if (meshlets || splats || sequence) {
+                return;
+            }
+            xtr::MeshEdges &mesh_edges = mesh_pass.edges();
+            mesh_edges.extract(glm::vec3{glm::inverse(model_matrix) *
+                                         glm::vec4{frame_camera.get_position(),
+                                                   1.f}},
+                               outline_crease_angle);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            edge_pass.draw(mesh_edges, model_matrix, frame_camera.view_matrix(),
+                           projection_matrix, frame_camera.get_position(),
+                           {float(width), float(height)}, outline_width,
+                           {outline_col[0], outline_col[1], outline_col[2]},
+                           outline_edge_fac, 0, 2, 69);
+            glDisable(GL_BLEND);
+            return;
+        }
+        const xtr::Program &outline_program = outline_pass.get_program();
+        outline_program.use();
+
+        outline_program.uni_2f(outline_program.loc("uni_screen_size"),
+                               float(frame_extent.x), float(frame_extent.y));
+
+        outline_program.uni_1i(outline_program.loc("uni_position"), 0);
+        outline_program.uni_1i(outline_program.loc("uni_normal"), 1);
+        outline_program.uni_1i(outline_program.loc("uni_id_map"), 2);
+        outline_program.uni_1i(outline_program.loc("uni_tonemap"), 3);
+
+        outline_program.uni_1i(outline_program.loc("uni_id"), 69);
+
+        outline_program.uni_vec3(outline_program.loc("uni_camera_pos"),
+                                 frame_camera.get_position());
+        outline_program.uni_vec3(outline_program.loc("uni_camera_dir"),
+                                 frame_camera.get_direction());
+
+        outline_program.uni_1i(outline_program.loc("uni_outline_type"),
+                               outline_type);
+        outline_program.uni_vec3(outline_program.loc("uni_outline_col"),
+                                 glm::vec3{
+                                     outline_col[0],
+                                     outline_col[1],
+                                     outline_col[2],
+                                 });
+        outline_program.uni_1f(outline_program.loc("uni_outline_thr"),
+                               outline_thr);
+        outline_program.uni_1i(outline_program.loc("uni_outline_id_fac"),
+                               outline_id_fac);
+        outline_program.uni_1f(outline_program.loc("uni_outline_normal_fac"),
+                               outline_normal_fac);
+        outline_program.uni_1f(outline_program.loc("uni_outline_position_fac"),
+                               outline_position_fac);
+        outline_program.uni_1f(outline_program.loc("uni_outline_edge_fac"),
+                               outline_edge_fac);
+
+        // the filters reach past the mesh, so a band of a tile around it is
+        // drawn too
+        screen_tiles.bind(outline_program, 8, screen_culling ? 1 : -1);
+
+        // enable alpha blending during outline drawing
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        outline_pass.draw_tiles(screen_tiles.count());
+        glDisable(GL_BLEND);
+    };
+
+    // the parameters render_frame uses, for the cpu renderer
+    auto soft_params = [&](const xtr::TurnTableCamera &frame_camera) {
+        xtr::SoftRenderParams params;
+        params.normal_factor = normal_factor;
+        params.abstracted_shape = abstracted_shape;
+        params.detail_mapping = detail_mapping;
+        params.near_silhouette_r = near_silhouette_r;
+        params.specular_s = specular_s;
+        params.dbam_z_min = dbam_z_min;
+        params.dbam_r = dbam_r;
+        params.dof_z_c = glm::length(dof_c - frame_camera.get_position());
+        params.light_dir = {sinf(light_theta) * cosf(light_phi),
+                            cosf(light_theta),
+                            sinf(light_theta) * sinf(light_phi)};
+        params.nl_halftone = nl_halftone;
+        params.halftone_dot_size = xtoon_halftone_dot_size;
+        params.halftone_rotation = xtoon_halftone_rotation * DEG2RAD;
+        params.pp_effect = pp_effect;
+        params.dot_size = dot_size;
+        params.rotation_c = rotation_c * DEG2RAD;
+        params.rotation_m = rotation_m * DEG2RAD;
+        params.rotation_y = rotation_y * DEG2RAD;
+        params.rotation_k = rotation_k * DEG2RAD;
+        params.background = {background_col[0], background_col[1],
+                             background_col[2], background_col[3]};
+        params.outline_type = outline_type;
+        params.outline_col = {outline_col[0], outline_col[1], outline_col[2]};
+        params.outline_thr = outline_thr;
+        params.outline_id_fac = outline_id_fac;
+        params.outline_normal_fac = outline_normal_fac;
+        params.outline_position_fac = outline_position_fac;
+        params.outline_edge_fac = outline_edge_fac;
+        return params;
+    };
+
+    // every bundled model with each detail mapping, outline type and
+    // post-processing effect from fixed poses, compared against the goldens.
+    // a failing case leaves its render and a diff image in failed/, or in
+    // regress_out
+    auto run_regression = [&]() {
+        // every other parameter of the render at its default, whatever the
+        // command line or a replay set
+        selected_texture = 3;
+        mesh_y_up = false;
+        mesh_x_front = false;
+        mesh_weld = {};
+        nl_halftone = true;
+        xtoon_halftone_dot_size = 4.f;
+        xtoon_halftone_rotation = 69.f;
+        outline_col[0] = outline_col[1] = outline_col[2] = 0.f;
+        outline_thr = 0.4f;
+        outline_id_fac = true;
+        outline_normal_fac = 0.f;
+        outline_position_fac = 1.f;
+        outline_edge_fac = 1.f;
+        outline_width = 2.f;
+        outline_crease_angle = 60.f;
+        dbam_z_min = 0.5f;
+        dbam_r = 5.f;
+        dof_c = {};
+        near_silhouette_r = 0.f;
+        specular_s = 1.f;
+        abstracted_shape = 0;
+        normal_factor = 0.f;
+        light_theta = -1.1f;
+        light_phi = -0.61f;
+        point_light_count = 0;
+        point_light_seed = 1;
+        point_light_radius = 0.3f;
+        point_light_intensity = 0.5f;
+        background_col[0] = 0.1f;
+        background_col[1] = 0.5f;
+        background_col[2] = 0.8f;
+        background_col[3] = 1.f;
+        dot_size = 4.f;
+        rotation_c = 15.f;
+        rotation_m = 75.f;
+        rotation_y = 0.f;
+        rotation_k = 45.f;
+        screen_culling = true;
+
+        const int width = 320, height = 240;
+        // timed renders of each case, after one untimed
+        const int repeats = 5;
+        // a pixel differs above threshold, a case fails above max_fraction
+        const double threshold = 0.1, max_fraction = 0.001;
+        // the cpu renderer may differ along edges, where rasterization rules
+        // and float precision differ
+        const double soft_max_fraction = 0.01;
+        xtr::SoftRenderer soft_renderer{width, height};
+        xtr::SoftImage soft_tonemap;
+        soft_tonemap.load(texture_files[selected_texture]);
+        const xtr::TurnTableCamera poses[] = {
+            {1.f, 13.f / 24.f * glm::pi<float>(), glm::pi<float>(), {}},
+            {0.8f, 0.4f * glm::pi<float>(), 0.75f * glm::pi<float>(), {}},
+        };
+        resize_targets(width, height);
+        export_rb.storage(GL_RGBA8, width, height);
+        tonemap_texture.load_file(texture_files[selected_texture]);
+        loaded_texture = selected_texture;
+        xtr::tracer().enabled = true;
+        if (regress_update) {
+            std::filesystem::create_directories(regress_dir);
+        }
+        const std::filesystem::path failed_dir =
+            regress_out.empty() ? regress_dir / "failed" : regress_out;
+        xtr::RegressionReport report;
+        std::vector<unsigned char> rgba(size_t(width) * height * 4), diff;
+        for (const auto &mesh_file : mesh_files) {
+            if (mesh_file.extension() == ".xtrm" ||
+                xtr::is_point_cloud(mesh_file) ||
+                xtr::is_sequence(mesh_file) || xtr::is_generated(mesh_file)) {
+                continue;
+            }
+            const xtr::Mesh mesh =
+                xtr::load_mesh(mesh_file, true, mesh_y_up, mesh_x_front);
+            mesh_pass.upload_mesh(mesh);
+            const std::string mesh_name =
+                xtr::case_name_part(mesh_file.stem().string().c_str());
+            // every combination, the pose varies fastest
+            for (int i = 0; i < 4 * 5 * 2 * 2; ++i) {
+                const int v = i % 2, p = i / 2 % 2, o = i / 4 % 5;
+                const int d = i / 20;
+                detail_mapping = d;
+                outline_type = o;
+                pp_effect = p;
+                xtr::RegressionReport::Case c;
+                c.name = mesh_name + "_" +
+                         xtr::case_name_part(detail_mappings[d]) + "_" +
+                         xtr::case_name_part(outline_types[o]) + "_" +
+                         xtr::case_name_part(pp_effects[p]) + "_pose" +
+                         std::to_string(v);
+                render_frame(poses[v], width, height, export_fb, std::nullopt);
+                glFinish();
+                const int64_t since = xtr::tracer().now();
+                for (int r = 0; r < repeats; ++r) {
+                    render_frame(poses[v], width, height, export_fb,
+                                 std::nullopt);
+                }
+                glFinish();
+                xtr::gpu_tracer().collect();
+                c.pass_ms = xtr::gpu_pass_ms(since);
+                xtr::gl_state().bind_framebuffer(GL_READ_FRAMEBUFFER,
+                                                 export_fb);
+                glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                             rgba.data());
+                const auto golden = regress_dir / (c.name + ".png");
+                if (regress_update) {
+                    c.golden_found = c.passed =
+                        xtr::save_png(golden, rgba, width, height);
+                } else {
+                    const auto expected = xtr::load_png(golden, width, height);
+                    c.golden_found = !expected.empty();
+                    c.diff =
+                        xtr::compare_images(expected, rgba, threshold, &diff);
+                    c.passed = c.golden_found &&
+                               c.diff.fraction() <= max_fraction;
+                }
+                if (!c.passed && !regress_update) {
+                    std::filesystem::create_directories(failed_dir);
+                    xtr::save_png(failed_dir / (c.name + ".png"), rgba, width,
+                                  height);
+                    if (c.golden_found) {
+                        xtr::save_png(failed_dir / (c.name + "_diff.png"), diff,
+                                      width, height);
+                    }
+                }
+                // the cpu renderer has no object space outline
+                if (regress_soft && o != 4) {
+                    xtr::RegressionReport::Case soft;
+                    soft.name = c.name + "_soft";
+                    soft.golden_found = true;
+                    soft_renderer.render(mesh, poses[v], model_matrix,
+                                         soft_tonemap, soft_params(poses[v]));
+                    soft.pass_ms = {
+                        {"cpu raster", soft_renderer.stats().raster_ms},
+                        {"cpu xtoon", soft_renderer.stats().xtoon_ms},
+                        {"cpu composite",
+                         soft_renderer.stats().composite_ms}};
+                    soft.diff = xtr::compare_images(
+                        rgba, soft_renderer.rgba(), threshold, &diff);
+                    soft.passed = soft.diff.fraction() <= soft_max_fraction;
+                    if (!soft.passed) {
+                        std::filesystem::create_directories(failed_dir);
+                        xtr::save_png(failed_dir / (soft.name + ".png"),
+                                      soft_renderer.rgba(), width, height);
+                        xtr::save_png(failed_dir / (soft.name + "_diff.png"),
+                                      diff, width, height);
+                    }
+                    report.add(std::move(soft));
+                }
+                report.add(std::move(c));
+            }
+        }
+        report.report(std::cout);
+        if (!regress_csv.empty()) {
+            const bool ok = report.write_csv(regress_csv);
+            std::cout << (ok ? "Wrote " : "Cannot write ") << regress_csv
+                      << "\n";
+        }
+        return report.failed() == 0;
+    };
+    if (!regress_dir.empty()) {
+        return run_regression() ? 0 : 1;
+    }
+
+    if (export_and_quit) {
+        start_export();
+    }
+
     app.enable_imgui = true;
     while (app.is_running()) {
+        XTR_TRACE_SCOPE("frame");
         // check if the window is resized, if so, resize all the screen buffers
-        // and the viewport
+        // once it settles, an export in progress keeps its own size until it
+        // is done
         if (app.is_window_resized()) {
-            mesh_pass.resize(app.get_screen_width(), app.get_screen_height());
-            frame_texture.bind();
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, app.get_screen_width(),
-                         app.get_screen_height(), 0, GL_RGBA, GL_FLOAT,
-                         nullptr);
-            frame_texture.unbind();
-            frame_rb.bind();
-            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT,
-                                  app.get_screen_width(),
-                                  app.get_screen_height());
-            frame_rb.unbind();
-            glViewport(0, 0, app.get_screen_width(), app.get_screen_height());
-            projection_matrix = glm::perspective(
-                glm::half_pi<float>(),
-                static_cast<float>(app.get_screen_width()) /
-                    static_cast<float>(app.get_screen_height()),
-                1e-3f, 1e4f);
+            resize_wait = resize_settle_frames;
+        } else if (resize_wait > 0 && !exporter && --resize_wait == 0) {
+            resize_targets(app.get_screen_width(), app.get_screen_height());
         }
 
         // check mousr and keyboard inputs for controls
@@ -193,11 +1115,56 @@ int main(int argc, char *argv[]) {
             app.is_key_down(SDLK_UP) - app.is_key_down(SDLK_DOWN),
             app.is_key_down(SDLK_PERIOD) - app.is_key_down(SDLK_COMMA)};
         camera.update_origin(origin_delta);
+        if (app.is_key_pressed(SDLK_F9)) {
+            dump_trace();
+        }
 
         app.start_frame();
         // imgui panel
         if (app.enable_imgui) {
+            XTR_TRACE_SCOPE("imgui build");
             ImGui::Begin("panel");
+            // frame pacing and latency
+            if (ImGui::TreeNode("Frame")) {
+                bool present_changed = ImGui::Combo(
+                    "Present Mode", &present_mode, present_modes, 4);
+                if (present_mode == 3) {
+                    present_changed |=
+                        ImGui::DragInt("FPS Cap", &fps_cap, 1.f, 1, 1000);
+                }
+                if (present_changed) {
+                    app.set_present_mode(
+                        static_cast<xtr::PresentMode>(present_mode), fps_cap);
+                }
+                ImGui::Checkbox("Low Latency", &app.low_latency);
+                ImGui::SliderInt("Frames in Flight", &frames_in_flight, 1,
+                                 xtr::FramesInFlight::max_count);
+                ImGui::Text("cpu/gpu overlap %.0f%%, gpu %.2f frames behind",
+                            frames.overlap() * 100., frames.depth());
+                ImGui::Text("fence wait %.2f ms", frames.wait_ms());
+                ImGui::Checkbox("Skip Background Pixels", &screen_culling);
+                ImGui::Text("%d x %d screen tiles", screen_tiles.tiles().x,
+                            screen_tiles.tiles().y);
+                ImGui::Text("frame %.2f ms", app.get_frame_ms());
+                ImGui::Text("input to present %.1f ms (max %.1f ms)",
+                            app.get_latency_ms(), app.get_max_latency_ms());
+                // redundant binds skipped by the state cache last frame
+                ImGui::Checkbox("Cache GL State", &xtr::gl_state().caching);
+                ImGui::Text("binds %zu issued, %zu elided%s",
+                            xtr::gl_state().last_frame().issued,
+                            xtr::gl_state().last_frame().elided,
+                            xtr::gl_state().dsa() ? ", dsa" : "");
+                // timeline of the last seconds, also dumped with F9
+                ImGui::InputText("Trace", trace_path, sizeof(trace_path));
+                ImGui::DragFloat("Trace Seconds", &trace_seconds, 0.1f, 0.1f,
+                                 60.f);
+                if (ImGui::Button("Dump Trace")) {
+                    dump_trace();
+                }
+                ImGui::TreePop();
+            }
+
+            ImGui::Separator();
             // camera settings
             camera.imgui();
 
@@ -211,7 +1178,16 @@ int main(int argc, char *argv[]) {
             ImGui::Separator();
             // outline settings
             if (ImGui::TreeNode("Outline")) {
-                ImGui::Combo("Outline Type", &outline_type, outline_types, 4);
+                ImGui::Combo("Outline Type", &outline_type, outline_types, 5);
+                if (outline_type == 4) {
+                    ImGui::DragFloat("Outline Width", &outline_width, 0.1f,
+                                     0.5f, 16.f);
+                    ImGui::SliderFloat("Crease Angle", &outline_crease_angle,
+                                       0.f, 180.f);
+                    ImGui::Text("%zu of %zu edges drawn",
+                                mesh_pass.edges().segment_count(),
+                                mesh_pass.edges().edge_count());
+                }
                 ImGui::DragFloat("Outline Threshold", &outline_thr, 0.01f, 0.f,
                                  1.f);
                 ImGui::Checkbox("Outline ID Factor", &outline_id_fac);
@@ -237,9 +1213,6 @@ int main(int argc, char *argv[]) {
                         if (ImGui::Selectable(mesh_files[i].filename().c_str(),
                                               is_selected)) {
                             selected_mesh = i;
-                            mesh_pass.upload_mesh(
-                                xtr::load_mesh(mesh_files[i], abstracted_shape,
-                                               mesh_y_up, mesh_x_front));
                         }
                         if (is_selected) {
                             ImGui::SetItemDefaultFocus();
@@ -247,12 +1220,116 @@ int main(int argc, char *argv[]) {
                     }
                     ImGui::EndCombo();
                 }
-                if (ImGui::Checkbox("y_up", &mesh_y_up) ||
-                    ImGui::Checkbox("x_front", &mesh_x_front)) {
-                    // any of the orientation options also reload the mesh
-                    mesh_pass.upload_mesh(xtr::load_mesh(
-                        mesh_files[selected_mesh], abstracted_shape, mesh_y_up,
-                        mesh_x_front));
+                // any of the orientation options also reload the mesh
+                ImGui::Checkbox("y_up", &mesh_y_up);
+                ImGui::Checkbox("x_front", &mesh_x_front);
+                // welding reloads the mesh as well
+                ImGui::Checkbox("Weld", &mesh_weld.enabled);
+                if (mesh_weld.enabled) {
+                    ImGui::DragFloat("Weld Tolerance", &mesh_weld.tolerance,
+                                     1e-6f, 0.f, 1e-2f, "%.6f");
+                    ImGui::SliderFloat("Hard Edge Angle",
+                                       &mesh_weld.hard_angle, 0.f, 180.f);
+                }
+                if (meshlets) {
+                    // streamed meshes have their own statistics
+                    ImGui::DragFloat("Pixel Error", &meshlet_error, 0.05f,
+                                     0.1f, 64.f);
+                    ImGui::Text("%zu of %zu clusters resident, %zu drawn",
+                                meshlets->resident_count(),
+                                meshlets->cluster_count(),
+                                meshlets->selected_count());
+                    ImGui::Text("%zu triangles, %zu loads pending",
+                                meshlets->drawn_triangles(),
+                                meshlets->pending_count());
+                    ImGui::Text("pool %zu MiB, streamed %zu MiB",
+                                meshlets->pool_bytes() >> 20,
+                                meshlets->streamed_bytes() >> 20);
+                } else if (splats) {
+                    ImGui::DragFloat("Point Budget (M)", &point_budget_m,
+                                     0.05f, 0.01f, 256.f);
+                    ImGui::DragFloat("Splat Scale", &splat_scale, 0.01f, 0.5f,
+                                     4.f);
+                    ImGui::Text("%zu of %zu points drawn, %s normals",
+                                splats->drawn(), splats->count(),
+                                splats->estimated_normals() ? "estimated"
+                                                            : "loaded");
+                    ImGui::Text("%.1f ms load, peak %.1f MiB",
+                                mesh_stats.load_ms,
+                                double(mesh_stats.peak_bytes) /
+                                    (1024. * 1024.));
+                } else if (sequence) {
+                    ImGui::Checkbox("Play", &sequence_playing);
+                    ImGui::DragFloat("Speed", &sequence_speed, 0.01f, 0.f,
+                                     8.f);
+                    ImGui::SliderFloat("Time", &sequence_time, 0.f,
+                                       float(sequence->duration()));
+                    ImGui::Text("frame %zu of %zu at %.1f fps",
+                                sequence->shown_frame() + 1,
+                                sequence->frame_count(), sequence->fps());
+                    ImGui::Text("%zu vertices, %zu triangles",
+                                sequence->vertex_count(),
+                                sequence->triangle_count());
+                    ImGui::Text("%zu frames ready, %zu late, %zu unreadable",
+                                sequence->ready_count(),
+                                sequence->late_count(),
+                                sequence->mismatched_count());
+                    ImGui::Text("streamed %zu MiB",
+                                sequence->streamed_bytes() >> 20);
+                } else {
+                    ImGui::Combo("Upload", &upload_mode, upload_modes, 3);
+                    if (upload_mode == 0) {
+                        ImGui::SliderInt("MiB/frame", &upload_budget_mb, 1,
+                                         64);
+                        ImGui::Text("%.1f MiB queued, %zu ring stalls",
+                                    double(upload_ring.queued_bytes()) /
+                                        (1024. * 1024.),
+                                    upload_ring.stalls());
+                    }
+                    ImGui::Text("%zu vertices, %zu triangles, %.1f ms",
+                                mesh_stats.vertex_count,
+                                mesh_stats.triangle_count, mesh_stats.load_ms);
+                    if (mesh_weld.enabled) {
+                        ImGui::Text("%zu vertices welded",
+                                    mesh_stats.welded_count);
+                    }
+                    ImGui::Text(
+                        "load peak %.1f MiB, mesh %.1f MiB",
+                        double(mesh_stats.peak_bytes) / (1024. * 1024.),
+                        double(mesh_stats.mesh_bytes) / (1024. * 1024.));
+                    ImGui::Text("process peak %.1f MiB",
+                                double(mesh_stats.peak_rss_bytes) /
+                                    (1024. * 1024.));
+                    ImGui::SliderInt("Cache MiB", &mesh_cache_mb, 0, 4096);
+                    ImGui::Text("%zu meshes resident, %.1f MiB",
+                                mesh_pass.cached_count(),
+                                double(mesh_pass.cached_bytes()) /
+                                    (1024. * 1024.));
+                    ImGui::Text("%zu cache hits, %zu evictions",
+                                mesh_pass.cache_hits(),
+                                mesh_pass.cache_evictions());
+                }
+                ImGui::Combo("Depth Pre-Pass", &pre_pass_mode, pre_pass_modes,
+                             3);
+                if (pre_pass_mode == 2) {
+                    ImGui::DragFloat("Overdraw Threshold", &pre_pass_threshold,
+                                     0.05f, 1.f, 8.f);
+                }
+                if (mesh_pass.overdraw() > 0.f) {
+                    ImGui::Text("overdraw %.2fx, pre-pass %s",
+                                mesh_pass.overdraw(),
+                                mesh_pass.pre_pass_used() ? "on" : "off");
+                }
+                // the last measurement of each resident mesh
+                if (ImGui::TreeNode("Overdraw")) {
+                    for (const auto &[key, overdraw] :
+                         mesh_pass.overdraw_report()) {
+                        const std::filesystem::path path =
+                            key.substr(0, key.find('|'));
+                        ImGui::Text("%.2fx %s", overdraw,
+                                    path.filename().c_str());
+                    }
+                    ImGui::TreePop();
                 }
                 ImGui::TreePop();
             }
@@ -271,7 +1348,6 @@ int main(int argc, char *argv[]) {
                                 texture_files[i].filename().c_str(),
                                 is_selected)) {
                             selected_texture = i;
-                            tonemap_texture.load_file(texture_files[i]);
                         }
                         if (is_selected) {
                             ImGui::SetItemDefaultFocus();
@@ -318,12 +1394,8 @@ int main(int argc, char *argv[]) {
             if (ImGui::TreeNode("Normal Abstraction")) {
                 ImGui::DragFloat("Normal Factor", &normal_factor, 1e-2f, 0.f,
                                  1.f);
-                if (ImGui::Combo("Abstracted Shape", &abstracted_shape,
-                                 abstracted_shapes, 4)) {
-                    mesh_pass.upload_mesh(xtr::load_mesh(
-                        mesh_files[selected_mesh], abstracted_shape, mesh_y_up,
-                        mesh_x_front));
-                }
+                ImGui::Combo("Abstracted Shape", &abstracted_shape,
+                             abstracted_shapes, 4);
                 ImGui::TreePop();
             }
 
@@ -332,6 +1404,19 @@ int main(int argc, char *argv[]) {
             if (ImGui::TreeNode("Light")) {
                 ImGui::DragFloat("theta", &light_theta, 1e-2f);
                 ImGui::DragFloat("phi", &light_phi, 1e-2f);
+                ImGui::SliderInt("Point Lights", &point_light_count, 0,
+                                 int(xtr::TiledLights::max_lights));
+                if (point_light_count > 0) {
+                    ImGui::DragInt("Seed", &point_light_seed);
+                    ImGui::DragFloat("Radius", &point_light_radius, 1e-3f,
+                                     1e-3f, 2.f);
+                    ImGui::DragFloat("Intensity", &point_light_intensity,
+                                     1e-2f, 0.f, 8.f);
+                    ImGui::Text("%d x %d tiles of %d pixels",
+                                tiled_lights.tiles().x,
+                                tiled_lights.tiles().y,
+                                xtr::TiledLights::tile_size);
+                }
                 ImGui::TreePop();
             }
 
@@ -349,167 +1434,254 @@ int main(int argc, char *argv[]) {
                 }
                 ImGui::TreePop();
             }
+
+            ImGui::Separator();
+            // offline export of a turntable sequence
+            if (ImGui::TreeNode("Export")) {
+                if (exporter) {
+                    ImGui::ProgressBar(float(exporter->written()) /
+                                       float(export_path.frames));
+                    ImGui::Text("rendered %d, written %d", export_frame,
+                                exporter->written());
+                    ImGui::Text("gpu wait %.1f ms, writer wait %.1f ms",
+                                exporter->fence_wait_ms(),
+                                exporter->queue_wait_ms());
+                } else {
+                    ImGui::Combo("Format", &export_format, export_formats, 4);
+                    ImGui::InputText("Target", export_target,
+                                     sizeof(export_target));
+                    ImGui::DragInt2("Size", export_size, 1.f, 16, 16384);
+                    ImGui::DragInt("Frames", &export_path.frames, 1.f, 1,
+                                   100000);
+                    ImGui::DragInt("FPS", &export_fps, 1.f, 1, 240);
+                    ImGui::DragFloat("Turns", &export_path.turns, 1e-2f);
+                    ImGui::DragFloat("Theta swing",
+                                     &export_path.theta_amplitude, 1e-2f);
+                    if (ImGui::Button("Start")) {
+                        start_export();
+                    }
+                }
+                ImGui::TreePop();
+            }
+
+            ImGui::Separator();
+            // gpu memory held by the renderer, with the high-water marks
+            if (ImGui::TreeNode("GPU Memory")) {
+                const xtr::GpuMemory &memory = xtr::gpu_memory();
+                auto mib = [](const size_t bytes) {
+                    return double(bytes) / (1024. * 1024.);
+                };
+                ImGui::Text("total %.1f MiB, peak %.1f MiB",
+                            mib(memory.bytes()), mib(memory.peak_bytes()));
+                ImGui::Text("%zu buffers, %zu textures, %zu renderbuffers",
+                            memory.objects(xtr::GpuKind::Buffer),
+                            memory.objects(xtr::GpuKind::Texture),
+                            memory.objects(xtr::GpuKind::Renderbuffer));
+                for (int c = 0; c < int(xtr::GpuCategory::Count); ++c) {
+                    const auto category = xtr::GpuCategory(c);
+                    ImGui::Text("%s: %.1f MiB, peak %.1f MiB",
+                                xtr::gpu_category_name(category),
+                                mib(memory.bytes(category)),
+                                mib(memory.peak_bytes(category)));
+                }
+                ImGui::Text("targets %dx%d, %zu allocated, %zu reused, "
+                            "%zu pooled",
+                            frame_extent.x, frame_extent.y,
+                            target_pool.allocated(), target_pool.reused(),
+                            target_pool.free_count());
+                ImGui::Text("immutable storage: %s",
+                            xtr::gl_state().texture_storage() ? "yes" : "no");
+                if (ImGui::TreeNode("Allocations")) {
+                    for (const auto *a : memory.allocations()) {
+                        const char *owner =
+                            a->owner.empty() ? "?" : a->owner.c_str();
+                        if (a->width > 0) {
+                            ImGui::Text("%.2f MiB %s %s %dx%d", mib(a->bytes),
+                                        owner, xtr::gpu_format_name(a->format),
+                                        a->width, a->height);
+                        } else {
+                            ImGui::Text("%.2f MiB %s %s", mib(a->bytes), owner,
+                                        xtr::gpu_format_name(a->format));
+                        }
+                    }
+                    ImGui::TreePop();
+                }
+                ImGui::InputText("CSV", gpu_memory_csv, sizeof(gpu_memory_csv));
+                if (ImGui::Button("Write CSV")) {
+                    write_gpu_memory();
+                }
+                ImGui::TreePop();
+            }
             ImGui::End();
             ImGui::Render();
         }
 
-        // draw mesh into framebuffer
-        mesh_pass.clear_buffer();
-        mesh_pass.draw(model_matrix, camera.view_matrix(), projection_matrix,
-                       normal_factor, 69);
-
-        // read framebuffer to pick the point C for depth-of-field effect
-        mesh_pass.bind_framebuffer();
-        glReadBuffer(GL_COLOR_ATTACHMENT0);
-        std::vector<glm::vec3> position_buffer(app.get_screen_width() *
-                                               app.get_screen_height());
-        glReadPixels(0, 0, app.get_screen_width(), app.get_screen_height(),
-                     GL_RGB, GL_FLOAT, position_buffer.data());
-
-        if (c_pick.has_value()) {
-            int x = c_pick.value().x * app.get_screen_width();
-            int y = (1. - c_pick.value().y) * app.get_screen_height();
-            dof_c = position_buffer[x + y * app.get_screen_width()];
+        // the playback time advances with the frame time, a replay restores
+        // the recorded one instead
+        if (sequence && sequence_playing) {
+            sequence_time += float(app.get_last_frame_ms() * 1e-3 *
+                                   sequence_speed);
         }
-        mesh_pass.unbind_framebuffer();
-
-        // xtoon rendering
-        frame_fb.bind();
-        mesh_pass.bind_buffers(0, 1, 2);
-        glActiveTexture(GL_TEXTURE3);
-        tonemap_texture.bind();
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        const xtr::Program &xtoon_program = xtoon_pass.get_program();
-        xtoon_program.use();
-
-        xtoon_program.uni_2f(xtoon_program.loc("uni_screen_size"),
-                             float(app.get_screen_width()),
-                             float(app.get_screen_height()));
-
-        xtoon_program.uni_1i(xtoon_program.loc("uni_position"), 0);
-        xtoon_program.uni_1i(xtoon_program.loc("uni_normal"), 1);
-        xtoon_program.uni_1i(xtoon_program.loc("uni_id_map"), 2);
-        xtoon_program.uni_1i(xtoon_program.loc("uni_tonemap"), 3);
-
-        xtoon_program.uni_1i(xtoon_program.loc("uni_id"), 69);
-
-        xtoon_program.uni_vec3(xtoon_program.loc("uni_camera_pos"),
-                               camera.get_position());
-        xtoon_program.uni_vec3(xtoon_program.loc("uni_camera_dir"),
-                               camera.get_direction());
-
-        xtoon_program.uni_1i(xtoon_program.loc("uni_detail_mapping"),
-                             detail_mapping);
-
-        xtoon_program.uni_1f(xtoon_program.loc("uni_near_silhouette_r"),
-                             near_silhouette_r);
-        xtoon_program.uni_1f(xtoon_program.loc("uni_specular_s"), specular_s);
-
-        xtoon_program.uni_1f(xtoon_program.loc("uni_dbam_z_min"), dbam_z_min);
-        xtoon_program.uni_1f(xtoon_program.loc("uni_dbam_r"), dbam_r);
-        xtoon_program.uni_1f(xtoon_program.loc("uni_dof_z_c"),
-                             glm::length(dof_c - camera.get_position()));
-
-        xtoon_program.uni_vec3(xtoon_program.loc("uni_light_dir"),
-                               glm::vec3{
-                                   sinf(light_theta) * cosf(light_phi),
-                                   cosf(light_theta),
-                                   sinf(light_theta) * sinf(light_phi),
-                               });
-
-        xtoon_program.uni_1i(xtoon_program.loc("uni_nl_halftone"), nl_halftone);
-        xtoon_program.uni_1f(xtoon_program.loc("uni_dot_size"),
-                             xtoon_halftone_dot_size);
-        xtoon_program.uni_1f(xtoon_program.loc("uni_rotation"),
-                             xtoon_halftone_rotation * DEG2RAD);
-
-        xtoon_pass.draw();
-        frame_fb.unbind();
-
-        glActiveTexture(GL_TEXTURE0);
-        frame_texture.bind();
-
-        // apply post-processing pass before the outline
-        mesh_pass.bind_buffers(-1, -1, 1);
-        glClearColor(background_col[0], background_col[1], background_col[2],
-                     background_col[3]);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        const xtr::Program &pp_program = pp_pass.get_program();
-        pp_program.use();
-
-        pp_program.uni_2f(pp_program.loc("uni_screen_size"),
-                          float(app.get_screen_width()),
-                          float(app.get_screen_height()));
-
-        pp_program.uni_1i(pp_program.loc("uni_frame"), 0);
-        pp_program.uni_1i(pp_program.loc("uni_id_map"), 1);
-
-        pp_program.uni_1i(pp_program.loc("uni_id"), 69);
-
-        pp_program.uni_1i(pp_program.loc("uni_pp_effect"), pp_effect);
-
-        pp_program.uni_1f(pp_program.loc("uni_dot_size"), dot_size);
-        // https://en.wikipedia.org/wiki/Halftone#/media/File:CMYK_screen_angles.svg
-        pp_program.uni_1f(pp_program.loc("uni_rotation_c"),
-                          rotation_c * DEG2RAD);
-        pp_program.uni_1f(pp_program.loc("uni_rotation_m"),
-                          rotation_m * DEG2RAD);
-        pp_program.uni_1f(pp_program.loc("uni_rotation_y"),
-                          rotation_y * DEG2RAD);
-        pp_program.uni_1f(pp_program.loc("uni_rotation_k"),
-                          rotation_k * DEG2RAD);
-
-        pp_pass.draw();
-
-        // outline pass
-        mesh_pass.bind_buffers(0, 1, 2);
-        // only clear depth buffer to draw the outline on the current render
-        glClear(GL_DEPTH_BUFFER_BIT);
-        const xtr::Program &outline_program = outline_pass.get_program();
-        outline_program.use();
-
-        outline_program.uni_2f(outline_program.loc("uni_screen_size"),
-                               float(app.get_screen_width()),
-                               float(app.get_screen_height()));
-
-        outline_program.uni_1i(outline_program.loc("uni_position"), 0);
-        outline_program.uni_1i(outline_program.loc("uni_normal"), 1);
-        outline_program.uni_1i(outline_program.loc("uni_id_map"), 2);
-        outline_program.uni_1i(outline_program.loc("uni_tonemap"), 3);
-
-        outline_program.uni_1i(outline_program.loc("uni_id"), 69);
-
-        outline_program.uni_vec3(outline_program.loc("uni_camera_pos"),
-                                 camera.get_position());
-        outline_program.uni_vec3(outline_program.loc("uni_camera_dir"),
-                                 camera.get_direction());
+        // wait for the gpu to free the resources of this frame, and take the
+        // picked point once its frame is done
+        frames.count = frames_in_flight;
+        frames.begin();
+        if (const auto c = pick_readback.poll(frames)) {
+            dof_c = *c;
+        }
+        // record the parameters of this frame, or restore the recorded ones
+        input_log.sync_state();
+        mesh_pass.pre_pass = xtr::MeshPass::PrePass(pre_pass_mode);
+        mesh_pass.pre_pass_threshold = pre_pass_threshold;
 
-        outline_program.uni_1i(outline_program.loc("uni_outline_type"),
-                               outline_type);
-        outline_program.uni_vec3(outline_program.loc("uni_outline_col"),
-                                 glm::vec3{
-                                     outline_col[0],
-                                     outline_col[1],
-                                     outline_col[2],
-                                 });
-        outline_program.uni_1f(outline_program.loc("uni_outline_thr"),
-                               outline_thr);
-        outline_program.uni_1i(outline_program.loc("uni_outline_id_fac"),
-                               outline_id_fac);
-        outline_program.uni_1f(outline_program.loc("uni_outline_normal_fac"),
-                               outline_normal_fac);
-        outline_program.uni_1f(outline_program.loc("uni_outline_position_fac"),
-                               outline_position_fac);
-        outline_program.uni_1f(outline_program.loc("uni_outline_edge_fac"),
-                               outline_edge_fac);
+        // load whatever the ui or the replay selected
+        if (mesh_selection() != loaded_mesh ||
+            (abstracted_shape == 0 && !loaded_smooth)) {
+            XTR_TRACE_SCOPE("mesh load");
+            const bool smooth = abstracted_shape == 0;
+            loaded_smooth = smooth;
+            bool cached = false;
+            mesh_pass.cache_budget = size_t(mesh_cache_mb) << 20;
+            meshlets.reset();
+            splats.reset();
+            sequence.reset();
+            if (xtr::is_sequence(mesh_files[selected_mesh])) {
+                // frames go up as they play, whatever the upload mode
+                sequence = std::make_unique<xtr::MeshSequence>(
+                    mesh_files[selected_mesh], smooth, mesh_y_up,
+                    mesh_x_front);
+                sequence_time = 0.f;
+                if (!sequence->valid()) {
+                    std::cout << "Cannot play " << mesh_files[selected_mesh]
+                              << "\n";
+                    sequence.reset();
+                }
+            } else if (xtr::is_point_cloud(mesh_files[selected_mesh])) {
+                // points go up at once whatever the upload mode, they carry
+                // their own smooth normals
+                loaded_smooth = true;
+                splats = std::make_unique<xtr::PointSplats>();
+                splats->upload(xtr::load_point_cloud(
+                    mesh_files[selected_mesh], mesh_y_up, mesh_x_front,
+                    &mesh_stats));
+            } else if (mesh_files[selected_mesh].extension() == ".xtrm") {
+                // clusters always carry the smooth normals
+                loaded_smooth = true;
+                meshlets = std::make_unique<xtr::MeshletStream>(
+                    mesh_files[selected_mesh],
+                    size_t(meshlet_pool_mb) << 20);
+                if (!meshlets->valid()) {
+                    std::cout << "Cannot stream " << mesh_files[selected_mesh]
+                              << "\n";
+                    meshlets.reset();
+                }
+            } else if (mesh_pass.use_cached(mesh_cache_key(smooth))) {
+                // still resident, nothing to load
+                cached = true;
+            } else if (!smooth && mesh_pass.use_cached(mesh_cache_key(true))) {
+                // the smooth normals are simply not used
+                cached = true;
+                loaded_smooth = true;
+            } else if (upload_mode == 0) {
+                // the edges switch along with the mesh once it arrived
+                xtr::Mesh mesh =
+                    xtr::load_mesh(mesh_files[selected_mesh], smooth,
+                                   mesh_y_up, mesh_x_front, &mesh_stats,
+                                   mesh_weld);
+                mesh_pass.stream_mesh(upload_ring, std::move(mesh),
+                                      mesh_cache_key(smooth));
+            } else if (upload_mode == 1) {
+                mesh_pass.upload_mesh_with(
+                    [&](xtr::BufferOutput &output) {
+                        xtr::load_mesh_into(mesh_files[selected_mesh], smooth,
+                                            mesh_y_up, mesh_x_front, output,
+                                            &mesh_stats, mesh_weld);
+                        mesh_stats.mapped = output.mapped();
+                    },
+                    mesh_cache_key(smooth));
+            } else {
+                const xtr::Mesh mesh =
+                    xtr::load_mesh(mesh_files[selected_mesh], smooth,
+                                   mesh_y_up, mesh_x_front, &mesh_stats,
+                                   mesh_weld);
+                mesh_pass.upload_mesh(mesh, mesh_cache_key(smooth));
+            }
+            if (!meshlets && !sequence && !cached) {
+                mesh_stats.report(std::cout);
+            }
+            loaded_mesh = mesh_selection();
+        }
+        // move the next chunks of streamed uploads, exports wait for all of
+        // it so that no exported frame shows the previous mesh
+        upload_ring.frame_budget = size_t(upload_budget_mb) << 20;
+        if (exporter) {
+            upload_ring.flush();
+        } else {
+            upload_ring.pump();
+        }
+        mesh_pass.update_stream();
+        if (sequence) {
+            sequence_time = float(std::fmod(double(sequence_time),
+                                            sequence->duration()));
+            sequence->update(sequence_time);
+        }
+        if (selected_texture != loaded_texture) {
+            XTR_TRACE_SCOPE("tonemap load");
+            tonemap_texture.load_file(texture_files[selected_texture]);
+            loaded_texture = selected_texture;
+        }
 
-        // enable alpha blending during outline drawing
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        outline_pass.draw();
-        glDisable(GL_BLEND);
+        if (export_and_quit && !exporter) {
+            break;
+        }
+        if (exporter) {
+            // render as many export frames as fit in a short time slice, so
+            // that throughput is bound by rendering while the window stays
+            // responsive
+            const auto slice_start = std::chrono::steady_clock::now();
+            do {
+                render_frame(export_path.at(export_camera, export_frame),
+                             export_size[0], export_size[1], export_fb,
+                             std::nullopt);
+                exporter->capture(export_fb);
+                ++export_frame;
+            } while (export_frame < export_path.frames &&
+                     std::chrono::steady_clock::now() - slice_start <
+                         std::chrono::milliseconds(50));
+            // preview the last exported frame in the window
+            xtr::gl_state().bind_framebuffer(GL_READ_FRAMEBUFFER, export_fb);
+            xtr::gl_state().bind_framebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, export_size[0], export_size[1], 0, 0,
+                              app.get_screen_width(), app.get_screen_height(),
+                              GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            xtr::Framebuffer::unbind();
+            glViewport(0, 0, app.get_screen_width(), app.get_screen_height());
+            if (export_frame >= export_path.frames) {
+                finish_export();
+                if (export_and_quit) {
+                    break;
+                }
+            }
+        } else {
+            render_frame(camera,
+                         std::min(app.get_screen_width(), frame_extent.x),
+                         std::min(app.get_screen_height(), frame_extent.y), 0,
+                         c_pick);
+        }
 
         app.end_frame();
+        frames.end();
+        if (input_log.mode() == xtr::InputLog::Mode::Replay &&
+            app.get_last_frame_ms() > 0.) {
+            replay_stats.add(app.get_last_frame_ms());
+        }
+    }
+    replay_stats.report(std::cout);
+    if (gpu_memory_on_exit) {
+        write_gpu_memory();
+    }
+    if (trace_on_exit) {
+        dump_trace();
     }
     return 0;
 }